@@ -1,20 +1,19 @@
 #include "clipboard.h"
+#include "../processor.h"
 #include "plugin_chain.h"
 #include "track.h"
 
-namespace track::clipboard {
-void *data;
-int typecode = TYPECODE_NULL;
+track::Clipboard::~Clipboard() { releaseResources(); }
 
-void setData(void *item, int typehint) {
+void track::Clipboard::setData(void *item, int typehint) {
     releaseResources();
 
     data = item;
     typecode = typehint;
 }
 
-void *retrieveData() { return data; }
-void releaseResources() {
+void *track::Clipboard::retrieveData() { return data; }
+void track::Clipboard::releaseResources() {
     if (typecode == TYPECODE_CLIP)
         delete (track::clip *)data;
     else if (typecode == TYPECODE_PLUGIN)
@@ -27,4 +26,7 @@ void releaseResources() {
     typecode = TYPECODE_NULL;
     data = nullptr;
 }
-} // namespace track::clipboard
+
+track::Clipboard &track::getClipboard(void *p) {
+    return ((AudioPluginAudioProcessor *)p)->clipboard;
+}
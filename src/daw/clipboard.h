@@ -1,3 +1,5 @@
+#pragma once
+
 // use hex cuz it makes me feel cool
 #define TYPECODE_NULL 0x00
 #define TYPECODE_CLIPCOMPONENT 0x01
@@ -6,11 +8,20 @@
 #define TYPECODE_PLUGIN_CHAIN 0x04
 #define TYPECODE_NODE 0x05
 
-namespace track::clipboard {
-extern void *data;
-extern int typecode;
+namespace track {
+// one per processor. copied nodes and plugins point back at the instance they
+// came from, so they can't be pasted into another one anyway
+class Clipboard {
+  public:
+    ~Clipboard();
+
+    void *data = nullptr;
+    int typecode = TYPECODE_NULL;
+
+    void setData(void *item, int typehint);
+    void *retrieveData();
+    void releaseResources();
+};
 
-void setData(void *item, int typehint);
-void *retrieveData();
-void releaseResources();
-} // namespace track::clipboard
+Clipboard &getClipboard(void *p);
+} // namespace track
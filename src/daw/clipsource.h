@@ -0,0 +1,31 @@
+#pragma once
+#include <JuceHeader.h>
+
+namespace track {
+// clip audio that isn't held as floats in clip::buffer. it gets converted to
+// float a block at a time as it's mixed (see audioNode::process()), into the
+// RenderGraph's scratch buffer. shared between every copy of a clip
+struct clipSource {
+    virtual ~clipSource() = default;
+
+    int numChannels = 0;
+    juce::int64 lengthInSamples = 0;
+    double sampleRate = 0.0;
+
+    // numSamples samples from start onwards, converted to float. anything
+    // outside the source comes back as silence. realtime safe, and safe to
+    // call from several threads at once
+    virtual void read(float *const *dest, int numDestChannels,
+                      juce::int64 start, int numSamples) = 0;
+
+    // the audio thread has played clipID up to position. copies of a clip
+    // share the source but not the position, so they're told apart by id
+    virtual void markPlayed(int /*clipID*/, juce::int64 /*position*/) {}
+
+    // whether [start, end) can be read for clipID without waiting on the disk
+    virtual bool isResident(int /*clipID*/, juce::int64 /*start*/,
+                            juce::int64 /*end*/) {
+        return true;
+    }
+};
+} // namespace track
@@ -1,12 +1,7 @@
 #include "defs.h"
+#include "../processor.h"
 
-namespace track {
-int UI_TRACK_HEIGHT = 50;
-int UI_ZOOM_MULTIPLIER = 32;
-int BPM = 120;
-int SNAP_DIVISION = 4;
-double SAMPLE_RATE = -1;
-int SAMPLES_PER_BLOCK = -1;
-int MAX_LATENT_SAMPLES = -1;
-bool AUTO_GRID = true;
-} // namespace track
+track::engineContext &track::getContext(void *p) {
+    jassert(p != nullptr);
+    return ((AudioPluginAudioProcessor *)p)->context;
+}
@@ -2,11 +2,9 @@
 #include <vector>
 
 namespace track {
-extern int UI_ZOOM_MULTIPLIER;
 constexpr int UI_MINIMUM_ZOOM_MULTIPLIER = 10;
 constexpr int UI_MAXIMUM_ZOOM_MULTIPLIER = 160;
 
-extern int UI_TRACK_HEIGHT;
 constexpr int UI_MINIMUM_TRACK_HEIGHT = 16;
 constexpr int UI_MAXIMUM_TRACK_HEIGHT = 120;
 
@@ -28,16 +26,67 @@ constexpr int UI_SUBWINDOW_SHADOW_SPREAD = 4;
 
 constexpr int UI_VISUAL_FEEDBACK_FLASH_DURATION_MS = 60;
 
-extern int BPM; // set in playhead
-extern int SNAP_DIVISION;
-extern bool AUTO_GRID;
-
 constexpr int TRIM_REGION_WIDTH = 16;
 
-// set in prepareToPlay()
-extern double SAMPLE_RATE;
-extern int SAMPLES_PER_BLOCK;
-extern int MAX_LATENT_SAMPLES;
+// stereo output buses, including the main one. the extra ones are off until
+// the host turns them on
+constexpr int MAX_OUTPUT_BUSES = 8;
+
+// how clips hold their audio. mapped only applies to uncompressed files
+// (wav/aiff), which then get read from disk as they play; packed keeps
+// integer sources in memory at their own bit depth. anything either of those
+// can't handle is decoded into floats as usual
+enum class clipStorage { decoded = 0, mapped = 1, packed = 2 };
+
+// state that belongs to one instance of track. every processor has its own,
+// so several instances in one host (on different threads, even) don't stomp
+// on each other's sample rate, latency or zoom
+struct engineContext {
+    // set in prepareToPlay(). samplesPerBlock is the most that nodes and
+    // plugins ever get at once; bigger host blocks are split up
+    double sampleRate = -1;
+    int samplesPerBlock = -1;
+    int maxLatentSamples = -1;
+
+    int bpm = 120; // set in playhead
+
+    // project settings. if fixedPluginBlockSize isn't 0, plugins always get
+    // exactly that many samples, at the cost of that much extra latency each
+    int maxRenderBlockSize = 512;
+    int fixedPluginBlockSize = 0;
+
+    // 0 turns the watchdog off. otherwise a plugin that takes longer than the
+    // block it's processing this many blocks in a row gets pulled out of the
+    // chain until it's reloaded (see subplugin::reload()). so does one that
+    // spends that long in a single block, even if it never comes back
+    int pluginWatchdogBlocks = 0;
+
+    // whether the host calls the double processBlock(). the whole tree then
+    // renders in double, and so does every plugin that supports it
+    bool doublePrecision = false;
+
+    // see AudioPluginAudioProcessor::reloadClips() for changing it on clips
+    // that are already loaded
+    clipStorage storage = clipStorage::decoded;
+
+    int snapDivision = 4;
+    bool autoGrid = true;
+
+    // ui
+    int zoomMultiplier = 32;
+    int trackHeight = 50;
+};
+
+// the context of the AudioPluginAudioProcessor p points to
+engineContext &getContext(void *p);
+
+// for crossing between float and double; AudioBuffer only copies between
+// buffers of the same type
+template <typename Dest, typename Src>
+void convertSamples(const Src *src, Dest *dest, int numSamples) {
+    for (int i = 0; i < numSamples; ++i)
+        dest[i] = (Dest)src[i];
+}
 
 struct uiinstruction {
     int command = -1;
@@ -76,7 +125,4 @@ struct uiinstruction {
 
 // must align with internal JUCE modifications
 #define COMMAND_UPDATE_VST3_EMBEDDED_BOUNDS 420
-
-#define STAIN_MOVENODETOGROUP_NODE 0x1
-#define STAIN_MOVENODETOGROUP_GROUP 0x2
 } // namespace track
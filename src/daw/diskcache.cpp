@@ -0,0 +1,135 @@
+#include "diskcache.h"
+#include "resampler.h"
+#include <algorithm>
+
+juce::File track::diskcache::getDecodedDirectory() {
+    return juce::File::getSpecialLocation(
+               juce::File::SpecialLocationType::userApplicationDataDirectory)
+        .getChildFile("johnmanjohnston")
+        .getChildFile("track")
+        .getChildFile("cache")
+        .getChildFile("decoded");
+}
+
+bool track::diskcache::needsDecoding(juce::String path) {
+    juce::AudioFormatManager afm;
+    afm.registerBasicFormats();
+
+    juce::AudioFormat *format =
+        afm.findFormatForFileExtension(juce::File(path).getFileExtension());
+
+    return format != nullptr &&
+           dynamic_cast<juce::WavAudioFormat *>(format) == nullptr &&
+           dynamic_cast<juce::AiffAudioFormat *>(format) == nullptr;
+}
+
+juce::String track::diskcache::getDecodedPath(juce::String path) {
+    juce::String hash = resampler::getSourceHash(path);
+
+    if (hash.isEmpty())
+        return "";
+
+    // ex., ~/.config/johnmanjohnston/track/cache/decoded/1f3e....wav
+    return getDecodedDirectory().getChildFile(hash + ".wav").getFullPathName();
+}
+
+juce::String track::diskcache::decodeToCache(juce::String path) {
+    juce::String cachedPath = getDecodedPath(path);
+
+    if (cachedPath.isEmpty())
+        return "";
+
+    juce::File cachedFile(cachedPath);
+
+    if (cachedFile.existsAsFile() && cachedFile.getSize() > 0) {
+        touch(cachedFile);
+        return cachedPath;
+    }
+
+    juce::AudioFormatManager afm;
+    afm.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(
+        afm.createReaderFor(juce::File(path)));
+
+    if (reader == nullptr)
+        return "";
+
+    if (!getDecodedDirectory().createDirectory().wasOk())
+        return "";
+
+    // same as the resampler; temp file first, float so nothing gets
+    // requantized. streamed, so the whole file is never in memory at once
+    juce::TemporaryFile tmp(cachedFile);
+
+    {
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::FileOutputStream> stream =
+            std::make_unique<juce::FileOutputStream>(tmp.getFile());
+
+        if (stream->failedToOpen())
+            return "";
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(
+            stream.get(), reader->sampleRate, reader->numChannels, 32,
+            juce::StringPairArray(), 0));
+
+        if (writer == nullptr)
+            return "";
+
+        // writer owns the stream now
+        stream.release();
+
+        if (!writer->writeFromAudioReader(*reader, 0, -1))
+            return "";
+    }
+
+    if (!tmp.overwriteTargetFileWithTemporary())
+        return "";
+
+    DBG("decoded " << path << " to " << cachedPath);
+    trim(cachedFile);
+    return cachedPath;
+}
+
+void track::diskcache::touch(juce::File f) {
+    // access times are often not kept, so this goes by modification time
+    f.setLastModificationTime(juce::Time::getCurrentTime());
+}
+
+void track::diskcache::trim(juce::File keep) {
+    // everything in here can be made again from the original
+    juce::Array<juce::File> files = getDecodedDirectory().findChildFiles(
+        juce::File::findFiles, false, "*.wav");
+    files.addArray(resampler::getCacheDirectory().findChildFiles(
+        juce::File::findFiles, false, "*.wav"));
+
+    juce::int64 total = 0;
+    for (auto &f : files)
+        total += f.getSize();
+
+    if (total <= maxBytes)
+        return;
+
+    std::sort(files.begin(), files.end(),
+              [](const juce::File &a, const juce::File &b) {
+                  return a.getLastModificationTime() <
+                         b.getLastModificationTime();
+              });
+
+    for (auto &f : files) {
+        if (total <= maxBytes)
+            break;
+
+        // someone else's write in progress (see juce::TemporaryFile)
+        if (f == keep || f.getFileName().contains("_temp"))
+            continue;
+
+        // clips that still have it mapped keep their pages; on windows the
+        // delete just fails and it stays until next time
+        juce::int64 size = f.getSize();
+        if (f.deleteFile()) {
+            DBG("evicted " << f.getFullPathName() << " from the cache");
+            total -= size;
+        }
+    }
+}
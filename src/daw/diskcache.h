@@ -0,0 +1,33 @@
+#pragma once
+#include <JuceHeader.h>
+
+namespace track {
+// decoded copies of compressed files, so they only get decoded once ever,
+// and resampled copies of anything imported with "resample to host rate".
+// they live in the cache directory rather than next to the user's media, and
+// are kept under maxBytes together by throwing out whatever was used least
+// recently. a project remembers which file a resampled clip came from
+// (clip::sourcePath), so an evicted one is made again when it's loaded
+namespace diskcache {
+constexpr juce::int64 maxBytes = (juce::int64)4 << 30;
+
+juce::File getDecodedDirectory();
+
+// anything that can't be mapped or read directly off disk (mp3, flac, ogg..)
+bool needsDecoding(juce::String path);
+
+// where the decoded version of path would be; doesn't create anything
+juce::String getDecodedPath(juce::String path);
+
+// returns the decoded float wav of path, writing it first if it isn't cached
+// yet. blocking, any thread. empty string on failure
+juce::String decodeToCache(juce::String path);
+
+// marks an entry as just used
+void touch(juce::File f);
+
+// deletes the least recently used decoded and resampled files until they all
+// fit in maxBytes. keep (the entry that was just written) is never deleted
+void trim(juce::File keep = juce::File());
+} // namespace diskcache
+} // namespace track
@@ -0,0 +1,283 @@
+#include "graph.h"
+#include "defs.h"
+#include "track.h"
+
+namespace {
+void addNode(std::vector<track::renderNode> &nodes, track::audioNode &node,
+             int parent, int depth) {
+    int index = (int)nodes.size();
+
+    track::renderNode r;
+    r.node = &node;
+    r.parent = parent;
+    r.slot = depth;
+    nodes.push_back(r);
+
+    for (track::audioNode &child : node.childNodes)
+        addNode(nodes, child, index, depth + 1);
+
+    nodes[(size_t)index].subtreeEnd = (int)nodes.size();
+}
+
+// adds a finished node onto its parent or output. a mono node is panned here,
+// where it first meets a stereo buffer, along the same ramp process() would
+// have used on a stereo one
+template <typename SampleType>
+void addOnto(juce::AudioBuffer<SampleType> &dest, track::audioNode &node,
+             int numSamples) {
+    juce::AudioBuffer<SampleType> &src = node.getBuffer<SampleType>();
+
+    if (src.getNumChannels() == 1) {
+        bool pan = dest.getNumChannels() > 1;
+
+        for (int channel = 0; channel < dest.getNumChannels(); ++channel) {
+            dest.addFromWithRamp(
+                channel, 0, src.getReadPointer(0), numSamples,
+                pan ? track::audioNode::getPanGain(channel, node.panRampStart)
+                    : 1.f,
+                pan ? track::audioNode::getPanGain(channel, node.rampedPan)
+                    : 1.f);
+        }
+
+        return;
+    }
+
+    int numChannels = juce::jmin(src.getNumChannels(), dest.getNumChannels());
+    for (int channel = 0; channel < numChannels; ++channel)
+        dest.addFrom(channel, 0, src, channel, 0, numSamples);
+}
+// times node->process() for the telemetry, if it's on
+template <typename SampleType>
+void processNode(track::renderNode &r, int numSamples,
+                 track::Telemetry *telemetry) {
+    if (telemetry == nullptr || !telemetry->isEnabled()) {
+        r.node->process<SampleType>(numSamples, r.position);
+        return;
+    }
+
+    juce::int64 start = juce::Time::getHighResolutionTicks();
+    r.node->process<SampleType>(numSamples, r.position);
+
+    r.telemetrySeconds += juce::Time::highResolutionTicksToSeconds(
+        juce::Time::getHighResolutionTicks() - start);
+}
+} // namespace
+
+void track::RenderGraph::compile(std::vector<audioNode> &tracks,
+                                 engineContext &ctx) {
+    context = &ctx;
+    nodes.clear();
+    returns.clear();
+    nodeIDs.clear();
+
+    for (audioNode &t : tracks) {
+        if (t.isReturn)
+            returns[t.returnID] = (int)nodes.size();
+
+        addNode(nodes, t, -1, 0);
+    }
+
+    for (size_t i = 0; i < nodes.size(); ++i)
+        nodeIDs[nodes[i].node->id] = (int)i;
+
+    indexPlugins();
+
+    // one slot per depth, then returns after those
+    numSlots = 0;
+    for (renderNode &r : nodes) {
+        if (!r.node->isReturn)
+            numSlots = juce::jmax(numSlots, r.slot + 1);
+    }
+
+    for (auto &[returnID, index] : returns)
+        nodes[(size_t)index].slot = numSlots++;
+
+    allocate(context->samplesPerBlock);
+}
+
+void track::RenderGraph::allocate(int maxBlockSize) {
+    capacity = juce::jmax(1, maxBlockSize);
+    clipScratch.setSize(numChannels, capacity * 2 + clipScratchMargin * 2,
+                        false, false, true);
+
+    if (context->doublePrecision) {
+        arena.setSize(0, 0);
+        doubleArena.setSize(numChannels * numSlots, capacity, false, false,
+                            false);
+        doubleArena.clear();
+    } else {
+        doubleArena.setSize(0, 0);
+        arena.setSize(numChannels * numSlots, capacity, false, false, false);
+        arena.clear();
+    }
+
+    // the other precision's buffers are left empty, so using them by mistake
+    // doesn't write anywhere
+    for (renderNode &r : nodes) {
+        audioNode *node = r.node;
+
+        if (context->doublePrecision) {
+            node->doubleBuffer.setDataToReferTo(getChannels<double>(r.slot),
+                                                node->numChannels, capacity);
+            node->buffer.setSize(0, 0);
+        } else {
+            node->buffer.setDataToReferTo(getChannels<float>(r.slot),
+                                          node->numChannels, capacity);
+            node->doubleBuffer.setSize(0, 0);
+        }
+    }
+}
+
+template <typename SampleType>
+void track::RenderGraph::process(
+    int numSamples, int currentSample, bool soloMode,
+    juce::AudioBuffer<SampleType> *const *outputs) {
+    jassert(numSamples <= capacity);
+
+    // top down: which subtrees are silent, and where each node is in time.
+    // each level is pushed back by however much less latency it has than the
+    // slowest path
+    for (size_t i = 0; i < nodes.size();) {
+        renderNode &r = nodes[i];
+        audioNode *node = r.node;
+
+        int parentPosition =
+            r.parent < 0 ? currentSample : nodes[(size_t)r.parent].position;
+        r.position =
+            parentPosition - (context->maxLatentSamples - node->latency);
+
+        node->getBuffer<SampleType>().setDataToReferTo(
+            getChannels<SampleType>(r.slot), node->numChannels, numSamples);
+
+        // returns are solo safe
+        bool muted = node->m || (soloMode && !node->s && !node->isReturn);
+        r.silent = muted || node->isReturn;
+
+        if (!r.silent) {
+            ++i;
+            continue;
+        }
+
+        // nothing below here gets processed or read this block
+        for (int j = (int)i + 1; j < r.subtreeEnd; ++j)
+            nodes[(size_t)j].silent = true;
+
+        i = (size_t)r.subtreeEnd;
+    }
+
+    // bottom up: every node adds itself onto its parent once it's done, so a
+    // group's buffer already holds its children by the time it's processed.
+    // then its slot is cleared for the next node at that depth
+    for (int i = (int)nodes.size() - 1; i >= 0; --i) {
+        renderNode &r = nodes[(size_t)i];
+
+        if (r.silent)
+            continue;
+
+        juce::AudioBuffer<SampleType> &buffer =
+            r.node->getBuffer<SampleType>();
+        processNode<SampleType>(r, numSamples, telemetry);
+
+        int bus = r.node->outputBus;
+        juce::AudioBuffer<SampleType> *dest =
+            bus > 0 && bus < MAX_OUTPUT_BUSES ? outputs[bus] : nullptr;
+
+        if (dest == nullptr && r.parent < 0)
+            dest = outputs[0];
+
+        if (dest == nullptr)
+            dest = &nodes[(size_t)r.parent].node->getBuffer<SampleType>();
+
+        addOnto(*dest, *r.node, numSamples);
+
+        buffer.clear(0, numSamples);
+    }
+}
+
+template <typename SampleType>
+void track::RenderGraph::processReturn(int returnID, int numSamples) {
+    auto it = returns.find(returnID);
+    if (it == returns.end())
+        return;
+
+    renderNode &r = nodes[(size_t)it->second];
+    r.node->getBuffer<SampleType>().clear();
+
+    if (r.node->m)
+        return;
+
+    processNode<SampleType>(r, numSamples, telemetry);
+}
+
+template void track::RenderGraph::process(int, int, bool,
+                                          juce::AudioBuffer<float> *const *);
+template void track::RenderGraph::process(int, int, bool,
+                                          juce::AudioBuffer<double> *const *);
+template void track::RenderGraph::processReturn<float>(int, int);
+template void track::RenderGraph::processReturn<double>(int, int);
+
+void track::RenderGraph::flushTelemetry(double budget) {
+    if (telemetry == nullptr || !telemetry->isEnabled())
+        return;
+
+    telemetryInterval += budget;
+    if (telemetryInterval < Telemetry::accumulateInterval)
+        return;
+
+    telemetryEvent e;
+    e.budget = (float)telemetryInterval;
+    telemetryInterval = 0.0;
+
+    for (renderNode &r : nodes) {
+        e.type = telemetryEvent::node;
+        e.id = r.node->id;
+        e.seconds = (float)r.telemetrySeconds;
+        r.telemetrySeconds = 0.0;
+        telemetry->push(e);
+
+        for (auto &sp : r.node->plugins) {
+            if (sp == nullptr)
+                continue;
+
+            e.type = telemetryEvent::plugin;
+            e.id = sp->id;
+            e.seconds = (float)sp->telemetrySeconds;
+            sp->telemetrySeconds = 0.0;
+            telemetry->push(e);
+        }
+    }
+}
+
+void track::RenderGraph::indexPlugins() {
+    pluginNodes.clear();
+
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        for (auto &sp : nodes[i].node->plugins) {
+            if (sp != nullptr)
+                pluginNodes[sp->id] = (int)i;
+        }
+    }
+}
+
+track::audioNode *track::RenderGraph::findNode(int id) {
+    auto it = nodeIDs.find(id);
+    return it == nodeIDs.end() ? nullptr : nodes[(size_t)it->second].node;
+}
+
+track::subplugin *track::RenderGraph::findPlugin(int id) {
+    auto it = pluginNodes.find(id);
+    if (it == pluginNodes.end())
+        return nullptr;
+
+    for (auto &sp : nodes[(size_t)it->second].node->plugins) {
+        if (sp != nullptr && sp->id == id)
+            return sp.get();
+    }
+
+    return nullptr;
+}
+
+track::audioNode *track::RenderGraph::getReturn(int returnID) {
+    auto it = returns.find(returnID);
+    return it == returns.end() ? nullptr : nodes[(size_t)it->second].node;
+}
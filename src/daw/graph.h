@@ -0,0 +1,119 @@
+#pragma once
+#include "defs.h"
+#include "telemetry.h"
+#include <JuceHeader.h>
+#include <type_traits>
+#include <unordered_map>
+
+namespace track {
+class audioNode;
+class subplugin;
+
+// one node of the tree, as the audio thread sees it. records are stored in
+// pre-order, so a node's subtree is [index, subtreeEnd) and walking the
+// records backwards always reaches children before their parent
+struct renderNode {
+    audioNode *node = nullptr;
+    int parent = -1;
+    int subtreeEnd = 0;
+    int slot = -1; // which of the arena's buffers this node renders into
+
+    // worked out at the start of every block
+    bool silent = false; // muted, soloed out, under one of those, or a return
+    int position = 0;    // currentSample, after latency compensation
+
+    // time spent in node->process() since the last telemetry flush
+    double telemetrySeconds = 0.0;
+};
+
+// the node tree flattened into one array, with every node's buffer a slice of
+// one arena. audioNodes live in vectors by value and move around whenever the
+// tree changes, so this has to be compiled again after anything that adds,
+// removes or moves nodes (see AudioPluginAudioProcessor::insertNode())
+//
+// a node's buffer is only needed from when its first child finishes until it
+// has been added onto its parent. nodes at the same depth never overlap like
+// that, so they share a buffer; the arena holds one per level of the tree
+// plus one per return (those get read after the tree is done). so a session
+// with hundreds of tracks still only touches a handful of buffers per block
+class RenderGraph {
+  public:
+    static constexpr int numChannels = 2;
+
+    // message thread, under the callback lock. the arena holds
+    // context.samplesPerBlock samples per slot
+    void compile(std::vector<audioNode> &tracks, engineContext &context);
+
+    // (re)allocates the arena and points every node's buffer at its slice.
+    // process() never gets more than the capacity at once
+    void allocate(int maxBlockSize);
+    int getCapacity() const { return capacity; }
+
+    // renders everything except returns. outputs holds MAX_OUTPUT_BUSES
+    // buffers, outputs[0] being the main mix; a node is added onto its
+    // outputBus's buffer as soon as it's done, or onto its parent if it has
+    // none. null entries (disabled buses) fall back to the usual route. only
+    // returns' buffers are still valid afterwards. SampleType has to be
+    // double if context.doublePrecision was set when allocate() ran, and
+    // float otherwise
+    template <typename SampleType>
+    void process(int numSamples, int currentSample, bool soloMode,
+                 juce::AudioBuffer<SampleType> *const *outputs);
+
+    // call after process(), once everything that sends to it has been
+    template <typename SampleType>
+    void processReturn(int returnID, int numSamples);
+
+    audioNode *getReturn(int returnID); // nullptr if there's no such return
+
+    // audio thread (the processor's id index is rebuilt outside the callback
+    // lock, these aren't). nullptr if there's no such node or plugin
+    audioNode *findNode(int id);
+    subplugin *findPlugin(int id);
+
+    // message thread, under the callback lock. compile() does it too; plugins
+    // change without the tree recompiling, so this is for after those (see
+    // AudioPluginAudioProcessor::reindexPlugins())
+    void indexPlugins();
+
+    std::vector<renderNode> nodes;
+    std::unordered_map<int, int> returns; // returnID -> index into nodes
+    std::unordered_map<int, int> nodeIDs; // node id -> index into nodes
+
+    // plugin id -> index of the node it's on. the plugin itself is looked up
+    // in that node's chain, so a stale entry never points at a freed plugin
+    std::unordered_map<int, int> pluginNodes;
+    int numSlots = 0;
+
+    // every node's process() gets timed for this while it's on
+    Telemetry *telemetry = nullptr;
+
+    // audio thread, once per block. budget is how long the block lasts; once
+    // Telemetry::accumulateInterval worth has gone by, every node's and
+    // plugin's total goes out as one event each
+    void flushTelemetry(double budget);
+    double telemetryInterval = 0.0;
+
+    // clip sources get converted into this before they're mixed. nodes are
+    // processed one at a time, so the whole graph shares it
+    juce::AudioBuffer<float> clipScratch;
+    static constexpr int clipScratchMargin = 256;
+
+  private:
+    engineContext *context = nullptr;
+
+    // numChannels channels per slot. shared slots are kept silent between
+    // uses, so a node never has to clear its buffer before children add to it.
+    // only the one for the precision the tree renders in is allocated
+    juce::AudioBuffer<float> arena;
+    juce::AudioBuffer<double> doubleArena;
+    int capacity = 0;
+
+    template <typename SampleType> SampleType *const *getChannels(int slot) {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return arena.getArrayOfWritePointers() + slot * numChannels;
+        else
+            return doubleArena.getArrayOfWritePointers() + slot * numChannels;
+    }
+};
+} // namespace track
@@ -0,0 +1,138 @@
+#include "importer.h"
+#include "../processor.h"
+#include "defs.h"
+#include "peaks.h"
+#include "resampler.h"
+#include "track.h"
+#include "utility.h"
+#include <algorithm>
+
+track::ClipImporter::ClipImporter() : pool() {}
+track::ClipImporter::~ClipImporter() { pool.removeAllJobs(true, 5000); }
+
+void track::ClipImporter::queueDecode(importRequest request) {
+    jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+
+    pendingRequests.push_back(request);
+
+    juce::WeakReference<ClipImporter> self(this);
+    double hostSampleRate = getContext(processor).sampleRate;
+    clipStorage storage = getContext(processor).storage;
+
+    pool.addJob([this, self, request, hostSampleRate, storage] {
+        // the cache entry's name comes from hashing the whole source, so
+        // that's only worked out here. if it can't be written the clip
+        // falls back to resampling in realtime
+        juce::String path = request.sourcePath;
+        if (request.resample) {
+            juce::String cached = resampler::resampleToCache(
+                request.sourcePath, hostSampleRate, converter,
+                request.progress.get());
+
+            if (cached.isNotEmpty())
+                path = cached;
+        }
+
+        auto decoded = std::make_shared<track::clip>();
+        decoded->path = path;
+        bool success = decoded->updateBuffer(hostSampleRate, storage);
+
+        // already have the samples, so the waveform is ready by the time the
+        // clip components get recreated. other sources read the file instead
+        if (success)
+            PeakCache::build(path, decoded->source != nullptr
+                                       ? nullptr
+                                       : &decoded->buffer);
+
+        juce::MessageManager::callAsync([self, request, decoded, success] {
+            if (self != nullptr)
+                self->decodeFinished(request, decoded, success);
+        });
+    });
+}
+
+bool track::ClipImporter::isPending(juce::String path) {
+    for (auto &r : pendingRequests) {
+        if (r.sourcePath == path)
+            return true;
+    }
+
+    return false;
+}
+
+bool track::ClipImporter::isBusy() { return pendingRequests.size() > 0; }
+
+int track::ClipImporter::getPendingLength(juce::String path) {
+    for (auto &r : pendingRequests) {
+        if (r.sourcePath == path)
+            return r.lengthInSamples;
+    }
+
+    return -1;
+}
+
+float track::ClipImporter::getResampleProgress(juce::String path) {
+    for (auto &r : pendingRequests) {
+        if (r.sourcePath == path && r.resample)
+            return r.progress->load();
+    }
+
+    return -1.f;
+}
+
+void track::ClipImporter::decodeFinished(importRequest request,
+                                         std::shared_ptr<clip> decoded,
+                                         bool success) {
+    juce::String path = request.sourcePath;
+
+    for (size_t i = 0; i < pendingRequests.size(); ++i) {
+        if (pendingRequests[i].sourcePath == path) {
+            pendingRequests.erase(pendingRequests.begin() + (long)i);
+            break;
+        }
+    }
+
+    AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+    jassert(p != nullptr);
+
+    if (!success) {
+        DBG("failed to decode " << path);
+        p->dispatchGUIInstruction(UI_INSTRUCTION_UPDATE_CLIP_COMPONENTS);
+        return;
+    }
+
+    // fill every placeholder pointing at this file. the copy happens outside
+    // the callback lock, so the audio thread only waits for the swap
+    for (audioNode *node : utility::getFlattenedNodes(p)) {
+        if (!node->isTrack)
+            continue;
+
+        for (clip &c : node->clips) {
+            if (c.path != path || c.isLoaded())
+                continue;
+
+            if (!request.clipIDs.empty() &&
+                std::find(request.clipIDs.begin(), request.clipIDs.end(),
+                          c.id) == request.clipIDs.end())
+                continue;
+
+            juce::AudioBuffer<float> filled(decoded->buffer);
+            std::shared_ptr<clipSource> source = decoded->source;
+            std::shared_ptr<const polyphaseTable> table =
+                decoded->playbackTable;
+
+            const juce::ScopedLock sl(p->getCallbackLock());
+            c.path = decoded->path;
+            c.sourcePath = decoded->path != request.sourcePath
+                               ? request.sourcePath
+                               : juce::String();
+            std::swap(c.buffer, filled);
+            std::swap(c.source, source);
+            std::swap(c.playbackTable, table);
+            c.sampleRate = decoded->sampleRate;
+            c.hostSampleRate = decoded->hostSampleRate;
+        }
+    }
+
+    p->dispatchGUIInstruction(UI_INSTRUCTION_UPDATE_CLIP_COMPONENTS);
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "resampler.h"
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace track {
+class clip;
+
+struct importRequest {
+    // file that was dropped/chosen. placeholders point at it until the
+    // import's done; a resampled clip gets pointed at its cache file then
+    juce::String sourcePath;
+    int lengthInSamples = -1;
+    bool resample = false;
+
+    // the placeholders to fill in. empty fills every clip pointing at
+    // sourcePath that isn't loaded yet (i.e. a take that went onto several
+    // tracks)
+    std::vector<int> clipIDs;
+
+    // written to by the converter's worker threads
+    std::shared_ptr<std::atomic<float>> progress =
+        std::make_shared<std::atomic<float>>(0.f);
+};
+
+// decodes audio files on a thread pool. clips get added to the timeline as
+// placeholders (empty buffer) straight away, and get their buffer filled in on
+// the message thread once decoding is done. everything that reads whole files
+// happens on the pool, including hashing them for the resampling cache
+class ClipImporter {
+  public:
+    ClipImporter();
+    ~ClipImporter();
+
+    void *processor = nullptr;
+
+    void queueDecode(importRequest request);
+    bool isPending(juce::String path);
+    bool isBusy();
+    int getPendingLength(juce::String path);
+    float getResampleProgress(juce::String path); // -1 if not resampling
+
+    void decodeFinished(importRequest request, std::shared_ptr<clip> decoded,
+                        bool success);
+
+  private:
+    // declared before the pool so that it outlives any running decode job
+    SampleRateConverter converter;
+    juce::ThreadPool pool;
+    std::vector<importRequest> pendingRequests; // message thread only
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(ClipImporter)
+};
+} // namespace track
@@ -0,0 +1,188 @@
+#include "mapped.h"
+#include <vector>
+
+namespace {
+// smallest bytes-per-frame a mapped file can have is 2 (mono 16 bit), so
+// stepping this many samples at a time touches every 4k page at least once
+constexpr int touchStep = 512;
+
+juce::CriticalSection &getRegistryLock() {
+    static juce::CriticalSection lock;
+    return lock;
+}
+
+std::vector<std::weak_ptr<track::mappedSource>> &getRegistry() {
+    static std::vector<std::weak_ptr<track::mappedSource>> sources;
+    return sources;
+}
+} // namespace
+
+std::shared_ptr<track::mappedSource>
+track::mappedSource::open(juce::String path) {
+    juce::File file(path);
+    if (!file.existsAsFile())
+        return nullptr;
+
+    juce::AudioFormatManager afm;
+    afm.registerBasicFormats();
+
+    // only wav and aiff can be mapped; everything else gives us nullptr here
+    juce::AudioFormat *format =
+        afm.findFormatForFileExtension(file.getFileExtension());
+    if (format == nullptr)
+        return nullptr;
+
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader(
+        format->createMemoryMappedReader(file));
+
+    if (reader == nullptr || !reader->mapEntireFile()) {
+        DBG("couldn't map " << path << "; decoding it instead");
+        return nullptr;
+    }
+
+    auto source = std::make_shared<mappedSource>();
+    source->numChannels = (int)reader->numChannels;
+    source->lengthInSamples = reader->lengthInSamples;
+    source->sampleRate = reader->sampleRate;
+    source->reader = std::move(reader);
+
+    // most clips start at the top, so have that ready before playback does
+    juce::int64 head =
+        (juce::int64)(MappedPrefetcher::lookaheadSeconds * source->sampleRate);
+    source->touch(0, head);
+    source->headUpTo = head;
+
+    MappedPrefetcher::add(source);
+    return source;
+}
+
+void track::mappedSource::read(float *const *dest, int numDestChannels,
+                               juce::int64 start, int numSamples) {
+    reader->read(dest, numDestChannels, start, numSamples);
+}
+
+track::mappedSource::cursor *track::mappedSource::getCursor(int clipID) {
+    for (cursor &c : cursors) {
+        if (c.clipID.load(std::memory_order_acquire) == clipID)
+            return &c;
+    }
+
+    for (cursor &c : cursors) {
+        int expected = -1;
+        if (c.clipID.load(std::memory_order_relaxed) != -1)
+            continue;
+
+        // fresh, so the prefetcher starts over from wherever it's played
+        c.readPosition.store(-1, std::memory_order_relaxed);
+        c.prefetchedFrom.store(0, std::memory_order_relaxed);
+        c.prefetchedUpTo.store(-1, std::memory_order_relaxed);
+        c.lastPlayed.store(juce::Time::getHighResolutionTicks(),
+                           std::memory_order_relaxed);
+
+        if (c.clipID.compare_exchange_strong(expected, clipID,
+                                             std::memory_order_acq_rel))
+            return &c;
+    }
+
+    return nullptr;
+}
+
+void track::mappedSource::markPlayed(int clipID, juce::int64 position) {
+    cursor *c = getCursor(clipID);
+    if (c == nullptr)
+        return;
+
+    c->lastPlayed.store(juce::Time::getHighResolutionTicks(),
+                        std::memory_order_relaxed);
+    c->readPosition.store(position, std::memory_order_release);
+}
+
+bool track::mappedSource::isResident(int clipID, juce::int64 start,
+                                     juce::int64 end) {
+    if (end <= headUpTo)
+        return true;
+
+    cursor *c = getCursor(clipID);
+    return c != nullptr &&
+           start >= c->prefetchedFrom.load(std::memory_order_relaxed) &&
+           end <= c->prefetchedUpTo.load(std::memory_order_relaxed);
+}
+
+void track::mappedSource::touch(juce::int64 start, juce::int64 end) {
+    start = juce::jmax((juce::int64)0, start);
+    end = juce::jmin(lengthInSamples, end);
+
+    for (juce::int64 s = start; s < end; s += touchStep)
+        reader->touchSample(s);
+}
+
+track::MappedPrefetcher::MappedPrefetcher() : juce::Thread("mapped prefetch") {
+    startThread(juce::Thread::Priority::low);
+}
+
+track::MappedPrefetcher::~MappedPrefetcher() { stopThread(1000); }
+
+void track::MappedPrefetcher::add(std::weak_ptr<mappedSource> source) {
+    const juce::ScopedLock sl(getRegistryLock());
+    getRegistry().push_back(std::move(source));
+}
+
+void track::MappedPrefetcher::run() {
+    std::vector<std::shared_ptr<mappedSource>> live;
+
+    while (!threadShouldExit()) {
+        {
+            const juce::ScopedLock sl(getRegistryLock());
+            auto &sources = getRegistry();
+
+            for (size_t i = 0; i < sources.size();) {
+                if (auto source = sources[i].lock()) {
+                    live.push_back(std::move(source));
+                    ++i;
+                } else {
+                    sources.erase(sources.begin() + (long)i);
+                }
+            }
+        }
+
+        juce::int64 now = juce::Time::getHighResolutionTicks();
+        juce::int64 release = juce::Time::secondsToHighResolutionTicks(
+            mappedSource::releaseSeconds);
+
+        for (auto &source : live) {
+            for (mappedSource::cursor &c : source->cursors) {
+                if (c.clipID.load(std::memory_order_acquire) == -1)
+                    continue;
+
+                // the clip stopped playing, or is gone
+                if (now - c.lastPlayed.load(std::memory_order_relaxed) >
+                    release) {
+                    c.clipID.store(-1, std::memory_order_release);
+                    continue;
+                }
+
+                juce::int64 position =
+                    c.readPosition.load(std::memory_order_acquire);
+                if (position < 0)
+                    continue;
+
+                juce::int64 end = position + (juce::int64)(lookaheadSeconds *
+                                                           source->sampleRate);
+
+                // only what's new since last time, unless the playhead jumped
+                juce::int64 from = c.prefetchedUpTo.load();
+                if (from < position || from > end) {
+                    from = position;
+                    c.prefetchedFrom = position;
+                }
+
+                source->touch(from, end);
+                c.prefetchedUpTo = end;
+            }
+        }
+
+        // a clip deleted in the meantime gets unmapped here
+        live.clear();
+        wait(intervalMs);
+    }
+}
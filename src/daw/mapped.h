@@ -0,0 +1,80 @@
+#pragma once
+#include "clipsource.h"
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <memory>
+
+namespace track {
+// an uncompressed file (wav/aiff) played straight out of a memory mapping
+// instead of being decoded into clip::buffer. the only memory this costs is
+// whatever pages the os keeps resident, and those are shared with every
+// other instance playing the same file
+struct mappedSource : public clipSource {
+    std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader;
+
+    // where one clip playing this source is up to. every clip that plays it
+    // claims one the first time it does (from the audio thread, so there's a
+    // fixed number), and the prefetcher gives it back once the clip hasn't
+    // played for releaseSeconds
+    struct cursor {
+        std::atomic<int> clipID{-1}; // -1 while it's free
+
+        // end of the last range the clip played. the prefetcher keeps the
+        // pages after this resident
+        std::atomic<juce::int64> readPosition{-1};
+        std::atomic<juce::int64> lastPlayed{0}; // high resolution ticks
+
+        // the run the prefetcher has paged in for it so far, [from, upTo)
+        std::atomic<juce::int64> prefetchedFrom{0};
+        std::atomic<juce::int64> prefetchedUpTo{-1};
+    };
+
+    static constexpr int maxCursors = 16;
+    static constexpr double releaseSeconds = 1.0;
+    std::array<cursor, maxCursors> cursors;
+
+    // audio thread. nullptr if every cursor is taken, in which case the clip
+    // plays without prefetching
+    cursor *getCursor(int clipID);
+
+    // paged in by open(), since most clips start at the top
+    juce::int64 headUpTo = 0;
+
+    // nullptr if path isn't in a format that can be mapped, so the caller can
+    // decode it instead. faults in the first few seconds before returning
+    static std::shared_ptr<mappedSource> open(juce::String path);
+
+    // can still fault on pages the prefetcher didn't get to first
+    void read(float *const *dest, int numDestChannels, juce::int64 start,
+              int numSamples) override;
+    void markPlayed(int clipID, juce::int64 position) override;
+
+    // only knows about the head and the prefetcher's current run for the
+    // clip; anything read after a jump counts as not resident until the
+    // prefetcher catches up
+    bool isResident(int clipID, juce::int64 start, juce::int64 end) override;
+
+    // pulls [start, end) into memory by touching every page of it
+    void touch(juce::int64 start, juce::int64 end);
+};
+
+// keeps a few seconds after wherever each mappedSource is being played from
+// paged in, so the audio thread doesn't stall on the disk. one thread for the
+// whole process; every processor holds a SharedResourcePointer to it
+class MappedPrefetcher : private juce::Thread {
+  public:
+    MappedPrefetcher();
+    ~MappedPrefetcher() override;
+
+    static constexpr double lookaheadSeconds = 4.0;
+    static constexpr int intervalMs = 20;
+
+    // mappedSource::open() registers everything here. sources are only held
+    // weakly, so clips going away is all it takes to stop prefetching them
+    static void add(std::weak_ptr<mappedSource> source);
+
+  private:
+    void run() override;
+};
+} // namespace track
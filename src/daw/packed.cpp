@@ -0,0 +1,117 @@
+#include "packed.h"
+#include <vector>
+
+namespace {
+// samples converted per read() while loading
+constexpr int loadChunkSize = 1 << 16;
+
+template <typename Format, typename Constness>
+using packedPointer =
+    juce::AudioData::Pointer<Format, juce::AudioData::LittleEndian,
+                             juce::AudioData::NonInterleaved, Constness>;
+
+// readers hand integer formats back as left justified 32 bit ints, which is
+// what AudioData::Int32 expects, so this just drops the unused low bytes
+template <typename Format>
+void pack(const int *src, char *dest, int numSamples) {
+    using Source = juce::AudioData::Pointer<
+        juce::AudioData::Int32, juce::AudioData::NativeEndian,
+        juce::AudioData::NonInterleaved, juce::AudioData::Const>;
+
+    packedPointer<Format, juce::AudioData::NonConst>(dest).convertSamples(
+        Source(src), numSamples);
+}
+
+template <typename Format>
+void unpack(const char *src, float *dest, int numSamples) {
+    using Dest = juce::AudioData::Pointer<
+        juce::AudioData::Float32, juce::AudioData::NativeEndian,
+        juce::AudioData::NonInterleaved, juce::AudioData::NonConst>;
+
+    Dest(dest).convertSamples(
+        packedPointer<Format, juce::AudioData::Const>(src), numSamples);
+}
+} // namespace
+
+std::shared_ptr<track::packedSource>
+track::packedSource::load(juce::String path) {
+    juce::AudioFormatManager afm;
+    afm.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> reader(
+        afm.createReaderFor(juce::File(path)));
+
+    if (reader == nullptr || reader->usesFloatingPointData ||
+        reader->bitsPerSample > 24 || reader->numChannels == 0)
+        return nullptr;
+
+    auto source = std::make_shared<packedSource>();
+    source->numChannels = (int)reader->numChannels;
+    source->lengthInSamples = reader->lengthInSamples;
+    source->sampleRate = reader->sampleRate;
+    source->bytesPerSample = reader->bitsPerSample <= 16 ? 2 : 3;
+    source->data.allocate((size_t)source->numChannels *
+                              (size_t)source->lengthInSamples *
+                              (size_t)source->bytesPerSample,
+                          false);
+
+    juce::HeapBlock<int> chunk((size_t)source->numChannels * loadChunkSize);
+    std::vector<int *> channels;
+    for (int ch = 0; ch < source->numChannels; ++ch)
+        channels.push_back(chunk.get() + (size_t)ch * loadChunkSize);
+
+    for (juce::int64 pos = 0; pos < source->lengthInSamples;
+         pos += loadChunkSize) {
+        int n = (int)juce::jmin((juce::int64)loadChunkSize,
+                                source->lengthInSamples - pos);
+
+        if (!reader->read(channels.data(), source->numChannels, pos, n,
+                          false)) {
+            DBG("couldn't read " << path << " to pack it");
+            return nullptr;
+        }
+
+        for (int ch = 0; ch < source->numChannels; ++ch) {
+            char *dest = (char *)source->getChannel(ch) +
+                         (size_t)pos * (size_t)source->bytesPerSample;
+
+            if (source->bytesPerSample == 2)
+                pack<juce::AudioData::Int16>(channels[(size_t)ch], dest, n);
+            else
+                pack<juce::AudioData::Int24>(channels[(size_t)ch], dest, n);
+        }
+    }
+
+    return source;
+}
+
+void track::packedSource::read(float *const *dest, int numDestChannels,
+                               juce::int64 start, int numSamples) {
+    // the part of [start, start + numSamples) that's inside the source
+    int before = (int)juce::jlimit((juce::int64)0, (juce::int64)numSamples,
+                                   -start);
+    int available = (int)juce::jlimit(
+        (juce::int64)0, (juce::int64)(numSamples - before),
+        lengthInSamples - (start + before));
+    int after = before + available;
+
+    for (int ch = 0; ch < numDestChannels; ++ch) {
+        float *d = dest[ch];
+
+        if (ch >= numChannels || available == 0) {
+            juce::FloatVectorOperations::clear(d, numSamples);
+            continue;
+        }
+
+        juce::FloatVectorOperations::clear(d, before);
+        juce::FloatVectorOperations::clear(d + after, numSamples - after);
+
+        const char *src = getChannel(ch) +
+                          (size_t)(start + before) * (size_t)bytesPerSample;
+
+        if (bytesPerSample == 2)
+            unpack<juce::AudioData::Int16>(src, d + before, available);
+        else
+            unpack<juce::AudioData::Int24>(src, d + before, available);
+    }
+}
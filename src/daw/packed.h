@@ -0,0 +1,29 @@
+#pragma once
+#include "clipsource.h"
+#include <JuceHeader.h>
+#include <memory>
+
+namespace track {
+// a clip's audio kept in memory at the source file's own bit depth instead of
+// as floats, so 16 bit files take half the memory and 24 bit ones three
+// quarters. lossless; the ints are exactly what the file had
+struct packedSource : public clipSource {
+    int bytesPerSample = 0; // 2 or 3, little endian
+
+    // one contiguous run of lengthInSamples samples per channel
+    juce::HeapBlock<char> data;
+
+    // nullptr if the file is float or deeper than 24 bits (packing those
+    // wouldn't save anything) or can't be read. blocking
+    static std::shared_ptr<packedSource> load(juce::String path);
+
+    void read(float *const *dest, int numDestChannels, juce::int64 start,
+              int numSamples) override;
+
+  private:
+    const char *getChannel(int channel) const {
+        return data.get() + (size_t)channel * (size_t)lengthInSamples *
+                                (size_t)bytesPerSample;
+    }
+};
+} // namespace track
@@ -0,0 +1,394 @@
+#include "peaks.h"
+#include "resampler.h"
+#include <cstring>
+#include <limits>
+
+namespace {
+// header is the magic, then version, numChannels, lengthInSamples and
+// numLevels, then samplesPerPeak, numPeaks and the byte offset of each level.
+// all little endian
+const char *peakMagic = "TPK1";
+constexpr int peakVersion = 1;
+constexpr int headerSize = 4 + 4 + 4 + 8 + 4;
+constexpr int levelHeaderSize = 4 + 4 + 8;
+
+juce::int16 quantize(float x) {
+    return (juce::int16)juce::jlimit(-32767, 32767,
+                                     juce::roundToInt(x * 32767.f));
+}
+
+// turns a stream of samples into the finest level
+struct peakBuilder {
+    int numChannels = 0;
+    int inPeak = 0;
+    std::vector<std::vector<juce::int16>> base; // per channel, min/max pairs
+    std::vector<float> curMin;
+    std::vector<float> curMax;
+
+    explicit peakBuilder(int channels)
+        : numChannels(channels), base((size_t)channels),
+          curMin((size_t)channels, std::numeric_limits<float>::max()),
+          curMax((size_t)channels, std::numeric_limits<float>::lowest()) {}
+
+    void add(const juce::AudioBuffer<float> &b, int numSamples) {
+        int startInPeak = inPeak;
+
+        for (int ch = 0; ch < numChannels; ++ch) {
+            const float *x = b.getReadPointer(ch);
+            float lo = curMin[(size_t)ch];
+            float hi = curMax[(size_t)ch];
+            int n = startInPeak;
+
+            for (int i = 0; i < numSamples; ++i) {
+                lo = juce::jmin(lo, x[i]);
+                hi = juce::jmax(hi, x[i]);
+
+                if (++n == track::PeakCache::baseSamplesPerPeak) {
+                    base[(size_t)ch].push_back(quantize(lo));
+                    base[(size_t)ch].push_back(quantize(hi));
+                    lo = std::numeric_limits<float>::max();
+                    hi = std::numeric_limits<float>::lowest();
+                    n = 0;
+                }
+            }
+
+            curMin[(size_t)ch] = lo;
+            curMax[(size_t)ch] = hi;
+            inPeak = n;
+        }
+    }
+
+    void finish() {
+        if (inPeak == 0)
+            return;
+
+        for (int ch = 0; ch < numChannels; ++ch) {
+            base[(size_t)ch].push_back(quantize(curMin[(size_t)ch]));
+            base[(size_t)ch].push_back(quantize(curMax[(size_t)ch]));
+        }
+
+        inPeak = 0;
+    }
+
+    // every level after the first merges levelFactor peaks of the one before
+    bool write(juce::File target, juce::int64 lengthInSamples) {
+        using track::PeakCache;
+
+        std::vector<std::vector<std::vector<juce::int16>>> levels;
+        levels.push_back(base);
+
+        while ((int)levels.size() < PeakCache::maxLevels) {
+            auto &prev = levels.back();
+            size_t prevPeaks = prev[0].size() / 2;
+
+            if (prevPeaks <= 1)
+                break;
+
+            size_t numPeaks = (prevPeaks + PeakCache::levelFactor - 1) /
+                              PeakCache::levelFactor;
+            std::vector<std::vector<juce::int16>> next((size_t)numChannels);
+
+            for (int ch = 0; ch < numChannels; ++ch) {
+                auto &src = prev[(size_t)ch];
+                auto &dest = next[(size_t)ch];
+                dest.resize(numPeaks * 2);
+
+                for (size_t p = 0; p < numPeaks; ++p) {
+                    juce::int16 lo = std::numeric_limits<juce::int16>::max();
+                    juce::int16 hi = std::numeric_limits<juce::int16>::min();
+
+                    size_t end = juce::jmin(prevPeaks,
+                                            (p + 1) * PeakCache::levelFactor);
+                    for (size_t q = p * PeakCache::levelFactor; q < end; ++q) {
+                        lo = juce::jmin(lo, src[q * 2]);
+                        hi = juce::jmax(hi, src[q * 2 + 1]);
+                    }
+
+                    dest[p * 2] = lo;
+                    dest[p * 2 + 1] = hi;
+                }
+            }
+
+            levels.push_back(std::move(next));
+        }
+
+        // write to a temp file first so that a half-written file never gets
+        // mapped
+        juce::TemporaryFile tmp(target);
+
+        {
+            juce::FileOutputStream out(tmp.getFile());
+            if (out.failedToOpen())
+                return false;
+
+            out.write(peakMagic, 4);
+            out.writeInt(peakVersion);
+            out.writeInt(numChannels);
+            out.writeInt64(lengthInSamples);
+            out.writeInt((int)levels.size());
+
+            juce::int64 offset =
+                headerSize + (juce::int64)levels.size() * levelHeaderSize;
+            int samplesPerPeak = PeakCache::baseSamplesPerPeak;
+
+            for (auto &level : levels) {
+                int numPeaks = (int)(level[0].size() / 2);
+
+                out.writeInt(samplesPerPeak);
+                out.writeInt(numPeaks);
+                out.writeInt64(offset);
+
+                offset += (juce::int64)numChannels * numPeaks * 2 *
+                          (juce::int64)sizeof(juce::int16);
+                samplesPerPeak *= PeakCache::levelFactor;
+            }
+
+            // raw, since every platform we build for is little endian anyway
+            for (auto &level : levels) {
+                for (auto &channel : level) {
+                    if (channel.size() > 0)
+                        out.write(channel.data(),
+                                  channel.size() * sizeof(juce::int16));
+                }
+            }
+
+            out.flush();
+            if (out.getStatus().failed())
+                return false;
+        }
+
+        return tmp.overwriteTargetFileWithTemporary();
+    }
+};
+} // namespace
+
+bool track::peakFile::open(juce::File f) {
+    if (!f.existsAsFile())
+        return false;
+
+    mapped = std::make_unique<juce::MemoryMappedFile>(
+        f, juce::MemoryMappedFile::readOnly);
+
+    const char *data = (const char *)mapped->getData();
+    juce::int64 size = (juce::int64)mapped->getSize();
+
+    if (data == nullptr || size < headerSize ||
+        memcmp(data, peakMagic, 4) != 0 ||
+        (int)juce::ByteOrder::littleEndianInt(data + 4) != peakVersion) {
+        mapped.reset();
+        return false;
+    }
+
+    numChannels = (int)juce::ByteOrder::littleEndianInt(data + 8);
+    lengthInSamples =
+        (juce::int64)juce::ByteOrder::littleEndianInt64(data + 12);
+    int numLevels = (int)juce::ByteOrder::littleEndianInt(data + 20);
+
+    if (numChannels <= 0 || numLevels <= 0 ||
+        size < headerSize + (juce::int64)numLevels * levelHeaderSize) {
+        mapped.reset();
+        return false;
+    }
+
+    levels.clear();
+
+    for (int i = 0; i < numLevels; ++i) {
+        const char *h = data + headerSize + i * levelHeaderSize;
+
+        peakLevel level;
+        level.samplesPerPeak = (int)juce::ByteOrder::littleEndianInt(h);
+        level.numPeaks = (int)juce::ByteOrder::littleEndianInt(h + 4);
+        juce::int64 offset =
+            (juce::int64)juce::ByteOrder::littleEndianInt64(h + 8);
+
+        juce::int64 bytes = (juce::int64)numChannels * level.numPeaks * 2 *
+                            (juce::int64)sizeof(juce::int16);
+
+        // truncated file
+        if (level.samplesPerPeak <= 0 || offset < 0 || offset + bytes > size) {
+            mapped.reset();
+            levels.clear();
+            return false;
+        }
+
+        level.data = (const juce::int16 *)(data + offset);
+        levels.push_back(level);
+    }
+
+    return true;
+}
+
+void track::peakFile::getRange(int channel, juce::int64 start, juce::int64 end,
+                               float &lo, float &hi) const {
+    lo = 0.f;
+    hi = 0.f;
+
+    if (levels.size() == 0 || channel < 0 || channel >= numChannels ||
+        start >= lengthInSamples || end <= 0)
+        return;
+
+    juce::int64 span = juce::jmax((juce::int64)1, end - start);
+
+    size_t l = 0;
+    while (l + 1 < levels.size() && levels[l + 1].samplesPerPeak <= span)
+        ++l;
+
+    const peakLevel &level = levels[l];
+    if (level.numPeaks == 0)
+        return;
+
+    juce::int64 spp = level.samplesPerPeak;
+    juce::int64 p0 = juce::jlimit((juce::int64)0,
+                                  (juce::int64)level.numPeaks - 1, start / spp);
+    juce::int64 p1 = juce::jlimit(p0 + 1, (juce::int64)level.numPeaks,
+                                  (end + spp - 1) / spp);
+
+    const juce::int16 *d =
+        level.data + (size_t)channel * (size_t)level.numPeaks * 2;
+
+    juce::int16 mn = std::numeric_limits<juce::int16>::max();
+    juce::int16 mx = std::numeric_limits<juce::int16>::min();
+
+    for (juce::int64 p = p0; p < p1; ++p) {
+        mn = juce::jmin(mn, d[p * 2]);
+        mx = juce::jmax(mx, d[p * 2 + 1]);
+    }
+
+    lo = mn / 32767.f;
+    hi = mx / 32767.f;
+}
+
+track::PeakCache::PeakCache() : pool(2) {}
+track::PeakCache::~PeakCache() { pool.removeAllJobs(true, 5000); }
+
+std::shared_ptr<const track::peakFile>
+track::PeakCache::get(juce::String path) {
+    jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+
+    auto it = entries.find(path);
+    if (it != entries.end()) {
+        entry &e = it->second;
+        if (!e.failed)
+            return e.peaks;
+
+        juce::File file(path);
+        if (file.getSize() == e.size &&
+            file.getLastModificationTime() == e.modified)
+            return nullptr;
+
+        entries.erase(it);
+    }
+
+    // hashing reads the whole file, so even finding out whether the peaks are
+    // already on disk happens in the background
+    DBG("loading peaks for " << path);
+    entries[path].building = true;
+
+    juce::WeakReference<PeakCache> self(this);
+    pool.addJob([self, path] {
+        // taken first, so a change while this runs still counts as one
+        juce::File file(path);
+        juce::int64 size = file.getSize();
+        juce::Time modified = file.getLastModificationTime();
+
+        juce::String hash = resampler::getSourceHash(path);
+        bool success = hash.isNotEmpty() && build(path);
+
+        juce::MessageManager::callAsync(
+            [self, path, hash, success, size, modified] {
+                if (self != nullptr)
+                    self->buildFinished(path, hash, success, size, modified);
+            });
+    });
+
+    return nullptr;
+}
+
+void track::PeakCache::buildFinished(juce::String path, juce::String hash,
+                                     bool success, juce::int64 size,
+                                     juce::Time modified) {
+    entry &e = entries[path];
+    e.building = false;
+
+    auto peaks = std::make_shared<peakFile>();
+
+    // get() tries again once the file's size or modification time is
+    // different. it might not have existed yet, or might've still been
+    // being written
+    if (!success || !peaks->open(getPeakFile(hash))) {
+        DBG("couldn't build peaks for " << path);
+        e.failed = true;
+        e.size = size;
+        e.modified = modified;
+        return;
+    }
+
+    e.hash = hash;
+    e.peaks = peaks;
+
+    sendChangeMessage();
+}
+
+bool track::PeakCache::build(juce::String path,
+                             const juce::AudioBuffer<float> *decoded) {
+    juce::String hash = resampler::getSourceHash(path);
+
+    if (hash.isEmpty())
+        return false;
+
+    juce::File target = getPeakFile(hash);
+    if (target.existsAsFile() && target.getSize() > 0)
+        return true;
+
+    if (!getCacheDirectory().createDirectory().wasOk())
+        return false;
+
+    if (decoded != nullptr) {
+        if (decoded->getNumChannels() == 0)
+            return false;
+
+        peakBuilder builder(decoded->getNumChannels());
+        builder.add(*decoded, decoded->getNumSamples());
+        builder.finish();
+
+        return builder.write(target, decoded->getNumSamples());
+    }
+
+    juce::AudioFormatManager afm;
+    afm.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(
+        afm.createReaderFor(juce::File(path)));
+
+    if (reader == nullptr || reader->numChannels == 0)
+        return false;
+
+    // stream it in blocks so that huge files don't need to fit in memory
+    const int blockSize = 1 << 16;
+    juce::AudioBuffer<float> block((int)reader->numChannels, blockSize);
+    peakBuilder builder((int)reader->numChannels);
+
+    for (juce::int64 pos = 0; pos < reader->lengthInSamples; pos += blockSize) {
+        int n = (int)juce::jmin((juce::int64)blockSize,
+                                reader->lengthInSamples - pos);
+
+        reader->read(&block, 0, n, pos, true, true);
+        builder.add(block, n);
+    }
+
+    builder.finish();
+    return builder.write(target, reader->lengthInSamples);
+}
+
+juce::File track::PeakCache::getCacheDirectory() {
+    return juce::File::getSpecialLocation(
+               juce::File::SpecialLocationType::userApplicationDataDirectory)
+        .getChildFile("johnmanjohnston")
+        .getChildFile("track")
+        .getChildFile("cache")
+        .getChildFile("peaks");
+}
+
+juce::File track::PeakCache::getPeakFile(juce::String hash) {
+    // ex., ~/.config/johnmanjohnston/track/cache/peaks/1f3e....peaks
+    return getCacheDirectory().getChildFile(hash + ".peaks");
+}
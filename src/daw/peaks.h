@@ -0,0 +1,78 @@
+#pragma once
+#include <JuceHeader.h>
+#include <map>
+#include <memory>
+
+namespace track {
+// min/max pairs at one resolution. points into the mapped file
+struct peakLevel {
+    int samplesPerPeak = 0;
+    int numPeaks = 0;
+    const juce::int16 *data = nullptr; // [channel][peak][min, max]
+};
+
+// a memory-mapped .peaks file. every level is 4x coarser than the one
+// before, so any zoom level can be drawn by looking at a handful of peaks per
+// pixel
+struct peakFile {
+    std::unique_ptr<juce::MemoryMappedFile> mapped;
+    int numChannels = 0;
+    juce::int64 lengthInSamples = 0;
+    std::vector<peakLevel> levels;
+
+    bool open(juce::File f);
+
+    // min/max of channel over [start, end), in the source file's samples.
+    // uses the coarsest level that still has at least one peak per range
+    void getRange(int channel, juce::int64 start, juce::int64 end, float &lo,
+                  float &hi) const;
+};
+
+// waveform overviews shared between every clip pointing at the same file.
+// they're written next to the resampling cache as <hash>.peaks, so reopening
+// a project just maps them back in
+class PeakCache : public juce::ChangeBroadcaster {
+  public:
+    PeakCache();
+    ~PeakCache() override;
+
+    static constexpr int baseSamplesPerPeak = 256;
+    static constexpr int levelFactor = 4;
+    static constexpr int maxLevels = 8;
+
+    // message thread. nullptr until the peaks are ready; the first call for a
+    // path maps them in, or builds them if they aren't on disk, in the
+    // background. sends a change message once they're in
+    std::shared_ptr<const peakFile> get(juce::String path);
+
+    // writes the peak file for path if it doesn't exist yet. uses decoded if
+    // given, otherwise reads the file. blocking, any thread
+    static bool build(juce::String path,
+                      const juce::AudioBuffer<float> *decoded = nullptr);
+
+    static juce::File getCacheDirectory();
+    static juce::File getPeakFile(juce::String hash);
+
+  private:
+    struct entry {
+        juce::String hash;
+        std::shared_ptr<peakFile> peaks;
+        bool building = false;
+
+        // a build that failed is only tried again once the file changes
+        // (i.e. it finished being written), otherwise every repaint would
+        // queue it again
+        bool failed = false;
+        juce::int64 size = -1;
+        juce::Time modified;
+    };
+
+    std::map<juce::String, entry> entries; // message thread only
+    juce::ThreadPool pool;
+
+    void buildFinished(juce::String path, juce::String hash, bool success,
+                       juce::int64 size, juce::Time modified);
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(PeakCache)
+};
+} // namespace track
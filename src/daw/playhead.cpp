@@ -5,13 +5,13 @@
 track::PlayheadComponent::PlayheadComponent() : juce::Component() {
     setBounds(10, 10, 10, 10);
     setOpaque(false);
+
+    // moving it around shouldn't mean redrawing the pointer every time
+    setBufferedToImage(true);
 }
 track::PlayheadComponent::~PlayheadComponent() {}
 
 void track::PlayheadComponent::paint(juce::Graphics &g) {
-    if (getBounds().getX() < UI_TRACK_WIDTH)
-        return;
-
     juce::Rectangle<int> lineBounds = getLocalBounds()
                                           .withSizeKeepingCentre(3, getHeight())
                                           .withTrimmedTop(2);
@@ -44,6 +44,8 @@ AudioPluginAudioProcessorEditor::timerCallback (this=0x555558840b70) at
 /home/johnston/nerd/track/src/editor.h:111
         */
 
+    engineContext &ctx = processor->context;
+
     // assign current sample number, or resort to a fallback value
     int curSample = 44100;
     if (processor->getPlayHead() != nullptr &&
@@ -51,12 +53,17 @@ AudioPluginAudioProcessorEditor::timerCallback (this=0x555558840b70) at
         curSample =
             *processor->getPlayHead()->getPosition()->getTimeInSamples();
 
-        BPM = *processor->getPlayHead()->getPosition()->getBpm();
+        ctx.bpm = *processor->getPlayHead()->getPosition()->getBpm();
     } else
-        BPM = 120;
+        ctx.bpm = 120;
 
-    setBounds((curSample / SAMPLE_RATE * UI_ZOOM_MULTIPLIER) + UI_TRACK_WIDTH -
-                  tv->getViewPositionX() - (w / 2.f),
+    setBounds((curSample / ctx.sampleRate * ctx.zoomMultiplier) +
+                  UI_TRACK_WIDTH - tv->getViewPositionX() - (w / 2.f),
               UI_TOPBAR_HEIGHT + 7, w, 720 - UI_TOPBAR_HEIGHT - 5 - 8);
-    repaint();
+
+    // hidden rather than skipped in paint(), since the image is cached
+    setVisible(getX() >= UI_TRACK_WIDTH);
+
+    // no repaint(); setBounds() already invalidates the old and new strips
+    // when it actually moves, and does nothing when it doesn't
 }
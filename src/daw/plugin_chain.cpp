@@ -2,6 +2,7 @@
 #include "clipboard.h"
 #include "defs.h"
 #include "subwindow.h"
+#include "trace.h"
 #include "track.h"
 #include "utility.h"
 #include <cstddef>
@@ -12,32 +13,45 @@ track::ActionAddPlugin::ActionAddPlugin(std::vector<int> route,
                                         juce::String identifier,
                                         void *processor)
     : juce::UndoableAction() {
-    this->nodeRoute = route;
+    this->nodeID = utility::getNodeFromRoute(route, processor)->id;
     this->pluginIdentifier = identifier;
     this->p = processor;
 }
 track::ActionAddPlugin::~ActionAddPlugin() {}
 
 bool track::ActionAddPlugin::perform() {
-    audioNode *node = utility::getNodeFromRoute(nodeRoute, p);
+    TRACE_SCOPE("ActionAddPlugin::perform");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
     validPlugin = node->addPlugin(pluginIdentifier);
 
-    updateGUI();
+    // same id on redo
+    if (validPlugin)
+        node->plugins.back()->id = pluginID;
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    processor->reindexPlugins(*node);
+
+    if (validPlugin)
+        pluginID = node->plugins.back()->id;
+
+    updateGUI();
     processor->requireSaving();
 
     return validPlugin;
 }
 
 bool track::ActionAddPlugin::undo() {
+    TRACE_SCOPE("ActionAddPlugin::undo");
+
     if (!validPlugin)
         return false;
 
-    audioNode *node = utility::getNodeFromRoute(nodeRoute, p);
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
+    std::vector<int> nodeRoute = processor->getRouteOfNode(nodeID);
 
     // close editor, then remove plugin
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(
         UI_INSTRUCTION_CLOSE_PEW, (void *)(uintptr_t)(node->plugins.size() - 1),
         nodeRoute);
@@ -46,6 +60,7 @@ bool track::ActionAddPlugin::undo() {
         (void *)(uintptr_t)(node->plugins.size() - 1), nodeRoute);
 
     node->removePlugin(node->plugins.size() - 1);
+    processor->reindexPlugins(*node);
 
     updateGUI();
     processor->requireSaving();
@@ -56,7 +71,7 @@ bool track::ActionAddPlugin::undo() {
 void track::ActionAddPlugin::updateGUI() {
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(UI_INSTRUCTION_RECREATE_ALL_PNCS, nullptr,
-                                      nodeRoute);
+                                      processor->getRouteOfNode(nodeID));
 }
 
 track::ActionRemovePlugin::ActionRemovePlugin(track::pluginClipboardData data,
@@ -64,21 +79,29 @@ track::ActionRemovePlugin::ActionRemovePlugin(track::pluginClipboardData data,
                                               void *processor)
     : juce::UndoableAction() {
     this->subpluginData = data;
-    this->nodeRoute = route;
     this->p = processor;
     this->pluginIndex = index;
+
+    audioNode *node = utility::getNodeFromRoute(route, p);
+    this->nodeID = node->id;
+    this->pluginID = node->plugins[(size_t)index]->id;
 };
 track::ActionRemovePlugin::~ActionRemovePlugin(){};
 
 bool track::ActionRemovePlugin::perform() {
+    TRACE_SCOPE("ActionRemovePlugin::perform");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    std::vector<int> nodeRoute = processor->getRouteOfNode(nodeID);
+
     processor->dispatchGUIInstruction(UI_INSTRUCTION_CLOSE_OPENED_EDITORS,
                                       nullptr, nodeRoute);
     processor->dispatchGUIInstruction(
         UI_INSTRUCTION_CLOSE_OPENED_RELAY_PARAM_WINDOWS, nullptr, nodeRoute);
 
-    audioNode *node = utility::getNodeFromRoute(nodeRoute, p);
+    audioNode *node = processor->getNodeByID(nodeID);
     node->removePlugin(pluginIndex);
+    processor->reindexPlugins(*node);
 
     updateGUI();
 
@@ -92,18 +115,24 @@ bool track::ActionRemovePlugin::perform() {
 }
 
 bool track::ActionRemovePlugin::undo() {
+    TRACE_SCOPE("ActionRemovePlugin::undo");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    std::vector<int> nodeRoute = processor->getRouteOfNode(nodeID);
+
     processor->dispatchGUIInstruction(UI_INSTRUCTION_CLOSE_OPENED_EDITORS,
                                       nullptr, nodeRoute);
     processor->dispatchGUIInstruction(
         UI_INSTRUCTION_CLOSE_OPENED_RELAY_PARAM_WINDOWS, nullptr, nodeRoute);
 
-    audioNode *node = utility::getNodeFromRoute(nodeRoute, p);
+    audioNode *node = processor->getNodeByID(nodeID);
 
-    // readd plugin
+    // readd plugin, as the same plugin as far as ids go
     node->addPlugin(this->subpluginData.identifier.upToLastOccurrenceOf(
         ".vst3", true, true));
     utility::reorderPlugin(node->plugins.size() - 1, pluginIndex, node);
+    node->plugins[(size_t)pluginIndex]->id = pluginID;
+    processor->reindexPlugins(*node);
 
     // copy subplugin data back
     std::unique_ptr<track::subplugin> &plugin =
@@ -137,7 +166,7 @@ bool track::ActionRemovePlugin::undo() {
 void track::ActionRemovePlugin::updateGUI() {
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(UI_INSTRUCTION_RECREATE_ALL_PNCS, nullptr,
-                                      nodeRoute);
+                                      processor->getRouteOfNode(nodeID));
 }
 
 track::ActionReorderPlugin::ActionReorderPlugin(std::vector<int> nodeRoute,
@@ -145,7 +174,7 @@ track::ActionReorderPlugin::ActionReorderPlugin(std::vector<int> nodeRoute,
                                                 int destinationIndex,
                                                 void *processor)
     : juce::UndoableAction() {
-    this->route = nodeRoute;
+    this->nodeID = utility::getNodeFromRoute(nodeRoute, processor)->id;
     this->srcIndex = sourceIndex;
     this->destIndex = destinationIndex;
     this->p = processor;
@@ -153,36 +182,31 @@ track::ActionReorderPlugin::ActionReorderPlugin(std::vector<int> nodeRoute,
 track::ActionReorderPlugin::~ActionReorderPlugin(){};
 
 bool track::ActionReorderPlugin::perform() {
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
-    processor->dispatchGUIInstruction(UI_INSTRUCTION_CLOSE_OPENED_EDITORS,
-                                      nullptr, route);
-    processor->dispatchGUIInstruction(
-        UI_INSTRUCTION_CLOSE_OPENED_RELAY_PARAM_WINDOWS, nullptr, route);
+    TRACE_SCOPE("ActionReorderPlugin::perform");
 
-    audioNode *node = utility::getNodeFromRoute(route, p);
-    utility::reorderPlugin(srcIndex, destIndex, node);
-
-    updateGUI();
-
-    processor->dispatchGUIInstruction(UI_INSTRUCTION_OPEN_CLOSED_EDITORS,
-                                      nullptr, route);
-    processor->dispatchGUIInstruction(
-        UI_INSTRUCTION_OPEN_CLOSED_RELAY_PARAM_WINDOWS, nullptr, route);
+    reorder(srcIndex, destIndex);
+    return true;
+}
 
-    processor->requireSaving();
+bool track::ActionReorderPlugin::undo() {
+    TRACE_SCOPE("ActionReorderPlugin::undo");
 
+    reorder(destIndex, srcIndex);
     return true;
 }
 
-bool track::ActionReorderPlugin::undo() {
+void track::ActionReorderPlugin::reorder(int from, int to) {
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    std::vector<int> route = processor->getRouteOfNode(nodeID);
+
     processor->dispatchGUIInstruction(UI_INSTRUCTION_CLOSE_OPENED_EDITORS,
                                       nullptr, route);
     processor->dispatchGUIInstruction(
         UI_INSTRUCTION_CLOSE_OPENED_RELAY_PARAM_WINDOWS, nullptr, route);
 
-    audioNode *node = utility::getNodeFromRoute(route, p);
-    utility::reorderPlugin(srcIndex, destIndex, node);
+    audioNode *node = processor->getNodeByID(nodeID);
+    utility::reorderPlugin(from, to, node);
+    processor->reindexPlugins(*node);
 
     updateGUI();
 
@@ -192,14 +216,12 @@ bool track::ActionReorderPlugin::undo() {
         UI_INSTRUCTION_OPEN_CLOSED_RELAY_PARAM_WINDOWS, nullptr, route);
 
     processor->requireSaving();
-
-    return true;
 }
 
 void track::ActionReorderPlugin::updateGUI() {
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(UI_INSTRUCTION_RECREATE_ALL_PNCS, nullptr,
-                                      route);
+                                      processor->getRouteOfNode(nodeID));
 }
 
 track::ActionPastePlugin::ActionPastePlugin(track::pluginClipboardData data,
@@ -207,13 +229,16 @@ track::ActionPastePlugin::ActionPastePlugin(track::pluginClipboardData data,
                                             void *processor)
     : juce::UndoableAction() {
     this->subpluginData = data;
-    this->nodeRoute = route;
+    this->nodeID = utility::getNodeFromRoute(route, processor)->id;
     this->p = processor;
 }
 track::ActionPastePlugin::~ActionPastePlugin() {}
 
 bool track::ActionPastePlugin::perform() {
-    audioNode *node = utility::getNodeFromRoute(nodeRoute, p);
+    TRACE_SCOPE("ActionPastePlugin::perform");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
     juce::String cleanedIdentifier =
         subpluginData.identifier.upToLastOccurrenceOf(".vst3", true, true);
     node->addPlugin(cleanedIdentifier);
@@ -233,7 +258,7 @@ bool track::ActionPastePlugin::perform() {
     plugin->plugin->setStateInformation(pluginData.getData(),
                                         pluginData.getSize());
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    processor->reindexPlugins(*node);
     processor->requireSaving();
 
     updateGUI();
@@ -242,16 +267,21 @@ bool track::ActionPastePlugin::perform() {
 }
 
 bool track::ActionPastePlugin::undo() {
+    TRACE_SCOPE("ActionPastePlugin::undo");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    std::vector<int> nodeRoute = processor->getRouteOfNode(nodeID);
+
     processor->dispatchGUIInstruction(UI_INSTRUCTION_CLOSE_OPENED_EDITORS,
                                       nullptr, nodeRoute);
 
-    audioNode *node = utility::getNodeFromRoute(nodeRoute, p);
+    audioNode *node = processor->getNodeByID(nodeID);
     processor->dispatchGUIInstruction(
         UI_INSTRUCTION_CLOSE_ALL_RMC_WITH_ROUTE_AND_INDEX,
         (void *)((uintptr_t)node->plugins.size() - 1), nodeRoute);
 
     node->removePlugin(node->plugins.size() - 1);
+    processor->reindexPlugins(*node);
 
     updateGUI();
 
@@ -265,19 +295,22 @@ bool track::ActionPastePlugin::undo() {
 void track::ActionPastePlugin::updateGUI() {
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(UI_INSTRUCTION_RECREATE_ALL_PNCS, nullptr,
-                                      nodeRoute);
+                                      processor->getRouteOfNode(nodeID));
 }
 
 track::ActionPastePluginChain::ActionPastePluginChain(
     pluginChainClipboardData data, std::vector<int> route, void *processor) {
     this->chainData = data;
-    this->nodeRoute = route;
+    this->nodeID = utility::getNodeFromRoute(route, processor)->id;
     this->p = processor;
 }
 track::ActionPastePluginChain::~ActionPastePluginChain() {}
 
 bool track::ActionPastePluginChain::perform() {
-    audioNode *node = utility::getNodeFromRoute(nodeRoute, p);
+    TRACE_SCOPE("ActionPastePluginChain::perform");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
 
     for (pluginClipboardData &pluginClipboardData : chainData.plugins) {
         juce::String cleanedIdentifier =
@@ -302,19 +335,22 @@ bool track::ActionPastePluginChain::perform() {
                                             pluginData.getSize());
     }
 
-    updateGUI();
+    processor->reindexPlugins(*node);
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    updateGUI();
     processor->requireSaving();
 
     return true;
 }
 
 bool track::ActionPastePluginChain::undo() {
+    TRACE_SCOPE("ActionPastePluginChain::undo");
+
     DBG("ActionPastePluginChain::undo()");
 
-    audioNode *node = utility::getNodeFromRoute(nodeRoute, p);
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
+    std::vector<int> nodeRoute = processor->getRouteOfNode(nodeID);
 
     for (size_t i = 0; i < chainData.plugins.size(); ++i) {
         DBG("node->plugins.size() - 1 = " << node->plugins.size() - 1);
@@ -332,6 +368,8 @@ bool track::ActionPastePluginChain::undo() {
         node->removePlugin(node->plugins.size() - 1);
     }
 
+    processor->reindexPlugins(*node);
+
     updateGUI();
     processor->requireSaving();
 
@@ -341,7 +379,7 @@ bool track::ActionPastePluginChain::undo() {
 void track::ActionPastePluginChain::updateGUI() {
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(UI_INSTRUCTION_RECREATE_ALL_PNCS, nullptr,
-                                      nodeRoute);
+                                      processor->getRouteOfNode(nodeID));
 }
 
 track::ActionChangeTrivialPluginData::ActionChangeTrivialPluginData(
@@ -350,15 +388,19 @@ track::ActionChangeTrivialPluginData::ActionChangeTrivialPluginData(
     : juce::UndoableAction() {
     this->oldPluginData = oldData;
     this->newPluginData = newData;
-    this->route = nodeRoute;
-    this->index = pluginIndex;
     this->p = processor;
+
+    audioNode *node = utility::getNodeFromRoute(nodeRoute, p);
+    this->nodeID = node->id;
+    this->pluginID = node->plugins[(size_t)pluginIndex]->id;
 }
 track::ActionChangeTrivialPluginData::~ActionChangeTrivialPluginData() {}
 
 bool track::ActionChangeTrivialPluginData::perform() {
-    audioNode *node = utility::getNodeFromRoute(route, p);
-    subplugin *plugin = node->plugins[(size_t)index].get();
+    TRACE_SCOPE("ActionChangeTrivialPluginData::perform");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    subplugin *plugin = processor->getPluginByID(pluginID);
 
     plugin->bypassed = newPluginData.bypassed;
     plugin->dryWetMix = newPluginData.dryWetMix;
@@ -366,14 +408,15 @@ bool track::ActionChangeTrivialPluginData::perform() {
 
     updateGUI();
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->requireSaving();
 
     return true;
 }
 bool track::ActionChangeTrivialPluginData::undo() {
-    audioNode *node = utility::getNodeFromRoute(route, p);
-    subplugin *plugin = node->plugins[(size_t)index].get();
+    TRACE_SCOPE("ActionChangeTrivialPluginData::undo");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    subplugin *plugin = processor->getPluginByID(pluginID);
 
     plugin->bypassed = oldPluginData.bypassed;
     plugin->dryWetMix = oldPluginData.dryWetMix;
@@ -381,13 +424,13 @@ bool track::ActionChangeTrivialPluginData::undo() {
 
     updateGUI();
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->requireSaving();
 
     return true;
 }
 void track::ActionChangeTrivialPluginData::updateGUI() {
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    std::vector<int> route = processor->getRouteOfNode(nodeID);
 
     if (recreateAllPNCs) {
         processor->dispatchGUIInstruction(UI_INSTRUCTION_RECREATE_ALL_PNCS,
@@ -505,6 +548,8 @@ void track::PluginNodeComponent::mouseDown(const juce::MouseEvent &event) {
             juce::PopupMenu menu;
 
             menu.addItem("Copy plugin", [this] { copyPluginToClipboard(); });
+            menu.addItem("Reload plugin", getPlugin()->get()->faulted, false,
+                         [this] { reloadThisPlugin(); });
             menu.addSeparator();
             menu.addItem(
                 "Close editor",
@@ -581,7 +626,10 @@ void track::PluginNodeComponent::copyPluginToClipboard() {
     pluginInstance->get()->getStateInformation(pluginData);
     data->data = pluginData.toBase64Encoding();
 
-    clipboard::setData(data, TYPECODE_PLUGIN);
+    PluginChainComponent *pcc =
+        findParentComponentOfClass<PluginChainComponent>();
+    jassert(pcc != nullptr);
+    pcc->processor->clipboard.setData(data, TYPECODE_PLUGIN);
 
     // visual feedback
     coolColors = true;
@@ -612,6 +660,28 @@ void track::PluginNodeComponent::removeThisPlugin() {
     pcc->nodesViewport.setViewPosition(scroll, 0);
 }
 
+void track::PluginNodeComponent::reloadThisPlugin() {
+    PluginChainComponent *pcc =
+        findParentComponentOfClass<PluginChainComponent>();
+    jassert(pcc != nullptr);
+
+    // the editor and relay menus belong to the instance that's going away
+    AudioPluginAudioProcessorEditor *editor =
+        this->findParentComponentOfClass<AudioPluginAudioProcessorEditor>();
+    editor->closePluginEditorWindow(pcc->route, pluginIndex);
+    editor->closeAllRelayMenusWithRouteAndPluginIndex(pcc->route, pluginIndex);
+
+    if (!getPlugin()->get()->reload()) {
+        juce::NativeMessageBox::showMessageBoxAsync(
+            juce::MessageBoxIconType::WarningIcon, "Failed to reload plugin",
+            juce::String("Couldn't reload \"") + pluginName +
+                juce::String("\""));
+    }
+
+    updatePluginInformation();
+    repaint();
+}
+
 void track::PluginNodeComponent::toggleBypass() {
     getPlugin()->get()->bypassed = !getPlugin()->get()->bypassed;
 
@@ -672,6 +742,7 @@ void track::PluginNodeComponent::openThisPluginsRelayMenu() {
 void track::PluginNodeComponent::updatePluginInformation() {
     this->pluginName = getPlugin()->get()->plugin->getName();
     this->isBypassed = getPluginBypassedStatus();
+    this->isFaulted = getPlugin()->get()->faulted;
 
     PluginChainComponent *pcc =
         findParentComponentOfClass<PluginChainComponent>();
@@ -689,14 +760,15 @@ void track::PluginNodeComponent::paint(juce::Graphics &g) {
     else
         g.fillAll(juce::Colour(0xFF'FFFFFF));
 
-    // border
-    g.setColour(juce::Colours::lightgrey.withAlpha(.3f));
+    // border. faulted plugins are skipped until they're reloaded
+    g.setColour(isFaulted ? juce::Colour(0xFF'C04040)
+                          : juce::Colours::lightgrey.withAlpha(.3f));
     g.drawRect(getLocalBounds(), 1);
 
     g.setColour(juce::Colours::white);
 
-    g.setColour(
-        juce::Colour(0xFF'A7A7A7).withAlpha(this->isBypassed ? .3f : 1.f));
+    g.setColour(juce::Colour(0xFF'A7A7A7).withAlpha(
+        this->isBypassed || this->isFaulted ? .3f : 1.f));
 
 #if JUCE_WINDOWS
     auto pluginDataFont =
@@ -841,13 +913,16 @@ void track::PluginNodesWrapper::mouseDown(const juce::MouseEvent &event) {
                 });
         }
 
+        int copiedType = pcc->processor->clipboard.typecode;
+
         pluginMenu.addSubMenu("Add plugin", pluginSelector);
         pluginMenu.addItem(
-            "Paste plugin", clipboard::typecode == TYPECODE_PLUGIN, false,
+            "Paste plugin", copiedType == TYPECODE_PLUGIN, false,
             [this] {
-                if (clipboard::typecode == TYPECODE_PLUGIN) {
+                Clipboard &clipboard = pcc->processor->clipboard;
+                if (clipboard.typecode == TYPECODE_PLUGIN) {
                     pluginClipboardData *clipboardData =
-                        (pluginClipboardData *)clipboard::retrieveData();
+                        (pluginClipboardData *)clipboard.retrieveData();
 
                     ActionPastePlugin *action = new ActionPastePlugin(
                         *clipboardData, pcc->route, pcc->processor);
@@ -861,13 +936,14 @@ void track::PluginNodesWrapper::mouseDown(const juce::MouseEvent &event) {
             });
 
         pluginMenu.addItem(
-            "Paste plugin chain", clipboard::typecode == TYPECODE_PLUGIN_CHAIN,
+            "Paste plugin chain", copiedType == TYPECODE_PLUGIN_CHAIN,
             false, [this] {
                 DBG("paste plugin chain");
 
-                if (clipboard::typecode == TYPECODE_PLUGIN_CHAIN) {
+                Clipboard &clipboard = pcc->processor->clipboard;
+                if (clipboard.typecode == TYPECODE_PLUGIN_CHAIN) {
                     pluginChainClipboardData *data =
-                        (pluginChainClipboardData *)clipboard::retrieveData();
+                        (pluginChainClipboardData *)clipboard.retrieveData();
 
                     ActionPastePluginChain *action = new ActionPastePluginChain(
                         *data, pcc->route, pcc->processor);
@@ -908,7 +984,8 @@ void track::PluginNodesWrapper::mouseDown(const juce::MouseEvent &event) {
                 data->data = pluginData.toBase64Encoding();
             }
 
-            clipboard::setData(chainClipboardData, TYPECODE_PLUGIN_CHAIN);
+            pcc->processor->clipboard.setData(chainClipboardData,
+                                              TYPECODE_PLUGIN_CHAIN);
             DBG("plugin chain copied");
 
             // visual feedback
@@ -1231,7 +1308,7 @@ void track::PluginEditorWindow::paint(juce::Graphics &g) {
     g.setColour(juce::Colour(0xFF'D3D3D3));
     g.setFont(getInterBoldItalic().withHeight(17.f));
 
-    int latency = getPlugin()->get()->plugin->getLatencySamples();
+    int latency = getPlugin()->get()->getLatencySamples();
     float latencyMs =
         (latency / getPlugin()->get()->plugin->getSampleRate()) * 1000.f;
     juce::String otherInfoText =
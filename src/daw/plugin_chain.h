@@ -20,9 +20,11 @@ struct pluginChainClipboardData {
     std::vector<pluginClipboardData> plugins;
 };
 
+// like the node actions, these find their node (and plugin) by id
 class ActionAddPlugin : public juce::UndoableAction {
   public:
-    std::vector<int> nodeRoute;
+    int nodeID = -1;
+    int pluginID = -1; // picked on the first perform()
     juce::String pluginIdentifier = "unset identifier";
     void *p = nullptr;
 
@@ -44,7 +46,8 @@ class ActionRemovePlugin : public juce::UndoableAction {
     ~ActionRemovePlugin();
 
     pluginClipboardData subpluginData;
-    std::vector<int> nodeRoute;
+    int nodeID = -1;
+    int pluginID = -1;
     void *p = nullptr;
     int pluginIndex = -1;
 
@@ -61,12 +64,15 @@ class ActionReorderPlugin : public juce::UndoableAction {
 
     int srcIndex = -1;
     int destIndex = -1;
-    std::vector<int> route;
+    int nodeID = -1;
     void *p = nullptr;
 
     bool perform() override;
     bool undo() override;
     void updateGUI(); // y
+
+  private:
+    void reorder(int from, int to);
 };
 
 class ActionPastePlugin : public juce::UndoableAction {
@@ -76,7 +82,7 @@ class ActionPastePlugin : public juce::UndoableAction {
     ~ActionPastePlugin();
 
     pluginClipboardData subpluginData;
-    std::vector<int> nodeRoute;
+    int nodeID = -1;
     void *p = nullptr;
 
     bool perform() override;
@@ -91,7 +97,7 @@ class ActionPastePluginChain : public juce::UndoableAction {
     ~ActionPastePluginChain();
 
     pluginChainClipboardData chainData;
-    std::vector<int> nodeRoute;
+    int nodeID = -1;
     void *p = nullptr;
 
     bool perform() override;
@@ -109,8 +115,8 @@ class ActionChangeTrivialPluginData : public juce::UndoableAction {
 
     pluginClipboardData oldPluginData;
     pluginClipboardData newPluginData;
-    std::vector<int> route;
-    int index = -1;
+    int nodeID = -1;
+    int pluginID = -1;
     void *p = nullptr;
 
     bool perform() override;
@@ -136,12 +142,14 @@ class PluginNodeComponent : public SubwindowChildFocusGrabber {
 
     void copyPluginToClipboard();
     void removeThisPlugin();
+    void reloadThisPlugin();
     void toggleBypass();
     void openThisPluginsEditor();
     void openThisPluginsRelayMenu();
 
     juce::String pluginName;
     bool isBypassed;
+    bool isFaulted = false;
     void updatePluginInformation();
 
     void paint(juce::Graphics &g) override;
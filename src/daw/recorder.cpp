@@ -0,0 +1,338 @@
+#include "recorder.h"
+#include "../processor.h"
+#include "defs.h"
+#include "importer.h"
+#include "timeline.h"
+#include "track.h"
+#include <limits>
+
+namespace {
+void findArmedNodes(std::vector<track::audioNode> &nodes,
+                    std::vector<int> parentRoute,
+                    std::vector<std::vector<int>> *routes) {
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        std::vector<int> route = parentRoute;
+        route.push_back((int)i);
+
+        if (nodes[i].isTrack) {
+            if (nodes[i].recordArmed)
+                routes->push_back(route);
+        } else {
+            findArmedNodes(nodes[i].childNodes, route, routes);
+        }
+    }
+}
+} // namespace
+
+track::Recorder::Recorder() : juce::Thread("track recorder") {}
+track::Recorder::~Recorder() { stopThread(2000); }
+
+void track::Recorder::prepare(double sampleRate) {
+    AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+    jassert(p != nullptr);
+
+    // allocating a long fifo takes a while, so it's done before the audio
+    // thread gets locked out
+    int fifoSize = juce::jmax(1024, (int)(sampleRate * fifoSeconds));
+    std::unique_ptr<sampleFifo> newSamples =
+        std::make_unique<sampleFifo>(fifoSize);
+
+    // the writer might be halfway through the old buffer. stopping it also
+    // finishes off any take that was going
+    stopThread(2000);
+
+    {
+        const juce::ScopedLock sl(p->getCallbackLock());
+        std::swap(samples, newSamples);
+        eventFifo.reset();
+
+        pushedSamples = 0;
+        wasRecording = false;
+        recording = false;
+    }
+
+    writerSampleRate = sampleRate;
+    writtenSamples = 0;
+
+    DBG("recorder prepared with a fifo of " << fifoSize << " samples");
+
+    startThread();
+}
+
+void track::Recorder::resetCounters() {
+    droppedSamples = 0;
+    overruns = 0;
+    peakFifoUsage = 0;
+}
+
+bool track::Recorder::pushEvent(recordEvent e) {
+    int start1, size1, start2, size2;
+    eventFifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 == 0)
+        return false;
+
+    events[(size_t)start1] = e;
+    eventFifo.finishedWrite(1);
+    return true;
+}
+
+template <typename SampleType>
+void track::Recorder::processInput(const juce::AudioBuffer<SampleType> &input,
+                                   int numInputChannels, int timelineSample,
+                                   bool shouldRecord) {
+    // nothing in here allocates, locks or touches the file system
+    if (shouldRecord && !wasRecording) {
+        if (samples == nullptr)
+            return;
+
+        // try again next block if the writer is that far behind
+        if (!pushEvent({true, timelineSample, pushedSamples}))
+            return;
+
+        wasRecording = true;
+        recording = true;
+    }
+
+    else if (!shouldRecord && wasRecording) {
+        if (pushEvent({false, -1, pushedSamples})) {
+            wasRecording = false;
+            recording = false;
+        }
+
+        return;
+    }
+
+    if (!wasRecording)
+        return;
+
+    int numSamples = input.getNumSamples();
+    juce::AbstractFifo &fifo = samples->fifo;
+    juce::AudioBuffer<float> &fifoBuffer = samples->buffer;
+
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(numSamples, start1, size1, start2, size2);
+
+    int written = size1 + size2;
+    if (written < numSamples) {
+        droppedSamples += numSamples - written;
+        ++overruns;
+    }
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        if (numInputChannels == 0) {
+            fifoBuffer.clear(ch, start1, size1);
+            fifoBuffer.clear(ch, start2, size2);
+            continue;
+        }
+
+        // mono input gets recorded to both channels. takes are written as
+        // float either way
+        int srcChannel = ch % numInputChannels;
+
+        if constexpr (std::is_same_v<SampleType, float>) {
+            if (size1 > 0)
+                fifoBuffer.copyFrom(ch, start1, input, srcChannel, 0, size1);
+            if (size2 > 0)
+                fifoBuffer.copyFrom(ch, start2, input, srcChannel, size1,
+                                    size2);
+        } else {
+            const double *src = input.getReadPointer(srcChannel);
+            convertSamples(src, fifoBuffer.getWritePointer(ch, start1), size1);
+            convertSamples(src + size1, fifoBuffer.getWritePointer(ch, start2),
+                           size2);
+        }
+    }
+
+    fifo.finishedWrite(written);
+    pushedSamples += written;
+
+    int used = fifo.getNumReady();
+    if (used > peakFifoUsage.load())
+        peakFifoUsage = used;
+}
+
+template void
+track::Recorder::processInput(const juce::AudioBuffer<float> &, int, int,
+                              bool);
+template void
+track::Recorder::processInput(const juce::AudioBuffer<double> &, int, int,
+                              bool);
+
+void track::Recorder::run() {
+    while (!threadShouldExit()) {
+        drain();
+        wait(writerIntervalMs);
+    }
+
+    // whatever was left when the plugin got closed
+    drain();
+    if (inTake)
+        closeTake();
+}
+
+void track::Recorder::drain() {
+    for (;;) {
+        // peek at the next event without consuming it
+        int start1, size1, start2, size2;
+        eventFifo.prepareToRead(1, start1, size1, start2, size2);
+
+        bool hasEvent = size1 > 0;
+        recordEvent e;
+        if (hasEvent)
+            e = events[(size_t)start1];
+
+        if (!inTake) {
+            if (!hasEvent)
+                return;
+
+            eventFifo.finishedRead(1);
+
+            if (e.start)
+                openTake(e.timelineSample);
+
+            continue;
+        }
+
+        // only write up to the stop event, anything after belongs to the next
+        // take
+        juce::int64 limit = (hasEvent && !e.start)
+                                ? e.streamPosition
+                                : std::numeric_limits<juce::int64>::max();
+
+        juce::AbstractFifo &fifo = samples->fifo;
+        int ready = fifo.getNumReady();
+        int n = (int)juce::jmin((juce::int64)ready, limit - writtenSamples);
+
+        if (n > 0) {
+            fifo.prepareToRead(n, start1, size1, start2, size2);
+
+            // if the file couldn't be created, keep consuming so the fifo
+            // doesn't fill up
+            if (writer != nullptr) {
+                if (size1 > 0)
+                    writer->writeFromAudioSampleBuffer(samples->buffer,
+                                                       start1, size1);
+                if (size2 > 0)
+                    writer->writeFromAudioSampleBuffer(samples->buffer,
+                                                       start2, size2);
+            }
+
+            fifo.finishedRead(size1 + size2);
+            writtenSamples += size1 + size2;
+            currentTake.lengthInSamples += size1 + size2;
+            continue;
+        }
+
+        if (hasEvent && !e.start && writtenSamples >= e.streamPosition) {
+            eventFifo.finishedRead(1);
+            closeTake();
+            continue;
+        }
+
+        return;
+    }
+}
+
+void track::Recorder::openTake(int timelineSample) {
+    inTake = true;
+
+    currentTake = recordedTake();
+    currentTake.startSample = timelineSample;
+
+    juce::File dir = getRecordingsDirectory();
+    if (!dir.createDirectory().wasOk()) {
+        DBG("couldn't create " << dir.getFullPathName());
+        return;
+    }
+
+    juce::File f = dir.getNonexistentChildFile(
+        "take-" + juce::Time::getCurrentTime().formatted("%Y%m%d-%H%M%S"),
+        ".wav", false);
+    currentTake.path = f.getFullPathName();
+
+    std::unique_ptr<juce::FileOutputStream> stream =
+        std::make_unique<juce::FileOutputStream>(f);
+
+    if (stream->failedToOpen()) {
+        DBG("couldn't open " << currentTake.path);
+        return;
+    }
+
+    juce::WavAudioFormat wav;
+    writer.reset(wav.createWriterFor(stream.get(), writerSampleRate.load(),
+                                     (unsigned int)numChannels, 24,
+                                     juce::StringPairArray(), 0));
+
+    // writer owns the stream now
+    if (writer != nullptr)
+        stream.release();
+
+    DBG("recording to " << currentTake.path);
+}
+
+void track::Recorder::closeTake() {
+    inTake = false;
+
+    bool hasFile = writer != nullptr;
+    writer.reset(); // flushes and closes
+
+    if (!hasFile)
+        return;
+
+    if (currentTake.lengthInSamples == 0) {
+        juce::File(currentTake.path).deleteFile();
+        return;
+    }
+
+    DBG("finished take of " << currentTake.lengthInSamples << " samples");
+
+    recordedTake take = currentTake;
+    juce::WeakReference<Recorder> self(this);
+    juce::MessageManager::callAsync([self, take] {
+        if (self != nullptr)
+            self->takeFinished(take);
+    });
+}
+
+void track::Recorder::takeFinished(recordedTake take) {
+    AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+    jassert(p != nullptr);
+
+    std::vector<std::vector<int>> routes;
+    findArmedNodes(p->tracks, {}, &routes);
+
+    if (routes.size() == 0) {
+        DBG("no armed tracks left; keeping " << take.path);
+        return;
+    }
+
+    importRequest r;
+    r.sourcePath = take.path;
+    r.lengthInSamples = take.lengthInSamples;
+
+    // decoded in the background like any other import; the clips are
+    // placeholders until then
+    p->importer.queueDecode(r);
+
+    p->undoManager.beginNewTransaction("action record clips");
+
+    for (size_t i = 0; i < routes.size(); ++i) {
+        clip c;
+        c.path = take.path;
+        c.name = juce::File(take.path).getFileNameWithoutExtension();
+        c.startPositionSample = take.startSample;
+
+        ActionAddClip *action = new ActionAddClip(c, routes[i], p);
+        action->shouldUpdateGUI = i == routes.size() - 1;
+        p->undoManager.perform(action);
+    }
+}
+
+juce::File track::Recorder::getRecordingsDirectory() {
+    return juce::File::getSpecialLocation(
+               juce::File::SpecialLocationType::userApplicationDataDirectory)
+        .getChildFile("johnmanjohnston")
+        .getChildFile("track")
+        .getChildFile("recordings");
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <memory>
+
+namespace track {
+// a finished take, handed over to the message thread
+struct recordedTake {
+    juce::String path;
+    int startSample = -1; // timeline position recording started at
+    int lengthInSamples = 0;
+};
+
+// records the plugin's input into armed tracks while the transport is
+// playing. the audio thread only pushes into lock-free fifos; this thread owns
+// the file and the writer, and the clip gets created on the message thread
+class Recorder : public juce::Thread {
+  public:
+    Recorder();
+    ~Recorder() override;
+
+    void *processor = nullptr;
+
+    static constexpr int numChannels = 2;
+    static constexpr int maxEvents = 64;
+    static constexpr int writerIntervalMs = 5;
+
+    // allocates the fifo; not from the audio thread. a take that's still
+    // going gets closed. the new fifo is built before taking the callback
+    // lock, which is then only held to swap it in
+    void prepare(double sampleRate);
+    double fifoSeconds = 30.0;
+    int getFifoSize() { return samples == nullptr ? 0 : samples->getSize(); }
+
+    // audio thread. input is whatever the host gave processBlock()
+    template <typename SampleType>
+    void processInput(const juce::AudioBuffer<SampleType> &input,
+                      int numInputChannels, int timelineSample,
+                      bool shouldRecord);
+    bool isRecording() { return recording.load(); }
+
+    // for sizing the fifo. dropped samples mean the writer fell behind by more
+    // than fifoSeconds; the take will be shorter than the time it covered
+    std::atomic<juce::int64> droppedSamples{0};
+    std::atomic<int> overruns{0}; // blocks that didn't fit entirely
+    std::atomic<int> peakFifoUsage{0};
+    void resetCounters();
+
+    juce::File getRecordingsDirectory();
+
+    void run() override;
+    void takeFinished(recordedTake take); // message thread
+
+  private:
+    struct recordEvent {
+        bool start = false;
+        int timelineSample = -1;
+        juce::int64 streamPosition = 0; // samples pushed before this event
+    };
+
+    struct sampleFifo {
+        explicit sampleFifo(int size) : fifo(size), buffer(numChannels, size) {}
+        int getSize() { return fifo.getTotalSize(); }
+
+        juce::AbstractFifo fifo;
+        juce::AudioBuffer<float> buffer;
+    };
+
+    // swapped whole by prepare() while the writer is stopped
+    std::unique_ptr<sampleFifo> samples;
+
+    juce::AbstractFifo eventFifo{maxEvents};
+    std::array<recordEvent, maxEvents> events;
+    bool pushEvent(recordEvent e);
+
+    std::atomic<bool> recording{false};
+    std::atomic<double> writerSampleRate{44100.0};
+
+    // audio thread only
+    juce::int64 pushedSamples = 0;
+    bool wasRecording = false;
+
+    // writer thread only
+    std::unique_ptr<juce::AudioFormatWriter> writer;
+    bool inTake = false;
+    recordedTake currentTake;
+    juce::int64 writtenSamples = 0;
+    void drain();
+    void openTake(int timelineSample);
+    void closeTake();
+
+    JUCE_DECLARE_WEAK_REFERENCEABLE(Recorder)
+};
+} // namespace track
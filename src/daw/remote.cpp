@@ -0,0 +1,115 @@
+#include "remote.h"
+#include <cmath>
+
+namespace {
+// surfaces send ints and floats more or less interchangeably. nan if it's
+// neither
+float getNumber(const juce::OSCMessage &message, int index) {
+    if (index >= message.size())
+        return std::nanf("");
+
+    const juce::OSCArgument &arg = message[index];
+
+    if (arg.isFloat32())
+        return arg.getFloat32();
+    if (arg.isInt32())
+        return (float)arg.getInt32();
+
+    return std::nanf("");
+}
+} // namespace
+
+track::RemoteControl::RemoteControl() { receiver.addListener(this); }
+
+track::RemoteControl::~RemoteControl() {
+    receiver.removeListener(this);
+    receiver.disconnect();
+}
+
+void track::RemoteControl::setPort(int newPort) {
+    receiver.disconnect();
+
+    port = juce::jmax(0, newPort);
+    if (port == 0)
+        return;
+
+    if (!receiver.connect(port)) {
+        DBG("remote control couldn't listen on port " << port);
+        port = 0;
+    }
+}
+
+void track::RemoteControl::push(remoteCommand c) {
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 == 0) {
+        ++droppedCommands;
+        return;
+    }
+
+    commands[(size_t)start1] = c;
+    fifo.finishedWrite(1);
+}
+
+bool track::RemoteControl::pop(remoteCommand &c) {
+    int start1, size1, start2, size2;
+    fifo.prepareToRead(1, start1, size1, start2, size2);
+
+    if (size1 == 0)
+        return false;
+
+    c = commands[(size_t)start1];
+    fifo.finishedRead(1);
+    return true;
+}
+
+void track::RemoteControl::oscMessageReceived(const juce::OSCMessage &message) {
+    juce::String address = message.getAddressPattern().toString();
+
+    static const std::pair<const char *, int> addresses[] = {
+        {"/track/node/gain", remoteCommand::gain},
+        {"/track/node/pan", remoteCommand::pan},
+        {"/track/node/mute", remoteCommand::mute},
+        {"/track/node/solo", remoteCommand::solo},
+        {"/track/plugin/bypass", remoteCommand::bypass},
+        {"/track/plugin/drywet", remoteCommand::dryWet},
+        {"/track/plugin/relay", remoteCommand::relay},
+    };
+
+    remoteCommand c;
+    c.type = -1;
+    for (auto &[pattern, type] : addresses) {
+        if (address == pattern)
+            c.type = type;
+    }
+
+    if (c.type == -1)
+        return;
+
+    bool isRelay = c.type == remoteCommand::relay;
+    float id = getNumber(message, 0);
+    float index = isRelay ? getNumber(message, 1) : 0.f;
+    float value = getNumber(message, isRelay ? 2 : 1);
+
+    if (std::isnan(id) || std::isnan(index) || std::isnan(value))
+        return;
+
+    c.id = (int)id;
+    c.index = isRelay ? (int)index : -1;
+
+    switch (c.type) {
+    case remoteCommand::gain:
+        // same range as the gain sliders
+        c.value = juce::jlimit(0.f, juce::Decibels::decibelsToGain(6.f), value);
+        break;
+    case remoteCommand::pan:
+        c.value = juce::jlimit(-1.f, 1.f, value);
+        break;
+    default:
+        c.value = juce::jlimit(0.f, 1.f, value);
+        break;
+    }
+
+    push(c);
+}
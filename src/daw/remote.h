@@ -0,0 +1,59 @@
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+namespace track {
+// one change from a control surface, waiting for the audio thread
+struct remoteCommand {
+    enum kind { gain, pan, mute, solo, bypass, dryWet, relay };
+
+    int type = gain;
+    int id = -1;    // node id, or plugin id for bypass/dryWet/relay
+    int index = -1; // relay only; which of the plugin's relay params
+    float value = 0.f;
+};
+
+// osc server for control surfaces and automation scripts. messages get parsed
+// on the receiver's own thread and pushed into a fifo, which the audio thread
+// empties at the start of every block (see
+// AudioPluginAudioProcessor::applyRemoteCommands()). neither side ever waits
+// on the other, and none of it goes through the message thread or the undo
+// history. ids are the ones from AudioPluginAudioProcessor::rebuildNodeIndex()
+//
+//   /track/node/gain <node id> <gain>
+//   /track/node/pan <node id> <-1..1>
+//   /track/node/mute <node id> <0|1>
+//   /track/node/solo <node id> <0|1>
+//   /track/plugin/bypass <plugin id> <0|1>
+//   /track/plugin/drywet <plugin id> <0..1>
+//   /track/plugin/relay <plugin id> <relay param index> <0..1>
+class RemoteControl
+    : private juce::OSCReceiver::Listener<
+          juce::OSCReceiver::RealtimeCallback> {
+  public:
+    RemoteControl();
+    ~RemoteControl() override;
+
+    static constexpr int maxCommands = 1024;
+
+    // message thread. 0 turns it off
+    void setPort(int newPort);
+    int getPort() { return port; }
+
+    // audio thread. false once there's nothing left
+    bool pop(remoteCommand &c);
+
+    std::atomic<int> droppedCommands{0}; // fifo was full
+
+  private:
+    juce::OSCReceiver receiver{"track remote"};
+    int port = 0;
+
+    juce::AbstractFifo fifo{maxCommands};
+    std::array<remoteCommand, maxCommands> commands;
+
+    void oscMessageReceived(const juce::OSCMessage &message) override;
+    void push(remoteCommand c);
+};
+} // namespace track
@@ -0,0 +1,365 @@
+#include "resampler.h"
+#include "diskcache.h"
+#include <cmath>
+#include <cstdint>
+#include <map>
+
+using SIMDFloat = juce::dsp::SIMDRegister<float>;
+
+namespace {
+// zeroth order modified bessel function of the first kind, for the kaiser
+// window
+double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    double halfX = x * 0.5;
+
+    for (int k = 1; k < 64; ++k) {
+        term *= (halfX / k) * (halfX / k);
+        sum += term;
+
+        if (term < sum * 1e-12)
+            break;
+    }
+
+    return sum;
+}
+} // namespace
+
+void track::polyphaseTable::build(double newRatio, int baseTaps) {
+    const int w = (int)SIMDFloat::SIMDNumElements;
+
+    ratio = newRatio;
+
+    double scale = juce::jmin(1.0, ratio);
+
+    taps = (int)std::ceil(baseTaps / scale);
+    taps = juce::jmin(taps, 4096);
+    taps = ((taps + (2 * w) - 1) / (2 * w)) * (2 * w);
+    paddedTaps = taps + w;
+
+    // kaiser's estimate of the transition width for this length/beta, as a
+    // fraction of nyquist; center the cutoff so the stopband starts at nyquist
+    double attenuation = kaiserBeta / 0.1102 + 8.7;
+    double transition = (attenuation - 8.0) /
+                        (2.285 * juce::MathConstants<double>::pi * taps * scale);
+    double cutoff = (1.0 - transition / 2.0) * scale;
+
+    size_t numFloats =
+        (size_t)w * (size_t)(numPhases + 1) * (size_t)paddedTaps + (size_t)w;
+    storage.assign(numFloats, 0.f);
+    data = juce::snapPointerToAlignment(storage.data(),
+                                        SIMDFloat::SIMDRegisterSize);
+
+    int halfTaps = taps / 2;
+    double i0Beta = besselI0(kaiserBeta);
+
+    std::vector<float> row((size_t)taps);
+
+    for (int p = 0; p <= numPhases; ++p) {
+        double frac = (double)p / numPhases;
+
+        for (int k = 0; k < taps; ++k) {
+            // distance from the output position to input sample k
+            double d = frac + halfTaps - 1 - k;
+            double x = d / halfTaps;
+
+            double window = 0.0;
+            if (std::abs(x) <= 1.0)
+                window = besselI0(kaiserBeta * std::sqrt(1.0 - x * x)) / i0Beta;
+
+            double arg = juce::MathConstants<double>::pi * cutoff * d;
+            double sinc = juce::approximatelyEqual(d, 0.0)
+                              ? 1.0
+                              : std::sin(arg) / arg;
+
+            row[(size_t)k] = (float)(cutoff * sinc * window);
+        }
+
+        for (int shift = 0; shift < w; ++shift) {
+            std::copy(row.begin(), row.end(), getRow(shift, p) + shift);
+        }
+    }
+}
+
+float track::polyphaseTable::interpolate(const float *in, int length,
+                                         double pos) const {
+    const int w = (int)SIMDFloat::SIMDNumElements;
+    int halfTaps = taps / 2;
+
+    int i = (int)std::floor(pos);
+    double phase = (pos - i) * numPhases;
+    int p = juce::jlimit(0, numPhases - 1, (int)phase);
+    float fraction = (float)(phase - p);
+
+    // first input sample under the filter, and how far it is past the last
+    // aligned address
+    int s = i - halfTaps + 1;
+    int inShift =
+        (int)(((std::uintptr_t)in % SIMDFloat::SIMDRegisterSize) / sizeof(float));
+    int shift = (((s + inShift) % w) + w) % w;
+    int alignedStart = s - shift;
+
+    const float *k0 = getRow(shift, p);
+    const float *k1 = getRow(shift, p + 1);
+
+    // near either end of the buffer; do it the slow way with bounds checks
+    if (alignedStart < 0 || alignedStart + paddedTaps > length) {
+        k0 = getRow(0, p);
+        k1 = getRow(0, p + 1);
+
+        float acc = 0.f;
+        for (int k = juce::jmax(0, -s); k < taps && s + k < length; ++k)
+            acc += in[s + k] * (k0[k] + (k1[k] - k0[k]) * fraction);
+
+        return acc;
+    }
+
+    // interpolate between adjacent phases while accumulating
+    const float *x = in + alignedStart;
+    SIMDFloat f = SIMDFloat::expand(fraction);
+    SIMDFloat acc = SIMDFloat::expand(0.f);
+
+    for (int j = 0; j < paddedTaps; j += w) {
+        SIMDFloat c0 = SIMDFloat::fromRawArray(k0 + j);
+        SIMDFloat c1 = SIMDFloat::fromRawArray(k1 + j);
+        SIMDFloat c = c0 + ((c1 - c0) * f);
+
+        acc = acc + (SIMDFloat::fromRawArray(x + j) * c);
+    }
+
+    return acc.sum();
+}
+
+track::SampleRateConverter::SampleRateConverter() : pool() {}
+track::SampleRateConverter::~SampleRateConverter() {
+    pool.removeAllJobs(true, 5000);
+}
+
+bool track::SampleRateConverter::process(const juce::AudioBuffer<float> &input,
+                                         double inputRate,
+                                         juce::AudioBuffer<float> &output,
+                                         double outputRate,
+                                         std::atomic<float> *progress) {
+    if (inputRate <= 0.0 || outputRate <= 0.0)
+        return false;
+
+    int numChannels = input.getNumChannels();
+    int inLength = input.getNumSamples();
+    int outLength = (int)((double)inLength * outputRate / inputRate);
+
+    output.setSize(numChannels, outLength, false, true, false);
+
+    if (juce::approximatelyEqual(inputRate, outputRate)) {
+        output.makeCopyOf(input);
+
+        if (progress != nullptr)
+            progress->store(1.f);
+
+        return true;
+    }
+
+    if (numChannels == 0 || outLength == 0) {
+        if (progress != nullptr)
+            progress->store(1.f);
+
+        return true;
+    }
+
+    polyphaseTable table;
+    table.build(outputRate / inputRate, baseTaps);
+
+    double step = inputRate / outputRate;
+    int numChunks = (outLength + chunkSize - 1) / chunkSize;
+    int numJobs = numChunks * numChannels;
+
+    DBG("converting " << inLength << " samples to " << outLength << " with "
+                      << table.taps << " taps, " << numJobs << " jobs");
+
+    auto inputs = input.getArrayOfReadPointers();
+    auto outputs = output.getArrayOfWritePointers();
+
+    std::atomic<int> remaining{numJobs};
+    juce::WaitableEvent finished;
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        for (int chunk = 0; chunk < numChunks; ++chunk) {
+            int start = chunk * chunkSize;
+            int end = juce::jmin(outLength, start + chunkSize);
+
+            pool.addJob([&, ch, start, end] {
+                for (int n = start; n < end; ++n)
+                    outputs[ch][n] =
+                        table.interpolate(inputs[ch], inLength, n * step);
+
+                int left = --remaining;
+
+                if (progress != nullptr)
+                    progress->store(1.f - (float)left / (float)numJobs);
+
+                if (left == 0)
+                    finished.signal();
+            });
+        }
+    }
+
+    finished.wait();
+    return true;
+}
+
+std::shared_ptr<const track::polyphaseTable>
+track::resampler::getPlaybackTable(double sourceRate, double hostRate) {
+    static juce::CriticalSection lock;
+    static std::map<std::pair<int, int>, std::shared_ptr<polyphaseTable>>
+        tables;
+
+    std::pair<int, int> key = {juce::roundToInt(sourceRate),
+                               juce::roundToInt(hostRate)};
+
+    const juce::ScopedLock sl(lock);
+
+    auto &table = tables[key];
+    if (table == nullptr) {
+        DBG("building playback table for " << key.first << " -> "
+                                           << key.second);
+        table = std::make_shared<polyphaseTable>();
+        table->build(hostRate / sourceRate, playbackTaps);
+    }
+
+    return table;
+}
+
+juce::File track::resampler::getCacheDirectory() {
+    return juce::File::getSpecialLocation(
+               juce::File::SpecialLocationType::userApplicationDataDirectory)
+        .getChildFile("johnmanjohnston")
+        .getChildFile("track")
+        .getChildFile("cache")
+        .getChildFile("resampled");
+}
+
+juce::String track::resampler::getSourceHash(juce::String path) {
+    struct knownHash {
+        juce::int64 size = -1;
+        juce::Time modified;
+        juce::String hash;
+    };
+
+    static juce::CriticalSection lock;
+    static std::map<juce::String, knownHash> known;
+
+    juce::File file(path);
+    juce::int64 size = file.getSize();
+    juce::Time modified = file.getLastModificationTime();
+
+    {
+        const juce::ScopedLock sl(lock);
+
+        auto it = known.find(path);
+        if (it != known.end() && it->second.size == size &&
+            it->second.modified == modified)
+            return it->second.hash;
+    }
+
+    juce::FileInputStream stream{file};
+
+    if (!stream.openedOk())
+        return "";
+
+    // streamed, so this never holds more than juce::MD5's buffer
+    juce::String hash = juce::MD5(stream).toHexString();
+
+    const juce::ScopedLock sl(lock);
+    known[path] = {size, modified, hash};
+
+    return hash;
+}
+
+juce::String track::resampler::getCachedPath(juce::String path,
+                                             double sampleRate) {
+    juce::String hash = getSourceHash(path);
+
+    if (hash.isEmpty())
+        return "";
+
+    // ex., ~/.config/johnmanjohnston/track/cache/resampled/1f3e...-44100hz.wav
+    return getCacheDirectory()
+        .getChildFile(hash + "-" + juce::String(juce::roundToInt(sampleRate)) +
+                      "hz.wav")
+        .getFullPathName();
+}
+
+juce::String track::resampler::resampleToCache(juce::String path,
+                                               double sampleRate,
+                                               SampleRateConverter &converter,
+                                               std::atomic<float> *progress) {
+    juce::String cachedPath = getCachedPath(path, sampleRate);
+
+    if (cachedPath.isEmpty())
+        return "";
+
+    juce::File cachedFile(cachedPath);
+
+    if (cachedFile.existsAsFile() && cachedFile.getSize() > 0) {
+        DBG("resampled file already cached for " << path);
+        diskcache::touch(cachedFile);
+
+        if (progress != nullptr)
+            progress->store(1.f);
+
+        return cachedPath;
+    }
+
+    juce::AudioFormatManager afm;
+    afm.registerBasicFormats();
+    std::unique_ptr<juce::AudioFormatReader> reader(
+        afm.createReaderFor(juce::File(path)));
+
+    if (reader == nullptr)
+        return "";
+
+    juce::AudioBuffer<float> original((int)reader->numChannels,
+                                      (int)reader->lengthInSamples);
+    reader->read(&original, 0, original.getNumSamples(), 0, true, true);
+
+    juce::AudioBuffer<float> resampled;
+    if (!converter.process(original, reader->sampleRate, resampled, sampleRate,
+                           progress))
+        return "";
+
+    if (!getCacheDirectory().createDirectory().wasOk())
+        return "";
+
+    // write to a temp file first so that a half-written file never looks like
+    // a cache hit. always float wav, so nothing gets requantized
+    juce::TemporaryFile tmp(cachedFile);
+
+    {
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::FileOutputStream> stream =
+            std::make_unique<juce::FileOutputStream>(tmp.getFile());
+
+        if (stream->failedToOpen())
+            return "";
+
+        std::unique_ptr<juce::AudioFormatWriter> writer(wav.createWriterFor(
+            stream.get(), sampleRate, (unsigned int)resampled.getNumChannels(),
+            32, juce::StringPairArray(), 0));
+
+        if (writer == nullptr)
+            return "";
+
+        // writer owns the stream now
+        stream.release();
+
+        writer->writeFromAudioSampleBuffer(resampled, 0,
+                                           resampled.getNumSamples());
+    }
+
+    if (!tmp.overwriteTargetFileWithTemporary())
+        return "";
+
+    DBG("written succesfully to " << cachedPath);
+    diskcache::trim(cachedFile);
+    return cachedPath;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+
+namespace track {
+// kaiser windowed-sinc filter, stored as a polyphase table. every phase is
+// stored once per possible alignment of the first input sample (shifted right
+// by that many zeros), so the inner loop can always start on an aligned input
+// address and use aligned simd loads
+struct polyphaseTable {
+    static constexpr int numPhases = 256;
+    static constexpr double kaiserBeta = 9.0;
+
+    double ratio = 1.0; // output rate / input rate
+    int taps = 0;       // multiple of the simd width
+    int paddedTaps = 0; // taps + one register worth of zeros
+    std::vector<float> storage;
+    float *data = nullptr;
+
+    // taps gets stretched when downsampling so that the transition band
+    // stays the same relative to the output nyquist
+    void build(double newRatio, int baseTaps);
+
+    float *getRow(int shift, int phase) const {
+        return data + ((size_t)shift * (numPhases + 1) + (size_t)phase) *
+                          (size_t)paddedTaps;
+    }
+
+    // value of in at fractional position pos (in input samples). anything
+    // outside [0, length) counts as silence. realtime safe
+    float interpolate(const float *in, int length, double pos) const;
+};
+
+// band-limited sample rate converter for whole files. output gets split into
+// chunks which are converted in parallel on the converter's own thread pool
+class SampleRateConverter {
+  public:
+    SampleRateConverter();
+    ~SampleRateConverter();
+
+    static constexpr int baseTaps = 128;
+    static constexpr int chunkSize = 1 << 16; // output samples per job
+
+    // blocking; progress (0..1) gets written to as chunks finish
+    bool process(const juce::AudioBuffer<float> &input, double inputRate,
+                 juce::AudioBuffer<float> &output, double outputRate,
+                 std::atomic<float> *progress = nullptr);
+
+  private:
+    juce::ThreadPool pool;
+};
+
+namespace resampler {
+// shorter filter than the offline converter, since this runs for every
+// playing clip whose rate doesn't match the host's
+constexpr int playbackTaps = 64;
+
+// tables are shared between every clip playing at the same pair of rates.
+// builds one if needed, so don't call this from the audio thread
+std::shared_ptr<const polyphaseTable> getPlaybackTable(double sourceRate,
+                                                       double hostRate);
+
+// resampled files live here instead of next to the source file
+juce::File getCacheDirectory();
+
+// identifies the source file's content, so moving/renaming it still hits the
+// cache. the whole file gets hashed, so the first call for a file is as slow
+// as reading it; after that it's remembered until the file's size or
+// modification time changes
+juce::String getSourceHash(juce::String path);
+
+// where the resampled version of path would be; doesn't create anything
+juce::String getCachedPath(juce::String path, double sampleRate);
+
+// returns the cached file if there is one, otherwise decodes, converts and
+// writes it. returns an empty string on failure
+juce::String resampleToCache(juce::String path, double sampleRate,
+                             SampleRateConverter &converter,
+                             std::atomic<float> *progress = nullptr);
+} // namespace resampler
+} // namespace track
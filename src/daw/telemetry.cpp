@@ -0,0 +1,150 @@
+#include "telemetry.h"
+#include <map>
+
+#if JUCE_LINUX
+#include <unistd.h>
+#elif JUCE_MAC
+#include <mach/mach.h>
+#elif JUCE_WINDOWS
+#include <windows.h>
+#include <psapi.h>
+#endif
+
+namespace {
+// 0 if we can't tell
+juce::int64 getResidentBytes() {
+#if JUCE_LINUX
+    juce::StringArray fields = juce::StringArray::fromTokens(
+        juce::File("/proc/self/statm").loadFileAsString(), true);
+
+    if (fields.size() < 2)
+        return 0;
+
+    return fields[1].getLargeIntValue() * (juce::int64)sysconf(_SC_PAGESIZE);
+#elif JUCE_MAC
+    mach_task_basic_info info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info,
+                  &count) != KERN_SUCCESS)
+        return 0;
+
+    return (juce::int64)info.resident_size;
+#elif JUCE_WINDOWS
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+                              sizeof(counters)))
+        return 0;
+
+    return (juce::int64)counters.WorkingSetSize;
+#else
+    return 0;
+#endif
+}
+} // namespace
+
+track::Telemetry::Telemetry() : juce::Thread("track telemetry") {}
+track::Telemetry::~Telemetry() { setPort(0); }
+
+void track::Telemetry::setPort(int newPort) {
+    enabled = false;
+    stopThread(2000);
+    sender.disconnect();
+
+    port = juce::jmax(0, newPort);
+    if (port == 0)
+        return;
+
+    if (!sender.connect("127.0.0.1", port)) {
+        DBG("telemetry couldn't connect to port " << port);
+        port = 0;
+        return;
+    }
+
+    enabled = true;
+    startThread(juce::Thread::Priority::low);
+}
+
+void track::Telemetry::push(telemetryEvent e) {
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+    if (size1 == 0) {
+        ++droppedEvents;
+        return;
+    }
+
+    events[(size_t)start1] = e;
+    fifo.finishedWrite(1);
+}
+
+void track::Telemetry::run() {
+    // seconds spent and seconds of audio, per id
+    std::map<int, std::pair<double, double>> nodeSeconds;
+    std::map<int, std::pair<double, double>> pluginSeconds;
+
+    // whatever's left over is from before it was turned off. this is the
+    // only reader, so it can drop it without racing the audio thread
+    fifo.finishedRead(fifo.getNumReady());
+
+    while (!threadShouldExit()) {
+        wait(publishIntervalMs);
+
+        int blocks = 0;
+        double budget = 0.0;
+        float maxSeconds = 0.f;
+        float peakLoad = 0.f;
+        nodeSeconds.clear();
+        pluginSeconds.clear();
+
+        int start1, size1, start2, size2;
+        fifo.prepareToRead(fifo.getNumReady(), start1, size1, start2, size2);
+
+        auto add = [&](int start, int size) {
+            for (int i = start; i < start + size; ++i) {
+                const telemetryEvent &e = events[(size_t)i];
+
+                if (e.type == telemetryEvent::block) {
+                    ++blocks;
+                    budget += e.budget;
+                    maxSeconds = juce::jmax(maxSeconds, e.seconds);
+                    if (e.budget > 0.f)
+                        peakLoad = juce::jmax(peakLoad, e.seconds / e.budget);
+                } else {
+                    auto &totals = e.type == telemetryEvent::node
+                                       ? nodeSeconds[e.id]
+                                       : pluginSeconds[e.id];
+                    totals.first += e.seconds;
+                    totals.second += e.budget;
+                }
+            }
+        };
+
+        add(start1, size1);
+        add(start2, size2);
+        fifo.finishedRead(size1 + size2);
+
+        if (blocks > 0 && budget > 0.0) {
+            sender.send("/track/block", maxSeconds * 1000.f, peakLoad, blocks);
+
+        }
+
+        for (auto &[id, totals] : nodeSeconds) {
+            if (totals.second > 0.0)
+                sender.send("/track/node", id,
+                            (float)(totals.first / totals.second));
+        }
+
+        for (auto &[id, totals] : pluginSeconds) {
+            if (totals.second > 0.0)
+                sender.send("/track/plugin", id,
+                            (float)(totals.first / totals.second));
+        }
+
+        sender.send("/track/xruns", xruns.load());
+        sender.send("/track/underruns", underruns.load());
+        sender.send("/track/memory",
+                    (float)((double)getResidentBytes() / (1024.0 * 1024.0)));
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+
+namespace track {
+// one measurement from the audio thread. fixed size, so these go through a
+// fifo without anything being allocated
+struct telemetryEvent {
+    enum kind { block, node, plugin };
+
+    int type = block;
+    int id = -1;         // node or plugin id; unused for blocks
+    float seconds = 0.f; // time spent
+
+    // how much audio seconds was spent on: one block for blocks, everything
+    // since the last flush for nodes and plugins (see accumulateInterval)
+    float budget = 0.f;
+};
+
+// engine metrics, sent as osc to a port on localhost while it's turned on.
+// the audio thread only pushes events into a fifo; this thread sums them up
+// and sends them every publishIntervalMs:
+//
+//   /track/block <max callback ms> <peak load> <number of blocks>
+//   /track/node <node id> <load>        (includes the node's plugins)
+//   /track/plugin <plugin id> <load>
+//   /track/xruns <count>     callbacks that took longer than their block
+//   /track/underruns <count> mapped clip reads the prefetcher hadn't covered
+//   /track/memory <mb>       resident size of the whole process
+//
+// loads are fractions of the time the audio thread had over the interval
+class Telemetry : public juce::Thread {
+  public:
+    Telemetry();
+    ~Telemetry() override;
+
+    static constexpr int maxEvents = 8192;
+    static constexpr int publishIntervalMs = 100;
+
+    // nodes and plugins are timed into totals on the audio side, which only
+    // go through the fifo (one event per node and plugin) once this much
+    // audio has been rendered. shorter than publishIntervalMs, so nearly
+    // every publish has something for each of them
+    static constexpr double accumulateInterval = 0.05;
+
+    // message thread. 0 turns it off. the audio thread may still be in the
+    // middle of a push() when this is called, so the fifo is only ever
+    // emptied from the reading side
+    void setPort(int newPort);
+    int getPort() { return port; }
+
+    bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    // audio thread. dropped if the fifo is full
+    void push(telemetryEvent e);
+
+    // counted whether it's on or not, so they're right once it is
+    std::atomic<int> xruns{0};
+    std::atomic<int> underruns{0};
+    std::atomic<int> droppedEvents{0};
+
+    void run() override;
+
+  private:
+    juce::AbstractFifo fifo{maxEvents};
+    std::array<telemetryEvent, maxEvents> events;
+
+    std::atomic<bool> enabled{false};
+    int port = 0;
+    juce::OSCSender sender; // publisher thread only while it's running
+};
+} // namespace track
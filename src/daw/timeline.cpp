@@ -1,98 +1,203 @@
 #include "timeline.h"
 #include "clipboard.h"
 #include "defs.h"
+#include "trace.h"
 #include "track.h"
 #include "utility.h"
+#include <algorithm>
 #include <cmath>
 #include <functional>
 #include <memory>
+#include <unordered_map>
 
 track::BarNumbersComponent::BarNumbersComponent() : juce::Component() {
     setInterceptsMouseClicks(false, false);
 }
 
 track::BarNumbersComponent::~BarNumbersComponent() {}
-void track::BarNumbersComponent::paint(juce::Graphics &g) {
-    g.fillAll(juce::Colour(0xDD'2E2E2E));
+namespace {
+float getPxPerBar(const track::engineContext &ctx) {
+    // TODO: make this work for other time signatures
+    // assuming 4/4 time signature
+    float secondsPerBeat = 60.f / ctx.bpm;
+    float pxPerSecond = ctx.zoomMultiplier;
+    return secondsPerBeat * pxPerSecond * 4;
+}
+} // namespace
 
-    // bar markers
-    float secondsPerBeat = 60.f / BPM;
-    float pxPerSecond = UI_ZOOM_MULTIPLIER;
-    float pxPerBeat = secondsPerBeat * pxPerSecond;
+void track::TileCache::draw(juce::Graphics &g, juce::String key,
+                            int tileHeight, const renderer &render) {
+    if (tileHeight <= 0)
+        return;
 
-    int beats = this->getWidth() / pxPerBeat;
+    // render at the display's scale so text and 1px lines stay sharp
+    float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+    key << "/" << scale << "/" << tileHeight;
 
-    // TODO: make this work for other time signatures
-    // assuming 4/4 time signature
-    float pxPerBar = pxPerBeat * 4;
-    int bars = beats * 4;
+    juce::Rectangle<int> area = g.getClipBounds();
+    if (area.isEmpty())
+        return;
+
+    int firstColumn = (int)std::floor(area.getX() / (float)tileWidth);
+    int lastColumn = (int)std::floor((area.getRight() - 1) / (float)tileWidth);
+    int firstRow = (int)std::floor(area.getY() / (float)tileHeight);
+    int lastRow = (int)std::floor((area.getBottom() - 1) / (float)tileHeight);
+
+    for (int column = firstColumn; column <= lastColumn; ++column) {
+        auto it = tiles.find({key, column});
+
+        if (it == tiles.end()) {
+            if ((int)tiles.size() >= maxTiles)
+                tiles.clear();
+
+            juce::Image tile(juce::Image::ARGB,
+                             juce::roundToInt(tileWidth * scale),
+                             juce::roundToInt(tileHeight * scale), true);
+            {
+                juce::Graphics tg(tile);
+                tg.addTransform(juce::AffineTransform::scale(scale));
+                tg.setOrigin({-column * tileWidth, 0});
+                render(tg, column * tileWidth, tileWidth);
+            }
+
+            it = tiles.emplace(std::make_pair(key, column), tile).first;
+        }
+
+        for (int row = firstRow; row <= lastRow; ++row) {
+            g.drawImage(it->second,
+                        juce::Rectangle<float>(
+                            (float)(column * tileWidth),
+                            (float)(row * tileHeight), (float)tileWidth,
+                            (float)tileHeight));
+        }
+    }
+}
+
+void track::BarNumbersComponent::paint(juce::Graphics &g) {
+    if (processorRef == nullptr)
+        return;
+
+    float pxPerBar = getPxPerBar(processorRef->context);
+    if (pxPerBar <= 0.f)
+        return;
 
     // space out markers
     float minSpace = 30.f;
     int incrementAmount = std::ceil(minSpace / pxPerBar);
     incrementAmount = std::max(1, incrementAmount);
 
-    g.setFont(getInterRegular().withHeight(16.f));
-    juce::Rectangle<int> bounds = getLocalBounds();
-    bounds.setY(bounds.getY() - (bounds.getHeight() / 2.f) + 9);
+    juce::String key;
+    key << pxPerBar << "/" << incrementAmount;
 
-    for (int i = 0; i < bars; i += incrementAmount) {
-        for (int k = 0; k < incrementAmount && i + k < bars; ++k) {
-            float x = (i + k) * pxPerBar;
+    int height = getHeight();
+    tiles.draw(g, key, height, [this, pxPerBar, incrementAmount,
+                                height](juce::Graphics &tg, int x, int w) {
+        tg.setColour(juce::Colour(0xDD'2E2E2E));
+        tg.fillRect(x, 0, w, height);
 
-            if (k == 0) {
-                // draw numbers
-                bounds.setX((int)x + 4);
-                g.setColour(juce::Colour(0xFF'929292).withAlpha(.8f));
-                g.drawText(juce::String(i + 1), bounds,
-                           juce::Justification::left, false);
-            }
+        tg.setFont(getInterRegular().withHeight(16.f));
+        tg.setColour(juce::Colour(0xFF'929292).withAlpha(.8f));
+
+        // labels that start in the tile before can spill over into this one
+        int first = (int)std::floor((x - 60) / pxPerBar);
+        first = std::max(0, first - (first % incrementAmount));
+        int last = (int)std::ceil((x + w) / pxPerBar);
+
+        juce::Rectangle<int> bounds(0, -(height / 2) + 9, 100, height);
+
+        for (int i = first; i <= last; i += incrementAmount) {
+            // draw numbers
+            bounds.setX((int)(i * pxPerBar) + 4);
+            tg.drawText(juce::String(i + 1), bounds,
+                        juce::Justification::left, false);
         }
-    }
+    });
 }
 
 track::ActionAddClip::ActionAddClip(clip c, std::vector<int> nodeRoute,
                                     void *processor)
     : juce::UndoableAction() {
     this->addedClip = c;
-    this->route = nodeRoute;
+    this->nodeID = utility::getNodeFromRoute(nodeRoute, processor)->id;
     this->p = processor;
+
+    // pasted clips are copies of ones that are still there
+    this->addedClip.id = clip::getNewID();
 };
 track::ActionAddClip::~ActionAddClip() {}
 
 bool track::ActionAddClip::perform() {
-    audioNode *node = utility::getNodeFromRoute(route, p);
+    TRACE_SCOPE("ActionAddClip::perform");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
 
-    if (!node->isTrack)
+    if (!node->isTrack || node->isReturn)
         return false;
 
-    node->clips.push_back(addedClip);
+    // undo hands the loaded clip back, so redo normally has its audio
+    // already. only a clip undone before its import finished comes back as
+    // a placeholder, and that goes through the importer again instead of
+    // being decoded here
+    if (!addedClip.isLoaded() &&
+        !processor->importer.isPending(addedClip.path)) {
+        importRequest r;
+        r.sourcePath = addedClip.path;
+        r.clipIDs.push_back(addedClip.id);
+        processor->importer.queueDecode(r);
+    }
+
+    // copied before taking the lock; the audio thread reads the vector
+    clip c = addedClip;
+    {
+        const juce::ScopedLock sl(processor->getCallbackLock());
+        node->clips.push_back(std::move(c));
+    }
 
     updateGUI();
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->requireSaving();
 
     return true;
 }
 
 bool track::ActionAddClip::undo() {
-    audioNode *node = utility::getNodeFromRoute(route, p);
+    TRACE_SCOPE("ActionAddClip::undo");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
 
     jassert(node->isTrack);
 
-    node->clips.erase(node->clips.begin() + (long)node->clips.size() - 1);
+    // the clip may have been filled in since perform(); keep whatever it
+    // has now for redo
+    auto it = std::find_if(node->clips.begin(), node->clips.end(),
+                           [this](clip &c) { return c.id == addedClip.id; });
+    if (it == node->clips.end())
+        return false;
+
+    clip removed;
+    {
+        const juce::ScopedLock sl(processor->getCallbackLock());
+        removed = std::move(*it);
+        node->clips.erase(it);
+    }
+
+    addedClip = std::move(removed);
+
     updateGUI();
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->requireSaving();
 
     return true;
 }
 
 void track::ActionAddClip::updateGUI() {
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
-    processor->dispatchGUIInstruction(UI_INSTRUCTION_UPDATE_CLIP_COMPONENTS);
+    if (shouldUpdateGUI) {
+        AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+        processor->dispatchGUIInstruction(
+            UI_INSTRUCTION_UPDATE_CLIP_COMPONENTS);
+    }
 }
 
 track::TimelineComponent::TimelineComponent() : juce::Component() {
@@ -104,13 +209,16 @@ track::TimelineComponent::TimelineComponent() : juce::Component() {
 track::ActionCutClip::ActionCutClip(clip c, std::vector<int> nodeRoute,
                                     void *processor) {
     this->addedClip = c;
-    this->route = nodeRoute;
+    this->nodeID = utility::getNodeFromRoute(nodeRoute, processor)->id;
     this->p = processor;
 }
 track::ActionCutClip::~ActionCutClip() {}
 
 bool track::ActionCutClip::perform() {
-    audioNode *node = utility::getNodeFromRoute(route, p);
+    TRACE_SCOPE("ActionCutClip::perform");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
 
     if (clipIndex == -1) {
         for (size_t i = 0; i < node->clips.size(); ++i) {
@@ -121,24 +229,31 @@ bool track::ActionCutClip::perform() {
         }
     }
 
-    node->clips.erase(node->clips.begin() + (long)clipIndex);
+    {
+        const juce::ScopedLock sl(processor->getCallbackLock());
+        node->clips.erase(node->clips.begin() + (long)clipIndex);
+    }
 
     updateGUI();
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->requireSaving();
 
     return true;
 }
 bool track::ActionCutClip::undo() {
-    audioNode *node = utility::getNodeFromRoute(route, p);
+    TRACE_SCOPE("ActionCutClip::undo");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
 
-    auto &newClip = *node->clips.emplace(node->clips.begin() + clipIndex);
-    newClip = addedClip;
+    clip c = addedClip;
+    {
+        const juce::ScopedLock sl(processor->getCallbackLock());
+        node->clips.insert(node->clips.begin() + clipIndex, std::move(c));
+    }
 
     updateGUI();
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->requireSaving();
 
     return true;
@@ -154,15 +269,19 @@ track::ActionSplitClip::ActionSplitClip(track::clip c,
                                         int sampleToSplit, void *processor,
                                         bool updateUI = true) {
     this->clipCopy = c;
-    this->route = nodeRoute;
+    this->nodeID = utility::getNodeFromRoute(nodeRoute, processor)->id;
     this->splitSample = sampleToSplit;
     this->p = processor;
     this->shouldUpdateGUI = updateUI;
+    this->c2ID = clip::getNewID(); // same on redo
 }
 track::ActionSplitClip::~ActionSplitClip() {}
 
 bool track::ActionSplitClip::perform() {
-    audioNode *node = utility::getNodeFromRoute(route, p);
+    TRACE_SCOPE("ActionSplitClip::perform");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
 
     // handle split 1
     c1Index = utility::getIndexOfClipByValue(node, clipCopy);
@@ -174,38 +293,49 @@ bool track::ActionSplitClip::perform() {
     c2.trimRight = c1->trimRight;
 
     int actualSplit = splitSample;
-    c1->trimRight =
-        clipCopy.buffer.getNumSamples() - actualSplit - clipCopy.trimLeft;
 
     // handle split 2
     c2.name = clipCopy.name;
     c2.path = clipCopy.path;
     c2.buffer = clipCopy.buffer;
+    c2.source = clipCopy.source;
+    c2.sampleRate = clipCopy.sampleRate;
+    c2.hostSampleRate = clipCopy.hostSampleRate;
+    c2.playbackTable = clipCopy.playbackTable;
     c2.gain = clipCopy.gain;
+    c2.id = c2ID;
     c2.startPositionSample = clipCopy.startPositionSample + actualSplit;
     c2.trimLeft += actualSplit;
 
-    node->clips.push_back(c2);
+    {
+        const juce::ScopedLock sl(processor->getCallbackLock());
+        c1->trimRight =
+            clipCopy.getNumSamples() - actualSplit - clipCopy.trimLeft;
+        node->clips.push_back(std::move(c2));
+    }
 
     updateGUI();
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->requireSaving();
 
     return true;
 }
 
 bool track::ActionSplitClip::undo() {
-    audioNode *node = utility::getNodeFromRoute(route, p);
+    TRACE_SCOPE("ActionSplitClip::undo");
 
-    clip *c1 = &node->clips[(size_t)c1Index];
-    *c1 = clipCopy;
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
 
-    node->clips.pop_back(); // get rid of c2
+    clip c1 = clipCopy;
+    {
+        const juce::ScopedLock sl(processor->getCallbackLock());
+        node->clips[(size_t)c1Index] = std::move(c1);
+        node->clips.pop_back(); // get rid of c2
+    }
 
     updateGUI();
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->requireSaving();
 
     return true;
@@ -214,8 +344,8 @@ bool track::ActionSplitClip::undo() {
 void track::ActionSplitClip::updateGUI() {
     if (shouldUpdateGUI) {
         AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
-        processor->dispatchGUIInstruction(UI_INSTRUCTION_UPDATE_CLIP_COMPONENTS,
-                                          (void *)1);
+        processor->dispatchGUIInstruction(
+            UI_INSTRUCTION_UPDATE_CLIP_COMPONENTS);
     }
 }
 
@@ -226,6 +356,8 @@ track::ActionShiftClips::ActionShiftClips(int amount, void *processor) {
 track::ActionShiftClips::~ActionShiftClips() {}
 
 bool track::ActionShiftClips::perform() {
+    TRACE_SCOPE("ActionShiftClips::perform");
+
     shift(shiftAmount);
     updateGUI();
 
@@ -236,6 +368,8 @@ bool track::ActionShiftClips::perform() {
 }
 
 bool track::ActionShiftClips::undo() {
+    TRACE_SCOPE("ActionShiftClips::undo");
+
     shift(-shiftAmount);
     updateGUI();
 
@@ -246,9 +380,11 @@ bool track::ActionShiftClips::undo() {
 }
 
 void track::ActionShiftClips::shift(int bars) {
+    engineContext &ctx = getContext(p);
+
     int beatsPerBar = 4;
-    double secondsPerBar = (60.0 / track::BPM) * beatsPerBar;
-    int samplesPerBar = secondsPerBar * track::SAMPLE_RATE;
+    double secondsPerBar = (60.0 / ctx.bpm) * beatsPerBar;
+    int samplesPerBar = secondsPerBar * ctx.sampleRate;
 
     std::vector<audioNode *> nodes = utility::getFlattenedNodes(p);
 
@@ -288,9 +424,19 @@ void track::TimelineViewport::scrollBarMoved(juce::ScrollBar *bar,
     }
 }
 
+void track::TimelineViewport::visibleAreaChanged(
+    const juce::Rectangle<int> & /*newArea*/) {
+    TimelineComponent *tc = (TimelineComponent *)getViewedComponent();
+
+    if (tc != nullptr && tc->clipComponentsUpdated)
+        tc->updateVisibleClipComponents();
+}
+
 void track::TimelineViewport::mouseWheelMove(
     const juce::MouseEvent &ev,
     const juce::MouseWheelDetails &mouseWheelDetails) {
+    engineContext &ctx = getContext(tracklist->processor);
+
 
     if (juce::ModifierKeys::currentModifiers.isCtrlDown() ||
         juce::ModifierKeys::currentModifiers.isCommandDown()) {
@@ -300,31 +446,31 @@ void track::TimelineViewport::mouseWheelMove(
         // getViewPositionX() is x scroll left
 
         int mouseXCoordinates = ev.x + getViewPositionX();
-        int oldZoom = UI_ZOOM_MULTIPLIER;
+        int oldZoom = ctx.zoomMultiplier;
 
         int zoomIncrement = 8;
 
         if (mouseWheelDetails.deltaY < 0 &&
-            UI_ZOOM_MULTIPLIER > UI_MINIMUM_ZOOM_MULTIPLIER) {
-            UI_ZOOM_MULTIPLIER -= zoomIncrement;
+            ctx.zoomMultiplier > UI_MINIMUM_ZOOM_MULTIPLIER) {
+            ctx.zoomMultiplier -= zoomIncrement;
 
-            utility::setAutoGrid();
+            utility::setAutoGrid(tracklist->processor);
         } else if (mouseWheelDetails.deltaY > 0 &&
-                   UI_ZOOM_MULTIPLIER < UI_MAXIMUM_ZOOM_MULTIPLIER) {
-            UI_ZOOM_MULTIPLIER += zoomIncrement;
+                   ctx.zoomMultiplier < UI_MAXIMUM_ZOOM_MULTIPLIER) {
+            ctx.zoomMultiplier += zoomIncrement;
 
-            utility::setAutoGrid();
+            utility::setAutoGrid(tracklist->processor);
         }
 
-        UI_ZOOM_MULTIPLIER =
+        ctx.zoomMultiplier =
             juce::jlimit(UI_MINIMUM_ZOOM_MULTIPLIER, UI_MAXIMUM_ZOOM_MULTIPLIER,
-                         UI_ZOOM_MULTIPLIER);
+                         ctx.zoomMultiplier);
 
         tc->resizeTimelineComponent();
 
         float scale =
             (float)tc->getWidth() /
-            (float)((float)tc->getWidth() * oldZoom / UI_ZOOM_MULTIPLIER);
+            (float)((float)tc->getWidth() * oldZoom / ctx.zoomMultiplier);
 
         int newMouseXCoords = mouseXCoordinates * scale;
         int newX = newMouseXCoords - ev.x;
@@ -336,11 +482,11 @@ void track::TimelineViewport::mouseWheelMove(
 
     if (juce::ModifierKeys::currentModifiers.isAltDown()) {
         if (mouseWheelDetails.deltaY < 0 &&
-            UI_TRACK_HEIGHT > UI_MINIMUM_TRACK_HEIGHT) {
-            UI_TRACK_HEIGHT -= 5;
+            ctx.trackHeight > UI_MINIMUM_TRACK_HEIGHT) {
+            ctx.trackHeight -= 5;
         } else if (mouseWheelDetails.deltaY > 0 &&
-                   UI_TRACK_HEIGHT < UI_MAXIMUM_TRACK_HEIGHT) {
-            UI_TRACK_HEIGHT += 5;
+                   ctx.trackHeight < UI_MAXIMUM_TRACK_HEIGHT) {
+            ctx.trackHeight += 5;
         }
 
         AudioPluginAudioProcessor *p =
@@ -367,9 +513,11 @@ void track::TimelineComponent::mouseDown(const juce::MouseEvent &event) {
         juce::PopupMenu shiftUpMenu;
         juce::PopupMenu shiftDownMenu;
 
-        gridMenu.addItem("Auto", true, track::AUTO_GRID, [this] {
-            track::AUTO_GRID = true;
-            utility::setAutoGrid();
+        engineContext &ctx = getContext(processorRef);
+
+        gridMenu.addItem("Auto", true, ctx.autoGrid, [this] {
+            processorRef->context.autoGrid = true;
+            utility::setAutoGrid(processorRef);
             repaint();
         });
 
@@ -381,10 +529,10 @@ void track::TimelineComponent::mouseDown(const juce::MouseEvent &event) {
 
             // snap grid
             gridMenu.addItem("1/" + juce::String(x), true,
-                             SNAP_DIVISION == x && !track::AUTO_GRID,
+                             ctx.snapDivision == x && !ctx.autoGrid,
                              [this, x] {
-                                 track::AUTO_GRID = false;
-                                 SNAP_DIVISION = x;
+                                 processorRef->context.autoGrid = false;
+                                 processorRef->context.snapDivision = x;
                                  repaint();
                              });
 
@@ -402,7 +550,7 @@ void track::TimelineComponent::mouseDown(const juce::MouseEvent &event) {
 #define MENU_INSERT_CLIP 3
 
         contextMenu.addItem(MENU_PASTE_CLIP, "Paste clip",
-                            clipboard::typecode == TYPECODE_CLIP);
+                            processorRef->clipboard.typecode == TYPECODE_CLIP);
         contextMenu.addItem(MENU_INSERT_CLIP, "Insert audio file");
         contextMenu.addItem(MENU_SPLIT_ALL_CLIPS_HERE, "Split all clips here");
         contextMenu.addSubMenu("Grid", gridMenu);
@@ -414,28 +562,30 @@ void track::TimelineComponent::mouseDown(const juce::MouseEvent &event) {
 
         contextMenu.showMenuAsync(juce::PopupMenu::Options(), [this, event](
                                                                   int result) {
+            engineContext &ctx = getContext(processorRef);
+
             if (result == MENU_PASTE_CLIP) {
-                if (clipboard::typecode != TYPECODE_CLIP)
+                if (processorRef->clipboard.typecode != TYPECODE_CLIP)
                     return;
 
                 // create clip for processor
-                clip *orginalClip = (clip *)clipboard::retrieveData();
+                clip *orginalClip =
+                    (clip *)processorRef->clipboard.retrieveData();
                 clip newClip = *orginalClip;
 
                 newClip.startPositionSample =
-                    (event.getMouseDownX() * SAMPLE_RATE) / UI_ZOOM_MULTIPLIER;
+                    (event.getMouseDownX() * ctx.sampleRate) /
+                    ctx.zoomMultiplier;
 
                 int y = event.getMouseDownY();
                 int nodeDisplayIndex =
-                    ((y + (UI_TRACK_HEIGHT / 2)) / UI_TRACK_HEIGHT) - 1;
+                    ((y + (ctx.trackHeight / 2)) / ctx.trackHeight) - 1;
                 nodeDisplayIndex = juce::jlimit(
-                    0, (int)viewport->tracklist->trackComponents.size() - 1,
+                    0, viewport->tracklist->getNumRows() - 1,
                     nodeDisplayIndex);
 
                 std::vector<int> r =
-                    viewport->tracklist
-                        ->trackComponents[(size_t)nodeDisplayIndex]
-                        ->route;
+                    viewport->tracklist->getRouteAtRow(nodeDisplayIndex);
 
                 ActionAddClip *action =
                     new ActionAddClip(newClip, r, processorRef);
@@ -447,30 +597,28 @@ void track::TimelineComponent::mouseDown(const juce::MouseEvent &event) {
 
             else if (result == MENU_SPLIT_ALL_CLIPS_HERE) {
                 int splitSample =
-                    ((float)event.x / UI_ZOOM_MULTIPLIER) * SAMPLE_RATE;
+                    ((float)event.x / ctx.zoomMultiplier) * ctx.sampleRate;
 
                 std::vector<SplitMultipleClipsData> datas;
 
-                for (auto &cc : clipComponents) {
-                    track::clip *c = cc->correspondingClip;
+                for (auto &placement : clipPlacements) {
+                    track::clip *c = placement.c;
 
                     int start = c->startPositionSample;
-                    int end = c->startPositionSample +
-                              c->buffer.getNumSamples() - c->trimLeft -
-                              c->trimRight;
+                    int end = c->startPositionSample + c->getNumSamples() -
+                              c->trimLeft - c->trimRight;
 
                     if (splitSample > start && splitSample < end) {
                         auto &d = datas.emplace_back();
 
                         std::vector<int> route =
-                            viewport->tracklist
-                                ->trackComponents[(size_t)cc->nodeDisplayIndex]
-                                ->route;
+                            viewport->tracklist->getRouteAtRow(
+                                placement.nodeDisplayIndex);
 
                         d.route = route;
                         d.clipIndex = utility::getIndexOfClip(
                             utility::getNodeFromRoute(route, processorRef), c);
-                        d.nodeDisplayIndex = cc->nodeDisplayIndex;
+                        d.nodeDisplayIndex = placement.nodeDisplayIndex;
                     }
                 }
 
@@ -501,34 +649,36 @@ void track::TimelineComponent::mouseDown(const juce::MouseEvent &event) {
                 DBG("MENU_INSERT_CLIP selected");
 
                 juce::FileChooser *fileChooser =
-                    new juce::FileChooser("Select audio file",
+                    new juce::FileChooser("Select audio files",
                                           juce::File::getSpecialLocation(
                                               juce::File::userHomeDirectory),
                                           "*");
 
                 int flags = juce::FileBrowserComponent::openMode |
-                            juce::FileBrowserComponent::canSelectFiles;
+                            juce::FileBrowserComponent::canSelectFiles |
+                            juce::FileBrowserComponent::canSelectMultipleItems;
 
                 fileChooser->launchAsync(
                     flags, [this, event,
                             fileChooser](const juce::FileChooser &chooser) {
-                        juce::File f = chooser.getResult();
+                        engineContext &ctx = getContext(processorRef);
+                        juce::StringArray files;
+                        for (auto &f : chooser.getResults())
+                            files.add(f.getFullPathName());
 
                         int startSample =
-                            ((float)event.x / UI_ZOOM_MULTIPLIER) * SAMPLE_RATE;
+                            ((float)event.x / ctx.zoomMultiplier) *
+                            ctx.sampleRate;
 
                         int nodeDisplayIndex =
-                            ((event.y + (UI_TRACK_HEIGHT / 2)) /
-                             UI_TRACK_HEIGHT) -
+                            ((event.y + (ctx.trackHeight / 2)) /
+                             ctx.trackHeight) -
                             1;
                         nodeDisplayIndex = juce::jlimit(
-                            0,
-                            (int)viewport->tracklist->trackComponents.size() -
-                                1,
+                            0, viewport->tracklist->getNumRows() - 1,
                             nodeDisplayIndex);
 
-                        validateFile(f.getFullPathName(), nodeDisplayIndex,
-                                     startSample);
+                        importFiles(files, nodeDisplayIndex, startSample);
 
                         delete fileChooser;
                     });
@@ -538,147 +688,234 @@ void track::TimelineComponent::mouseDown(const juce::MouseEvent &event) {
 }
 
 void track::TimelineComponent::paint(juce::Graphics &g) {
-    g.fillAll(juce::Colour(0xFF2E2E2E));
-
-    // bar markers
-    float secondsPerBeat = 60.f / BPM;
-    float pxPerSecond = UI_ZOOM_MULTIPLIER;
-    float pxPerBeat = secondsPerBeat * pxPerSecond;
+    // bar markers. the grid only depends on zoom and tempo, so it comes out
+    // of the tile cache; only the part in view gets drawn
+    engineContext &ctx = getContext(processorRef);
+    float pxPerBar = getPxPerBar(ctx);
+
+    juce::String key;
+    key << pxPerBar << "/" << ctx.snapDivision;
+
+    if (pxPerBar > 0.f) {
+        int snapDivision = ctx.snapDivision;
+        gridTiles.draw(
+            g, key, gridTileHeight,
+            [pxPerBar, snapDivision](juce::Graphics &tg, int x, int w) {
+                drawGrid(tg, x, w, gridTileHeight, pxPerBar, snapDivision);
+            });
+    } else {
+        g.fillAll(juce::Colour(0xFF2E2E2E));
+    }
 
-    int beats = this->getWidth() / pxPerBeat;
-    int scrollValue = viewport->getVerticalScrollBar().getCurrentRangeStart();
+    // horizontal divide line thingy
+    g.setColour(juce::Colour(0xFF'1E1E1E).withAlpha(0.4f));
+    g.drawRect(0, 20, getWidth(), 1);
 
-    // TODO: make this work for other time signatures
-    // assuming 4/4 time signature
-    float pxPerBar = pxPerBeat * 4;
-    int bars = beats * 4;
+    if (clipComponentsUpdated == false)
+        updateClipComponents();
+}
 
-    // space out markers
-    float minSpace = 30.f;
-    int incrementAmount = std::ceil(minSpace / pxPerBar);
-    incrementAmount = std::max(1, incrementAmount);
+void track::TimelineComponent::drawGrid(juce::Graphics &g, int x, int width,
+                                        int height, float pxPerBar,
+                                        int snapDivision) {
+    g.setColour(juce::Colour(0xFF2E2E2E));
+    g.fillRect(x, 0, width, height);
 
-    g.setFont(getInterRegular().withHeight(16.f));
-    juce::Rectangle<int> bounds = getLocalBounds();
-    bounds.setY(bounds.getY() - (bounds.getHeight() / 2.f) + 10 + scrollValue);
+    int first = juce::jmax(0, (int)std::floor(x / pxPerBar));
+    int last = (int)std::ceil((x + width) / pxPerBar);
 
-    for (int i = 0; i < bars; i += incrementAmount) {
-        for (int k = 0; k < incrementAmount && i + k < bars; ++k) {
-            float x = (i + k) * pxPerBar;
+    for (int i = first; i <= last; ++i) {
+        float barX = i * pxPerBar;
 
-            // draw vertical lines for bar numbers
-            g.setColour(juce::Colour(0xFF'444444).withAlpha(.5f));
-            g.fillRect((int)x, 0, 1, getHeight());
+        // draw vertical lines for bar numbers
+        g.setColour(juce::Colour(0xFF'444444).withAlpha(.5f));
+        g.fillRect((int)barX, 0, 1, height);
 
-            // draw lines for grid snapping
-            g.setColour(juce::Colour(0xFF'444444).withAlpha(.3f));
-            for (int j = 0; j < SNAP_DIVISION; ++j) {
-                int divX = x + ((pxPerBar / SNAP_DIVISION) * j);
-                g.fillRect(divX, 0, 1, getHeight());
-            }
+        // draw lines for grid snapping
+        g.setColour(juce::Colour(0xFF'444444).withAlpha(.3f));
+        for (int j = 0; j < snapDivision; ++j) {
+            int divX = barX + ((pxPerBar / snapDivision) * j);
+            g.fillRect(divX, 0, 1, height);
         }
     }
+}
 
-    // horizontal divide line thingy
-    g.setColour(juce::Colour(0xFF'1E1E1E).withAlpha(0.4f));
-    g.drawRect(0, 20, getWidth(), 1);
+juce::Rectangle<int>
+track::TimelineComponent::getClipComponentBounds(clip *c, int displayIndex) {
+    engineContext &ctx = getContext(processorRef);
 
-    if (clipComponentsUpdated == false)
-        updateClipComponents();
+    int clipLength = c->getNumSamples();
+
+    // clips that are still being decoded get drawn at their final length
+    int pendingLength = processorRef->importer.getPendingLength(c->path);
+    if (clipLength == 0 && pendingLength > 0)
+        clipLength = pendingLength;
+
+    juce::Rectangle<int> bounds = juce::Rectangle<int>(
+        c->startPositionSample / ctx.sampleRate * ctx.zoomMultiplier,
+
+        UI_TRACK_VERTICAL_OFFSET + (displayIndex * ctx.trackHeight),
+
+        (clipLength - c->trimLeft - c->trimRight) / ctx.sampleRate *
+            ctx.zoomMultiplier,
+        ctx.trackHeight);
+
+    // handle offline clips
+    if (clipLength == 0)
+        bounds.setWidth(110);
+
+    return bounds;
 }
 
 void track::TimelineComponent::resizeClipComponent(track::ClipComponent *clip) {
+    engineContext &ctx = getContext(processorRef);
+
     int effectiveY = clip->curDragNodeDisplayIndex == -1
                          ? clip->nodeDisplayIndex
                          : clip->curDragNodeDisplayIndex;
 
-    clip->setBounds(clip->correspondingClip->startPositionSample / SAMPLE_RATE *
-                        UI_ZOOM_MULTIPLIER,
-
-                    UI_TRACK_VERTICAL_OFFSET + (effectiveY * UI_TRACK_HEIGHT),
-
-                    (clip->correspondingClip->buffer.getNumSamples() -
-                     clip->correspondingClip->trimLeft -
-                     clip->correspondingClip->trimRight) /
-                        SAMPLE_RATE * UI_ZOOM_MULTIPLIER,
-                    UI_TRACK_HEIGHT);
-
-    // handle offline clips
-    if (clip->correspondingClip->buffer.getNumSamples() == 0) {
-        juce::Rectangle<int> offlineClipBounds = clip->getBounds();
-        offlineClipBounds.setWidth(110);
-        clip->setBounds(offlineClipBounds);
-    }
+    clip->setBounds(
+        getClipComponentBounds(clip->correspondingClip, effectiveY));
 
     juce::Rectangle<int> clipLabelBounds = juce::Rectangle<int>(
         clip->getLocalBounds().getX(), clip->getLocalBounds().getY(), 300, 20);
 
     clip->clipNameLabel.setBounds(clipLabelBounds);
 
-    if (UI_TRACK_HEIGHT <= UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT) {
+    if (ctx.trackHeight <= UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT) {
         // clipLabelBounds.setY(clipLabelBounds.getHeight() / 2);
         clipLabelBounds.setY(0);
-        clipLabelBounds.setHeight(UI_TRACK_HEIGHT);
+        clipLabelBounds.setHeight(ctx.trackHeight);
         clip->clipNameLabel.setBounds(clipLabelBounds);
     }
 }
 
 void track::TimelineComponent::resized() {
     // draw clips
-    for (auto &&clip : this->clipComponents) {
-        resizeClipComponent(clip.get());
-    }
+    if (clipComponentsUpdated)
+        updateVisibleClipComponents();
 
     TimelineViewport *tv = findParentComponentOfClass<TimelineViewport>();
     barNumbers.setBounds(0, tv->getViewPositionY(), getWidth(), 16);
     barNumbers.toFront(false);
 }
 
-bool track::TimelineComponent::renderingWaveforms() {
-    bool retval = false;
+void track::TimelineComponent::updateClipComponents() {
+    TRACE_SCOPE("TimelineComponent::updateClipComponents");
 
-    for (size_t i = 0; i < clipComponents.size(); ++i) {
-        if (!clipComponents[i]->thumbnail.isFullyLoaded()) {
-            retval = true;
-            break;
-        }
+    clipComponentsUpdated = true;
+
+    updateClipPlacements();
+    updateVisibleClipComponents();
+    resizeTimelineComponent();
+}
+
+void track::TimelineComponent::updateClipPlacements() {
+    clipPlacements.clear();
+
+    for (int i = 0; i < viewport->tracklist->getNumRows(); ++i) {
+        audioNode *node = viewport->tracklist->getNodeAtRow(i);
+
+        if (!node->isTrack)
+            continue;
+
+        for (auto &c : node->clips)
+            clipPlacements.push_back({&c, i});
     }
+}
+
+void track::TimelineComponent::rebindClipComponents() {
+    updateClipPlacements();
+
+    std::unordered_map<int, clipPlacement *> byID;
+    for (auto &placement : clipPlacements)
+        byID[placement.c->id] = &placement;
+
+    // components whose clip went away are hidden until the rebuild drops them
+    for (auto &cc : clipComponents) {
+        auto it = byID.find(cc->clipID);
+
+        if (it == byID.end()) {
+            cc->correspondingClip = nullptr;
+            cc->setVisible(false);
+            continue;
+        }
 
-    return retval;
+        cc->correspondingClip = it->second->c;
+        cc->nodeDisplayIndex = it->second->nodeDisplayIndex;
+        cc->setVisible(true);
+    }
 }
 
-void track::TimelineComponent::updateClipComponents() {
-    clipComponentsUpdated = true;
+void track::TimelineComponent::updateVisibleClipComponents() {
+    engineContext &ctx = getContext(processorRef);
+
+    juce::Rectangle<int> area =
+        viewport == nullptr
+            ? getLocalBounds()
+            : viewport->getViewArea().expanded(virtualizationMargin,
+                                               ctx.trackHeight * 2);
+
+    // components go by clip id; their clip pointers might be stale by now
+    // (or even point at a different clip), so they're only rebound here
+    std::unordered_map<int, std::unique_ptr<ClipComponent>> existing;
+    for (auto &cc : clipComponents)
+        existing[cc->clipID] = std::move(cc);
 
     clipComponents.clear();
 
-    std::hash<juce::String> hasher;
-    for (size_t i = 0; i < viewport->tracklist->trackComponents.size(); ++i) {
-        audioNode *node =
-            viewport->tracklist->trackComponents[i]->getCorrespondingTrack();
+    for (auto &placement : clipPlacements) {
+        auto it = existing.find(placement.c->id);
+        bool hasComponent = it != existing.end();
 
-        if (!node->isTrack)
-            continue;
+        bool visible =
+            getClipComponentBounds(placement.c, placement.nodeDisplayIndex)
+                .intersects(area);
 
-        for (auto &c : node->clips) {
-            int hashed = (int)hasher(c.path) + c.trimLeft + c.trimRight;
+        if (!visible && !(hasComponent && it->second->isPinned()))
+            continue;
 
-            this->clipComponents.push_back(
-                std::make_unique<ClipComponent>(&c, hashed));
+        if (hasComponent) {
+            clipComponents.push_back(std::move(it->second));
+            existing.erase(it);
+        } else {
+            clipComponents.push_back(std::make_unique<ClipComponent>(
+                placement.c, &processorRef->peaks, processorRef));
             addAndMakeVisible(*clipComponents.back());
+        }
+
+        ClipComponent *cc = clipComponents.back().get();
+        cc->correspondingClip = placement.c;
+        cc->nodeDisplayIndex = placement.nodeDisplayIndex;
+        cc->setVisible(true);
 
-            auto &cc = clipComponents.back();
-            cc->nodeDisplayIndex = i;
+        juce::String state = cc->getClipState();
+        if (state != cc->drawnState) {
+            cc->clipNameLabel.setText(
+                placement.c->name,
+                juce::NotificationType::dontSendNotification);
+            cc->drawnState = state;
+            cc->repaint();
         }
+
+        resizeClipComponent(cc);
     }
 
-    resized();
-    resizeTimelineComponent();
+    // whatever's left scrolled out of view or lost its clip
+    existing.clear();
+
+    // new components would otherwise end up on top of the bar numbers
+    barNumbers.toFront(false);
+}
+
+void track::TimelineComponent::clearClipComponents() {
+    clipComponents.clear();
+    clipPlacements.clear();
 }
 
 void track::TimelineComponent::updateOnlyStaleClipComponents() {
     for (auto &cc : clipComponents) {
-        if (cc->stale) {
+        if (cc->stale && cc->correspondingClip != nullptr) {
             cc->clipNameLabel.setText(
                 cc->correspondingClip->name,
                 juce::NotificationType::dontSendNotification);
@@ -691,21 +928,20 @@ void track::TimelineComponent::updateOnlyStaleClipComponents() {
 }
 
 void track::TimelineComponent::resizeTimelineComponent() {
-    int largestEnd = -1;
+    engineContext &ctx = getContext(processorRef);
 
-    for (auto &tc : viewport->tracklist->trackComponents) {
-        audioNode *node = tc->getCorrespondingTrack();
+    int largestEnd = -1;
 
+    for (audioNode *node : utility::getFlattenedNodes(processorRef)) {
         for (clip &c : node->clips) {
-            if ((c.buffer.getNumSamples() + c.startPositionSample) >
-                largestEnd) {
-                largestEnd = c.buffer.getNumSamples() + c.startPositionSample;
+            if ((c.getNumSamples() + c.startPositionSample) > largestEnd) {
+                largestEnd = c.getNumSamples() + c.startPositionSample;
             }
         }
     }
 
-    jassert(UI_ZOOM_MULTIPLIER > 0);
-    largestEnd /= (SAMPLE_RATE / UI_ZOOM_MULTIPLIER);
+    jassert(ctx.zoomMultiplier > 0);
+    largestEnd /= (ctx.sampleRate / ctx.zoomMultiplier);
     largestEnd += 2000;
 
     // this->setSize(juce::jmax(getWidth(), largestEnd), getHeight());
@@ -714,7 +950,7 @@ void track::TimelineComponent::resizeTimelineComponent() {
 
 void track::TimelineComponent::deleteClip(clip *c, int trackIndex) {
     std::vector<int> route =
-        viewport->tracklist->trackComponents[(size_t)trackIndex]->route;
+        viewport->tracklist->getRouteAtRow(trackIndex);
     ActionCutClip *action = new ActionCutClip(*c, route, this->processorRef);
     processorRef->undoManager.beginNewTransaction("action cut clip");
     processorRef->undoManager.perform(action);
@@ -723,7 +959,7 @@ void track::TimelineComponent::deleteClip(clip *c, int trackIndex) {
 void track::TimelineComponent::splitClip(clip *c, int splitSample,
                                          int nodeDisplayIndex) {
     std::vector<int> route =
-        viewport->tracklist->trackComponents[(size_t)nodeDisplayIndex]->route;
+        viewport->tracklist->getRouteAtRow(nodeDisplayIndex);
     ActionSplitClip *action =
         new ActionSplitClip(*c, route, splitSample, this->processorRef);
     processorRef->undoManager.beginNewTransaction("action split clip");
@@ -744,40 +980,62 @@ bool track::TimelineComponent::isInterestedInFileDrag(
 
 void track::TimelineComponent::filesDropped(const juce::StringArray &files,
                                             int x, int y) {
-    if (viewport->tracklist->trackComponents.size() == 0)
-        return;
+    engineContext &ctx = getContext(processorRef);
 
-    int nodeDisplayIndex = ((y + (UI_TRACK_HEIGHT / 2)) / UI_TRACK_HEIGHT) - 1;
-    nodeDisplayIndex =
-        juce::jlimit(0, (int)viewport->tracklist->trackComponents.size() - 1,
-                     nodeDisplayIndex);
+    if (viewport->tracklist->getNumRows() == 0)
+        return;
 
-    int startSample = (x * SAMPLE_RATE) / UI_ZOOM_MULTIPLIER;
+    int nodeDisplayIndex = ((y + (ctx.trackHeight / 2)) / ctx.trackHeight) - 1;
+    nodeDisplayIndex = juce::jlimit(0, viewport->tracklist->getNumRows() - 1,
+                                    nodeDisplayIndex);
 
-    juce::String path = files[0];
+    int startSample = (x * ctx.sampleRate) / ctx.zoomMultiplier;
 
-    validateFile(path, nodeDisplayIndex, startSample);
+    importFiles(files, nodeDisplayIndex, startSample);
 }
 
-void track::TimelineComponent::validateFile(juce::String path,
-                                            int nodeDisplayIndex,
-                                            int startSample) {
-    if (path == "")
-        return;
+void track::TimelineComponent::importFiles(juce::StringArray files,
+                                           int nodeDisplayIndex,
+                                           int startSample) {
+    engineContext &ctx = getContext(processorRef);
+
+    std::vector<importRequest> requests;
+    juce::StringArray invalidFiles;
+    int mismatchedFiles = 0;
 
-    // check if file is valid audio
-    juce::File file(path);
     juce::AudioFormatManager afm;
     afm.registerBasicFormats();
 
-    std::unique_ptr<juce::AudioFormatReader> reader(afm.createReaderFor(file));
+    // only headers get read here; decoding happens on the importer's pool
+    for (auto &path : files) {
+        if (path == "")
+            continue;
+
+        std::unique_ptr<juce::AudioFormatReader> reader(
+            afm.createReaderFor(juce::File(path)));
+
+        if (reader == nullptr) {
+            invalidFiles.add(juce::File(path).getFileName());
+            continue;
+        }
+
+        auto &r = requests.emplace_back();
+        r.sourcePath = path;
+        r.lengthInSamples = (int)reader->lengthInSamples;
 
-    if (reader == nullptr) {
-        juce::String filename = juce::File(path).getFileName();
+        if (!juce::approximatelyEqual(ctx.sampleRate, reader->sampleRate)) {
+            // cleared again below if the user picks realtime resampling
+            r.resample = true;
+            r.lengthInSamples = (int)((double)reader->lengthInSamples *
+                                      ctx.sampleRate / reader->sampleRate);
+            ++mismatchedFiles;
+        }
+    }
 
+    if (invalidFiles.size() > 0) {
         juce::NativeMessageBox::showMessageBoxAsync(
             juce::MessageBoxIconType::WarningIcon, "Invalid file",
-            "Couldn't read data from \"" + filename +
+            "Couldn't read data from \"" + invalidFiles.joinIntoString("\", \"") +
                 juce::String(
                     "\"\n\nTroubleshooting:\n- Verify "
                     "that you dragged the "
@@ -788,74 +1046,99 @@ void track::TimelineComponent::validateFile(juce::String path,
                     "a different "
                     "audio player program)\n- Verify that another program "
                     "isn't using the file"));
+    }
 
+    if (requests.size() == 0)
         return;
-    }
 
-    // look for sample rate mismatch
-    if (!juce::approximatelyEqual(track::SAMPLE_RATE, reader->sampleRate)) {
+    // look for sample rate mismatch; ask once for the whole batch
+    if (mismatchedFiles > 0) {
+        juce::String msg =
+            requests.size() == 1
+                ? "Host's sample rate is " + juce::String(ctx.sampleRate) +
+                      "Hz but the audio file's sample rate is different"
+                : juce::String(mismatchedFiles) + " of " +
+                      juce::String(requests.size()) +
+                      " files don't match the host's sample rate (" +
+                      juce::String(ctx.sampleRate) + "Hz)";
+
         juce::NativeMessageBox::showAsync(
             juce::MessageBoxOptions()
                 .withIconType(juce::MessageBoxIconType::QuestionIcon)
                 .withTitle("Sample rate mismatch")
-
-                .withMessage("Host's sample rate is " +
-                             juce::String(track::SAMPLE_RATE) +
-                             "Hz but the audio file's sample rate is " +
-                             juce::String(reader->sampleRate) + "Hz")
-
-                .withButton("Resample file to " +
-                            juce::String(track::SAMPLE_RATE) + "Hz")
-
-                .withButton("Don't resample")
-
+                .withMessage(msg)
+                .withButton("Resample to " + juce::String(ctx.sampleRate) +
+                            "Hz")
+                .withButton("Resample in realtime")
                 .withButton("Cancel"),
-            [this, path, startSample, nodeDisplayIndex](int result) {
-                if (result == 0) {
-                    juce::String resampledFilePath =
-                        track::utility::resampledToHostSampleRate(path);
-
-                    addNewClipToTimeline(resampledFilePath, startSample,
-                                         nodeDisplayIndex);
-                } else if (result == 1) {
-                    addNewClipToTimeline(path, startSample, nodeDisplayIndex);
+            [this, requests, nodeDisplayIndex, startSample](int result) {
+                std::vector<importRequest> finalRequests = requests;
+
+                // resampling to the host rate is what the requests already
+                // ask for; the importer works out where the cache file goes
+                if (result == 1) {
+                    // clips keep the file's rate and audioNode::process takes
+                    // care of the rest
+                    for (auto &r : finalRequests)
+                        r.resample = false;
+                } else if (result != 0) {
+                    return;
                 }
+
+                addImportedClipsToTimeline(finalRequests, nodeDisplayIndex,
+                                           startSample);
             });
     } else {
-        addNewClipToTimeline(path, startSample, nodeDisplayIndex);
+        addImportedClipsToTimeline(requests, nodeDisplayIndex, startSample);
     }
 }
 
-void track::TimelineComponent::addNewClipToTimeline(juce::String path,
-                                                    int startSample,
-                                                    int nodeDisplayIndex) {
-    std::unique_ptr<clip> c(new clip());
-    c->path = path;
+void track::TimelineComponent::addImportedClipsToTimeline(
+    std::vector<importRequest> requests, int nodeDisplayIndex,
+    int startSample) {
+    // each file goes on the next track down from the one it was dropped on;
+    // groups get skipped and new tracks get created when we run out
+    std::vector<std::vector<int>> routes;
+    Tracklist *tracklist = viewport->tracklist;
 
-    juce::File f = juce::File(c->path);
-    c->name = f.getFileNameWithoutExtension();
+    for (int i = nodeDisplayIndex;
+         i < tracklist->getNumRows() && routes.size() < requests.size(); ++i) {
+        audioNode *node = tracklist->getNodeAtRow(i);
 
-    c->startPositionSample = startSample;
-    c->updateBuffer();
+        if (node->isTrack && !node->isReturn)
+            routes.push_back(tracklist->getRouteAtRow(i));
+    }
 
-    DBG("nodeDisplayIndex is " << nodeDisplayIndex);
-    audioNode *node =
-        viewport->tracklist->trackComponents[(size_t)nodeDisplayIndex]
-            ->getCorrespondingTrack();
+    processorRef->undoManager.beginNewTransaction("action import clips");
 
-    std::vector<int> route =
-        viewport->tracklist->trackComponents[(size_t)nodeDisplayIndex]->route;
+    // the rows get rebuilt by ActionCreateNode, so don't touch them after this
+    // point
+    while (routes.size() < requests.size()) {
+        ActionCreateNode *action =
+            new ActionCreateNode(std::vector<int>(), true, processorRef);
+        processorRef->undoManager.perform(action);
 
-    if (!node->isTrack) {
-        DBG("Rejecting file drop onto group");
-    } else {
+        std::vector<int> r;
+        r.push_back((int)processorRef->tracks.size() - 1);
+        routes.push_back(r);
+    }
+
+    for (size_t i = 0; i < requests.size(); ++i) {
+        importRequest &r = requests[i];
 
-        ActionAddClip *action =
-            new ActionAddClip(*c, route, this->processorRef);
-        processorRef->undoManager.beginNewTransaction("action add clip");
+        clip c;
+        c.path = r.sourcePath;
+        c.name = juce::File(r.sourcePath).getFileNameWithoutExtension();
+        c.startPositionSample = startSample;
 
+        // queue before performing so that ActionAddClip leaves the buffer
+        // empty instead of queueing it again. the action picks the clip's id,
+        // which is how the importer finds its placeholder
+        ActionAddClip *action = new ActionAddClip(c, routes[i], processorRef);
+        r.clipIDs.push_back(action->addedClip.id);
+        processorRef->importer.queueDecode(r);
+
+        action->shouldUpdateGUI = i == requests.size() - 1;
         processorRef->undoManager.perform(action);
     }
-
-    updateClipComponents();
 }
@@ -1,7 +1,10 @@
 #pragma once
 #include "../processor.h"
+#include "importer.h"
 #include "track.h"
 #include <JuceHeader.h>
+#include <functional>
+#include <map>
 
 namespace track {
 class TimelineViewport : public juce::Viewport {
@@ -13,16 +16,41 @@ class TimelineViewport : public juce::Viewport {
     mouseWheelMove(const juce::MouseEvent &ev,
                    const juce::MouseWheelDetails &mouseWheelDetails) override;
     void scrollBarMoved(juce::ScrollBar *bar, double newRangeStart) override;
+    void visibleAreaChanged(const juce::Rectangle<int> &newArea) override;
     TrackViewport *trackViewport = nullptr;
     Tracklist *tracklist = nullptr;
 };
 
+// pre-rendered strips of something that only changes with zoom/tempo (i.e.
+// the grid), so that a repaint only blits the tiles that are in view. tiles
+// are keyed by whatever changes what they look like, so zooming back and
+// forth doesn't re-render them
+class TileCache {
+  public:
+    static constexpr int tileWidth = 512;
+    static constexpr int maxTiles = 256;
+
+    // draws [x, x + width) of the strip in component coordinates
+    using renderer = std::function<void(juce::Graphics &, int x, int width)>;
+
+    // covers the clip region with tiles of tileHeight, stacked vertically if
+    // the region is taller than that
+    void draw(juce::Graphics &g, juce::String key, int tileHeight,
+              const renderer &render);
+    void clear() { tiles.clear(); }
+
+  private:
+    std::map<std::pair<juce::String, int>, juce::Image> tiles;
+};
+
 class BarNumbersComponent : public juce::Component {
   public:
     BarNumbersComponent();
     ~BarNumbersComponent();
 
     void paint(juce::Graphics &g);
+    TileCache tiles;
+    AudioPluginAudioProcessor *processorRef = nullptr;
 
     juce::Font getInterRegular() {
         static auto typeface = Typeface::createSystemTypefaceFor(
@@ -36,7 +64,7 @@ class BarNumbersComponent : public juce::Component {
 class ActionAddClip : public juce::UndoableAction {
   public:
     clip addedClip;
-    std::vector<int> route;
+    int nodeID = -1;
     void *p = nullptr;
 
     ActionAddClip(clip c, std::vector<int> nodeRoute, void *processor);
@@ -45,12 +73,14 @@ class ActionAddClip : public juce::UndoableAction {
     bool perform() override;
     bool undo() override;
     void updateGUI(); // y
+
+    bool shouldUpdateGUI = true;
 };
 
 class ActionCutClip : public juce::UndoableAction {
   public:
     clip addedClip;
-    std::vector<int> route;
+    int nodeID = -1;
     void *p = nullptr;
 
     ActionCutClip(clip c, std::vector<int> nodeRoute, void *processor);
@@ -67,7 +97,7 @@ class ActionCutClip : public juce::UndoableAction {
 class ActionSplitClip : public juce::UndoableAction {
   public:
     clip clipCopy;
-    std::vector<int> route;
+    int nodeID = -1;
     void *p = nullptr;
 
     int splitSample = -1;
@@ -84,6 +114,7 @@ class ActionSplitClip : public juce::UndoableAction {
 
   private:
     int c1Index = -1;
+    int c2ID = -1;
 };
 
 class ActionShiftClips : public juce::UndoableAction {
@@ -101,6 +132,12 @@ class ActionShiftClips : public juce::UndoableAction {
     void updateGUI(); // y
 };
 
+// where a clip goes on the timeline, whether or not it has a component
+struct clipPlacement {
+    clip *c = nullptr;
+    int nodeDisplayIndex = -1;
+};
+
 struct SplitMultipleClipsData {
     std::vector<int> route;
     int nodeDisplayIndex = -1;
@@ -116,25 +153,43 @@ class TimelineComponent : public juce::Component,
     bool isInterestedInFileDrag(const juce::StringArray &files) override;
     void mouseDown(const juce::MouseEvent &event) override;
     void filesDropped(const juce::StringArray &files, int x, int y) override;
-    void validateFile(juce::String path, int nodeDisplayIndex, int startSample);
-    void addNewClipToTimeline(juce::String path, int startSample,
-                              int nodeDisplayIndex);
+    void importFiles(juce::StringArray files, int nodeDisplayIndex,
+                     int startSample);
+    void addImportedClipsToTimeline(std::vector<importRequest> requests,
+                                    int nodeDisplayIndex, int startSample);
 
     void paint(juce::Graphics &g) override;
+    juce::Rectangle<int> getClipComponentBounds(clip *c, int displayIndex);
     void resizeClipComponent(ClipComponent *clip);
     void resized() override;
-    bool renderingWaveforms();
 
     TimelineViewport *viewport = nullptr;
     AudioPluginAudioProcessor *processorRef = nullptr;
 
+    // every clip on the timeline, but only the ones in (or near) the visible
+    // area get a component. components are reused across updates when their
+    // clip is still around
+    std::vector<clipPlacement> clipPlacements;
     std::vector<std::unique_ptr<ClipComponent>> clipComponents;
+    static constexpr int virtualizationMargin = 600; // px beyond the view
     void updateClipComponents();
+    void updateClipPlacements();
+    void updateVisibleClipComponents();
+
+    // repoints existing components at their clips by id, without creating,
+    // laying out or repainting any. the full update follows on the next frame
+    void rebindClipComponents();
+    void clearClipComponents();
     void updateOnlyStaleClipComponents();
     void resizeTimelineComponent();
 
     BarNumbersComponent barNumbers;
 
+    TileCache gridTiles;
+    static constexpr int gridTileHeight = 256;
+    static void drawGrid(juce::Graphics &g, int x, int width, int height,
+                         float pxPerBar, int snapDivision);
+
     bool clipComponentsUpdated = false;
     void deleteClip(clip *c, int trackIndex);
     void splitClip(clip *c, int splitSample, int nodeDisplayIndex);
@@ -0,0 +1,252 @@
+#include "trace.h"
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace {
+struct traceEvent {
+    const char *name = nullptr;
+    juce::int64 start = 0;
+    juce::int64 end = 0;
+};
+
+// one thread's events. only its owner writes; dump() reads behind it and
+// skips the oldest overwriteMargin events, since those might be getting
+// overwritten right then
+struct threadBuffer {
+    std::vector<traceEvent> events;
+    std::atomic<juce::uint64> written{0};
+    std::atomic<const char *> name{nullptr};
+    std::atomic<bool> claimed{false};
+};
+
+constexpr juce::uint64 overwriteMargin = 256;
+
+std::atomic<bool> enabled{false};
+
+// for the end of the dump. dropped rings were asked for after they were all
+// taken; unnamed threads recorded something without ever asking
+std::atomic<int> droppedRings{0};
+std::atomic<int> unnamedThreads{0};
+
+// allocated the first time recording's turned on, and kept from then on so
+// that threads never have to check whether it's still there
+std::unique_ptr<threadBuffer[]> buffers;
+
+// the calling thread's own ring, or one of these
+constexpr int unclaimed = track::trace::unclaimedRing;
+constexpr int unnamed = -3;
+
+struct threadRing {
+    int slot = unclaimed;
+
+    // threads that come and go (a host's, or ones of ours that get
+    // restarted) don't keep a ring from whoever needs it next
+    ~threadRing() { track::trace::releaseRing(slot); }
+};
+
+thread_local threadRing own;
+
+// set by useRing; takes over from own while it's around
+thread_local int boundRing = unclaimed;
+
+threadBuffer *claimThreadBuffer(const char *name) {
+    if (own.slot == unclaimed || own.slot == unnamed) {
+        if (own.slot == unnamed)
+            --unnamedThreads;
+
+        own.slot = track::trace::claimRing(name);
+    }
+
+    return own.slot >= 0 ? &buffers[(size_t)own.slot] : nullptr;
+}
+
+threadBuffer *getThreadBuffer() {
+    if (boundRing != unclaimed)
+        return boundRing >= 0 ? &buffers[(size_t)boundRing] : nullptr;
+
+    if (own.slot == unclaimed) {
+        // the only thread that doesn't have to name itself first
+        if (juce::MessageManager::existsAndIsCurrentThread()) {
+            claimThreadBuffer("message thread");
+        } else {
+            own.slot = unnamed;
+            ++unnamedThreads;
+        }
+    }
+
+    return own.slot >= 0 ? &buffers[(size_t)own.slot] : nullptr;
+}
+
+juce::String escape(const char *s) {
+    return juce::String(s).replace("\\", "\\\\").replace("\"", "\\\"");
+}
+} // namespace
+
+void track::trace::setEnabled(bool shouldBeEnabled) {
+    if (shouldBeEnabled && buffers == nullptr) {
+        buffers = std::make_unique<threadBuffer[]>((size_t)maxThreads);
+        for (int i = 0; i < maxThreads; ++i)
+            buffers[(size_t)i].events.resize((size_t)eventsPerThread);
+    }
+
+    enabled.store(shouldBeEnabled, std::memory_order_release);
+}
+
+bool track::trace::isEnabled() {
+    return enabled.load(std::memory_order_acquire);
+}
+
+void track::trace::nameThread(const char *name) {
+    if (!isEnabled())
+        return;
+
+    if (threadBuffer *b = claimThreadBuffer(name))
+        b->name.store(name, std::memory_order_relaxed);
+}
+
+int track::trace::claimRing(const char *name) {
+    if (!isEnabled())
+        return unclaimedRing;
+
+    for (int i = 0; i < maxThreads; ++i) {
+        threadBuffer &b = buffers[(size_t)i];
+
+        bool expected = false;
+        if (!b.claimed.compare_exchange_strong(expected, true))
+            continue;
+
+        // whatever the last owner left is dropped rather than put under
+        // this one's name
+        b.written.store(0, std::memory_order_release);
+        b.name.store(name, std::memory_order_relaxed);
+        return i;
+    }
+
+    ++droppedRings;
+    return noRing;
+}
+
+void track::trace::releaseRing(int ring) {
+    if (ring < 0 || ring >= maxThreads || buffers == nullptr)
+        return;
+
+    buffers[(size_t)ring].claimed.store(false, std::memory_order_release);
+}
+
+track::trace::useRing::useRing(int ring) : previous(boundRing) {
+    boundRing = ring;
+}
+
+track::trace::useRing::~useRing() { boundRing = previous; }
+
+track::trace::scope::scope(const char *scopeName)
+    : name(scopeName),
+      start(isEnabled() ? juce::Time::getHighResolutionTicks() : 0) {}
+
+track::trace::scope::~scope() {
+    if (start == 0 || !isEnabled())
+        return;
+
+    threadBuffer *b = getThreadBuffer();
+    if (b == nullptr)
+        return;
+
+    juce::uint64 n = b->written.load(std::memory_order_relaxed);
+    b->events[(size_t)(n % (juce::uint64)eventsPerThread)] = {
+        name, start, juce::Time::getHighResolutionTicks()};
+    b->written.store(n + 1, std::memory_order_release);
+}
+
+bool track::trace::dump(juce::File file) {
+    if (buffers == nullptr)
+        return false;
+
+    // what's still in each ring, oldest first
+    auto getRange = [](threadBuffer &b, juce::uint64 &first,
+                       juce::uint64 &last) {
+        last = b.written.load(std::memory_order_acquire);
+        first = last > (juce::uint64)eventsPerThread
+                    ? last - (juce::uint64)eventsPerThread + overwriteMargin
+                    : 0;
+    };
+
+    // timestamps are relative to the earliest event anywhere
+    juce::int64 origin = std::numeric_limits<juce::int64>::max();
+    for (int t = 0; t < maxThreads; ++t) {
+        juce::uint64 first, last;
+        getRange(buffers[(size_t)t], first, last);
+
+        if (first < last) {
+            const traceEvent &e =
+                buffers[(size_t)t]
+                    .events[(size_t)(first % (juce::uint64)eventsPerThread)];
+            origin = juce::jmin(origin, e.start);
+        }
+    }
+
+    auto toMicroseconds = [](juce::int64 ticks) {
+        return juce::String(
+            juce::Time::highResolutionTicksToSeconds(ticks) * 1e6, 3);
+    };
+
+    juce::TemporaryFile tmp(file);
+
+    {
+        juce::FileOutputStream out(tmp.getFile());
+        if (out.failedToOpen())
+            return false;
+
+        out << "{\"traceEvents\":[\n";
+        bool firstEvent = true;
+
+        auto write = [&](const juce::String &json) {
+            if (!firstEvent)
+                out << ",\n";
+            out << json;
+            firstEvent = false;
+        };
+
+        for (int t = 0; t < maxThreads; ++t) {
+            threadBuffer &b = buffers[(size_t)t];
+
+            // never handed out
+            const char *name = b.name.load(std::memory_order_relaxed);
+            if (name == nullptr)
+                continue;
+
+            write("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" +
+                  juce::String(t) + ",\"args\":{\"name\":\"" + escape(name) +
+                  "\"}}");
+
+            juce::uint64 first, last;
+            getRange(b, first, last);
+
+            for (juce::uint64 i = first; i < last; ++i) {
+                const traceEvent &e =
+                    b.events[(size_t)(i % (juce::uint64)eventsPerThread)];
+
+                if (e.name == nullptr || e.end < e.start)
+                    continue;
+
+                write("{\"name\":\"" + escape(e.name) +
+                      "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + juce::String(t) +
+                      ",\"ts\":" + toMicroseconds(e.start - origin) +
+                      ",\"dur\":" + toMicroseconds(e.end - e.start) + "}");
+            }
+        }
+
+        // chrome://tracing shows these under metadata
+        out << "\n],\"otherData\":{\"droppedRings\":"
+            << juce::String(droppedRings.load())
+            << ",\"unnamedThreads\":" << juce::String(unnamedThreads.load())
+            << "}}\n";
+        out.flush();
+
+        if (out.getStatus().failed())
+            return false;
+    }
+
+    return tmp.overwriteTargetFileWithTemporary();
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <JuceHeader.h>
+
+namespace track {
+// built-in profiler. TRACE_SCOPE(name) times the scope it's in; while
+// recording's on, that goes into a ring of fixed-size events owned by the
+// calling thread, so the audio thread never allocates, locks or shares a
+// cache line with anyone. dump() writes whatever the rings still hold as
+// chrome trace json (chrome://tracing or ui.perfetto.dev). one recorder for
+// the whole process; events from every instance end up in the same file
+//
+// only the message thread, threads that call nameThread() and whoever claims
+// one with claimRing() get a ring, so a host's worker threads passing through
+// once don't use them up. a thread's ring is given back when the thread exits,
+// and a claimed one when it's released; the next owner starts it empty. claims
+// after all maxThreads are taken, and unnamed threads that hit a TRACE_SCOPE,
+// are counted and reported at the end of the dump
+namespace trace {
+constexpr int maxThreads = 16; // rings; claims past this don't get recorded
+constexpr int eventsPerThread = 1 << 15;
+
+constexpr int noRing = -1;        // claimRing() found every ring taken
+constexpr int unclaimedRing = -2; // nothing's been claimed yet
+
+// message thread. the buffers get allocated the first time it's turned on
+void setEnabled(bool shouldBeEnabled);
+bool isEnabled();
+
+// gives the calling thread a ring if it doesn't have one yet, and labels it
+// in the dump. name has to be a string literal. only does anything while
+// recording's on
+void nameThread(const char *name);
+
+// a ring for work that isn't tied to one thread, but never runs on two at
+// once (a processor's audio callback, which the host can call from any of its
+// threads). only while recording's on; noRing if they're all taken
+int claimRing(const char *name);
+void releaseRing(int ring); // any thread; ignores anything but a ring
+
+// while one of these is around, the calling thread records into ring instead
+// of its own. unclaimedRing leaves the thread's own in use
+struct useRing {
+    explicit useRing(int ring);
+    ~useRing();
+
+    int previous;
+};
+
+// message thread. false if the file couldn't be written
+bool dump(juce::File file);
+
+// name has to be a string literal; only the pointer is kept
+struct scope {
+    explicit scope(const char *scopeName);
+    ~scope();
+
+    const char *name;
+    juce::int64 start; // 0 if recording was off when this was entered
+};
+} // namespace trace
+} // namespace track
+
+#define TRACE_SCOPE(name)                                                      \
+    track::trace::scope JUCE_JOIN_MACRO(traceScope, __LINE__)(name)
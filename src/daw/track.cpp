@@ -4,20 +4,27 @@
 #include "automation_relay.h"
 #include "clipboard.h"
 #include "defs.h"
+#include "diskcache.h"
+#include "peaks.h"
 #include "subwindow.h"
 #include "timeline.h"
+#include "trace.h"
 #include "utility.h"
+#include "watchdog.h"
 #include <cstddef>
 
-track::ClipComponent::ClipComponent(clip *c, int clipHash)
-    : juce::Component(), thumbnailCache(5),
-      thumbnail(256, afm, thumbnailCache) {
+track::ClipComponent::ClipComponent(clip *c, PeakCache *cache,
+                                    void *processor)
+    : juce::Component() {
     jassert(c != nullptr);
 
     this->correspondingClip = c;
-    thumbnail.setSource(&correspondingClip->buffer, SAMPLE_RATE, clipHash);
+    this->clipID = c->id;
+    this->peakCache = cache;
+    this->processor = processor;
 
-    thumbnail.addChangeListener(this);
+    if (peakCache != nullptr)
+        peakCache->addChangeListener(this);
 
     clipNameLabel.setFont(
         getInterSemiBold().withHeight(17.f).withExtraKerningFactor(-.02f));
@@ -33,13 +40,12 @@ track::ClipComponent::ClipComponent(clip *c, int clipHash)
         TimelineComponent *tc = (TimelineComponent *)getParentComponent();
         Tracklist *tracklist = tc->viewport->tracklist;
 
-        audioNode *node = tracklist->trackComponents[(size_t)nodeDisplayIndex]
-                              ->getCorrespondingTrack();
+        audioNode *node = tracklist->getNodeAtRow(nodeDisplayIndex);
         int index = track::utility::getIndexOfClip(node, correspondingClip);
 
         ActionClipModified *action = new ActionClipModified(
             tc->processorRef,
-            tracklist->trackComponents[(size_t)nodeDisplayIndex]->route, index,
+            tracklist->getRouteAtRow(nodeDisplayIndex), index,
             *this->correspondingClip);
 
         correspondingClip->name = clipNameLabel.getText(true);
@@ -53,27 +59,173 @@ track::ClipComponent::ClipComponent(clip *c, int clipHash)
         repaint();
     };
 
-    setBufferedToImage(true);
+    // not buffered to an image; drawing from the peak cache only costs as
+    // much as the visible part of the clip, and long clips made for huge
+    // images
     setOpaque(false);
 
     setWantsKeyboardFocus(true);
 }
-track::ClipComponent::~ClipComponent() { thumbnail.removeAllChangeListeners(); }
+track::ClipComponent::~ClipComponent() {
+    if (peakCache != nullptr)
+        peakCache->removeChangeListener(this);
+}
+
+juce::String track::ClipComponent::getClipState() {
+    clip *c = correspondingClip;
+
+    return c->path + "|" + c->name + "|" +
+           juce::String(c->startPositionSample) + "|" +
+           juce::String(c->trimLeft) + "|" + juce::String(c->trimRight) + "|" +
+           juce::String(c->gain) + "|" + juce::String((int)c->active) + "|" +
+           juce::String(c->getSourceNumSamples());
+}
+
+bool track::ClipComponent::isPinned() {
+    return isBeingDragged || hasKeyboardFocus(true) ||
+           clipNameLabel.isBeingEdited();
+}
 
 void track::ClipComponent::changeListenerCallback(
     ChangeBroadcaster * /*source*/) {
     repaint();
 }
 
+void track::ClipComponent::drawWaveform(juce::Graphics &g,
+                                        juce::Rectangle<int> bounds) {
+    clip *c = correspondingClip;
+    int numChannels = c->getNumChannels();
+    juce::int64 numSamples = c->getSourceNumSamples();
+
+    if (numChannels == 0 || bounds.getWidth() <= 0)
+        return;
+
+    // the timeline is at the host's rate; the peaks and buffer are at the
+    // clip's
+    double toSource =
+        c->needsResampling() ? c->sampleRate / c->hostSampleRate : 1.0;
+    double start = c->trimLeft * toSource;
+    double end = (c->getNumSamples() - c->trimRight) * toSource;
+    double perPixel = (end - start) / bounds.getWidth();
+
+    if (perPixel <= 0.0)
+        return;
+
+    // zoomed in far enough that reading the buffer costs about the same
+    bool useBuffer = perPixel <= PeakCache::baseSamplesPerPeak;
+
+    std::shared_ptr<const peakFile> peaks;
+    if (!useBuffer && peakCache != nullptr)
+        peaks = peakCache->get(c->path);
+
+    // still being built; we get repainted once they're in
+    if (!useBuffer && peaks == nullptr)
+        return;
+
+    juce::Rectangle<int> visible = bounds.getIntersection(g.getClipBounds());
+
+    // clips with a source don't have a buffer to look at; read just what's
+    // visible
+    juce::AudioBuffer<float> window;
+    juce::int64 firstSample = 0;
+    juce::int64 lastSample = numSamples;
+
+    if (useBuffer && c->source != nullptr) {
+        firstSample = juce::jlimit(
+            (juce::int64)0, numSamples,
+            (juce::int64)(start + (visible.getX() - bounds.getX()) * perPixel));
+        lastSample = juce::jmin(
+            numSamples,
+            firstSample + (juce::int64)(visible.getWidth() * perPixel) + 2);
+
+        if (lastSample <= firstSample)
+            return;
+
+        window.setSize(numChannels, (int)(lastSample - firstSample));
+        c->source->read(window.getArrayOfWritePointers(), numChannels,
+                        firstSample, window.getNumSamples());
+    }
+
+    float channelHeight = (float)bounds.getHeight() / (float)numChannels;
+    juce::RectangleList<float> columns;
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        float halfHeight = channelHeight * 0.5f;
+        float mid =
+            (float)bounds.getY() + channelHeight * (float)ch + halfHeight;
+        const float *samples = nullptr;
+        if (useBuffer)
+            samples = c->source != nullptr ? window.getReadPointer(ch)
+                                           : c->buffer.getReadPointer(ch);
+
+        for (int x = visible.getX(); x < visible.getRight(); ++x) {
+            double offset = (x - bounds.getX()) * perPixel;
+            juce::int64 s0 = (juce::int64)(start + offset);
+            juce::int64 s1 =
+                juce::jmax(s0 + 1, (juce::int64)(start + offset + perPixel));
+
+            float lo = 0.f;
+            float hi = 0.f;
+
+            if (useBuffer) {
+                s0 = juce::jlimit(firstSample, lastSample, s0) - firstSample;
+                s1 = juce::jlimit(firstSample, lastSample, s1) - firstSample;
+
+                if (s0 >= s1)
+                    continue;
+
+                lo = samples[s0];
+                hi = samples[s0];
+                for (juce::int64 i = s0 + 1; i < s1; ++i) {
+                    lo = juce::jmin(lo, samples[i]);
+                    hi = juce::jmax(hi, samples[i]);
+                }
+            } else {
+                peaks->getRange(ch, s0, s1, lo, hi);
+            }
+
+            // gain works as vertical zoom, like it did with AudioThumbnail
+            lo = juce::jlimit(-1.f, 1.f, lo * c->gain);
+            hi = juce::jlimit(-1.f, 1.f, hi * c->gain);
+
+            float top = mid - hi * halfHeight;
+            float bottom = mid - lo * halfHeight;
+            columns.addWithoutMerging(
+                {(float)x, top, 1.f, juce::jmax(1.f, bottom - top)});
+        }
+    }
+
+    g.fillRectList(columns);
+}
+
 void track::ClipComponent::paint(juce::Graphics &g) {
+    engineContext &ctx = getContext(processor);
+
     float cornerSize = 4.f;
 
-    if (thumbnail.getNumChannels() == 0) {
-        g.fillAll(juce::Colours::grey);
+    if (!correspondingClip->isLoaded()) {
+        // clips that were just imported don't have their buffer yet
+        TimelineComponent *tc = findParentComponentOfClass<TimelineComponent>();
+        bool decoding = tc != nullptr && tc->processorRef->importer.isPending(
+                                             correspondingClip->path);
+
+        juce::String text = "SAMPLE OFFLINE";
+        if (decoding) {
+            float progress = tc->processorRef->importer.getResampleProgress(
+                correspondingClip->path);
+
+            if (progress >= 0.f && progress < 1.f)
+                text = "RESAMPLING " +
+                       juce::String(juce::roundToInt(progress * 100.f)) + "%";
+            else
+                text = "DECODING...";
+        }
+
+        g.fillAll(decoding ? juce::Colour(0xFF'33587F).withSaturation(0.3f)
+                           : juce::Colours::grey);
         g.setColour(juce::Colours::white);
         g.setFont(12.f);
-        g.drawText("SAMPLE OFFLINE", getLocalBounds(),
-                   juce::Justification::centred, true);
+        g.drawText(text, getLocalBounds(), juce::Justification::centred, true);
     }
 
     else {
@@ -107,23 +259,16 @@ void track::ClipComponent::paint(juce::Graphics &g) {
         if (coolColors)
             g.setColour(juce::Colour(0xFF'16455B));
 
-        if (UI_TRACK_HEIGHT > UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT) {
+        if (ctx.trackHeight > UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT) {
             int thumbnailTopMargin = 14;
             juce::Rectangle<int> thumbnailBounds = getLocalBounds().reduced(2);
             thumbnailBounds.setHeight(thumbnailBounds.getHeight() -
                                       thumbnailTopMargin);
             thumbnailBounds.setY(thumbnailBounds.getY() + thumbnailTopMargin);
 
-            thumbnail.drawChannels(
-                g, thumbnailBounds,
-                correspondingClip->trimLeft / track::SAMPLE_RATE,
-                (correspondingClip->buffer.getNumSamples() -
-                 correspondingClip->trimRight) /
-                    track::SAMPLE_RATE,
-                correspondingClip->gain); // TODO: is just changing the vertical
-                                          // zoom factor actually accurate?
+            drawWaveform(g, thumbnailBounds);
 
-            if (thumbnail.getNumChannels() == 1) {
+            if (correspondingClip->getNumChannels() == 1) {
                 // mono
                 g.drawHorizontalLine(thumbnailTopMargin +
                                          (thumbnailBounds.getHeight() / 2) + 1,
@@ -204,7 +349,7 @@ void track::ClipComponent::copyClip() {
 
     *newClip = *correspondingClip;
 
-    clipboard::setData(newClip, TYPECODE_CLIP);
+    getClipboard(processor).setData(newClip, TYPECODE_CLIP);
 
     coolColors = true;
     repaint();
@@ -256,7 +401,7 @@ void track::ClipComponent::mouseDown(const juce::MouseEvent &event) {
                 std::unique_ptr<clip> newClip(new clip());
                 *newClip = *correspondingClip;
 
-                int clipLength = correspondingClip->buffer.getNumSamples() -
+                int clipLength = correspondingClip->getNumSamples() -
                                  correspondingClip->trimLeft -
                                  correspondingClip->trimRight;
                 newClip->startPositionSample =
@@ -269,8 +414,7 @@ void track::ClipComponent::mouseDown(const juce::MouseEvent &event) {
 
                 track::Tracklist *tracklist = viewport->tracklist;
                 std::vector<int> route =
-                    tracklist->trackComponents[(size_t)this->nodeDisplayIndex]
-                        ->route;
+                    tracklist->getRouteAtRow(this->nodeDisplayIndex);
 
                 track::TimelineComponent *tc = (track::TimelineComponent *)
                     findParentComponentOfClass<TimelineComponent>();
@@ -306,8 +450,9 @@ void track::ClipComponent::mouseDown(const juce::MouseEvent &event) {
             }
 
             else if (result == MENU_SPLIT_CLIP) {
+                engineContext &ctx = getContext(processor);
                 int splitSample =
-                    ((float)event.x / UI_ZOOM_MULTIPLIER) * SAMPLE_RATE;
+                    ((float)event.x / ctx.zoomMultiplier) * ctx.sampleRate;
 
                 TimelineComponent *tc =
                     findParentComponentOfClass<TimelineComponent>();
@@ -329,11 +474,9 @@ void track::ClipComponent::mouseDown(const juce::MouseEvent &event) {
                 track::Tracklist *tracklist = tv->tracklist;
 
                 std::vector<int> nodeRoute =
-                    tracklist->trackComponents[(size_t)this->nodeDisplayIndex]
-                        ->route;
+                    tracklist->getRouteAtRow(this->nodeDisplayIndex);
                 audioNode *node =
-                    tracklist->trackComponents[(size_t)this->nodeDisplayIndex]
-                        ->getCorrespondingTrack();
+                    tracklist->getNodeAtRow(this->nodeDisplayIndex);
 
                 int clipIndex =
                     utility::getIndexOfClip(node, correspondingClip);
@@ -372,11 +515,9 @@ void track::ClipComponent::mouseDown(const juce::MouseEvent &event) {
             track::Tracklist *tracklist = tv->tracklist;
 
             std::vector<int> nodeRoute =
-                tracklist->trackComponents[(size_t)this->nodeDisplayIndex]
-                    ->route;
+                tracklist->getRouteAtRow(this->nodeDisplayIndex);
             audioNode *node =
-                tracklist->trackComponents[(size_t)this->nodeDisplayIndex]
-                    ->getCorrespondingTrack();
+                tracklist->getNodeAtRow(this->nodeDisplayIndex);
 
             int clipIndex = utility::getIndexOfClip(node, correspondingClip);
             jassert(clipIndex != -1);
@@ -388,14 +529,20 @@ void track::ClipComponent::mouseDown(const juce::MouseEvent &event) {
 
 // cs exam tomorrow but fuck it the curriculum is full of shit
 void track::ClipComponent::mouseDrag(const juce::MouseEvent &event) {
+    engineContext &ctx = getContext(processor);
+
+    // the clip was removed mid-drag
+    if (correspondingClip == nullptr)
+        return;
+
     int y = event.getEventRelativeTo(getParentComponent()).y;
 
     isBeingDragged = true;
     curDragNodeDisplayIndex =
-        ((y + (UI_TRACK_HEIGHT / 2)) / UI_TRACK_HEIGHT) - 1;
+        ((y + (ctx.trackHeight / 2)) / ctx.trackHeight) - 1;
 
     int distanceMoved = event.getDistanceFromDragStartX();
-    int deltaSamples = (distanceMoved * SAMPLE_RATE) / UI_ZOOM_MULTIPLIER;
+    int deltaSamples = (distanceMoved * ctx.sampleRate) / ctx.zoomMultiplier;
     int rawSamplePos = startDragStartPositionSample + deltaSamples;
 
     // if ctrl held, trim
@@ -410,11 +557,12 @@ void track::ClipComponent::mouseDrag(const juce::MouseEvent &event) {
                 // absolute snap position ON THE GRID
                 int absoluteLeftBoundary =
                     startDragStartPositionSample + newTrimLeft;
-                int snappedAbsolute =
-                    utility::snapSample(absoluteLeftBoundary, SNAP_DIVISION);
+                int snappedAbsolute = utility::snapSample(
+                    absoluteLeftBoundary, ctx.snapDivision, processor);
                 newTrimLeft = snappedAbsolute - startDragStartPositionSample;
 
-                newTrimLeft = utility::snapSample(newTrimLeft, SNAP_DIVISION);
+                newTrimLeft = utility::snapSample(newTrimLeft,
+                                                  ctx.snapDivision, processor);
             }
 
             int trimDelta = newTrimLeft - startTrimLeftPositionSample;
@@ -434,20 +582,20 @@ void track::ClipComponent::mouseDrag(const juce::MouseEvent &event) {
                 // absolute snap position ON THE GRID
                 int absoluteRightBoundary =
                     correspondingClip->startPositionSample +
-                    correspondingClip->buffer.getNumSamples() -
+                    correspondingClip->getNumSamples() -
                     correspondingClip->trimLeft - newTrimRight;
 
-                int snappedAbsolute =
-                    utility::snapSample(absoluteRightBoundary, SNAP_DIVISION);
+                int snappedAbsolute = utility::snapSample(
+                    absoluteRightBoundary, ctx.snapDivision, processor);
 
                 newTrimRight = correspondingClip->startPositionSample +
-                               correspondingClip->buffer.getNumSamples() -
+                               correspondingClip->getNumSamples() -
                                correspondingClip->trimLeft - snappedAbsolute;
 
                 newTrimRight = std::max(0, newTrimRight);
 
                 // newTrimRight = utility::snapSample(newTrimRight,
-                // SNAP_DIVISION);
+                // ctx.snapDivision);
             }
 
             correspondingClip->trimRight = newTrimRight;
@@ -458,9 +606,10 @@ void track::ClipComponent::mouseDrag(const juce::MouseEvent &event) {
         return;
     }
 
-    int newStartPos = event.mods.isAltDown()
-                          ? rawSamplePos
-                          : utility::snapSample(rawSamplePos, SNAP_DIVISION);
+    int newStartPos =
+        event.mods.isAltDown()
+            ? rawSamplePos
+            : utility::snapSample(rawSamplePos, ctx.snapDivision, processor);
 
     correspondingClip->startPositionSample = newStartPos;
 
@@ -471,6 +620,12 @@ void track::ClipComponent::mouseDrag(const juce::MouseEvent &event) {
 }
 
 void track::ClipComponent::mouseUp(const juce::MouseEvent &event) {
+    if (correspondingClip == nullptr) {
+        isBeingDragged = false;
+        curDragNodeDisplayIndex = -1;
+        return;
+    }
+
     if (curDragNodeDisplayIndex != -1 &&
         curDragNodeDisplayIndex != nodeDisplayIndex) {
         DBG("move this clip to node with display index: "
@@ -481,8 +636,8 @@ void track::ClipComponent::mouseUp(const juce::MouseEvent &event) {
         jassert(tc->viewport != nullptr);
         jassert(tc->viewport->tracklist != nullptr);
 
-        if ((size_t)curDragNodeDisplayIndex >
-            tc->viewport->tracklist->trackComponents.size() - 1) {
+        if (curDragNodeDisplayIndex >
+            tc->viewport->tracklist->getNumRows() - 1) {
             correspondingClip->startPositionSample =
                 startDragStartPositionSample;
 
@@ -492,13 +647,11 @@ void track::ClipComponent::mouseUp(const juce::MouseEvent &event) {
         } else {
             std::vector<int> srcRoute =
                 tc->viewport->tracklist
-                    ->trackComponents[(size_t)nodeDisplayIndex]
-                    ->route;
+                    ->getRouteAtRow(nodeDisplayIndex);
 
             std::vector<int> destRoute =
                 tc->viewport->tracklist
-                    ->trackComponents[(size_t)curDragNodeDisplayIndex]
-                    ->route;
+                    ->getRouteAtRow(curDragNodeDisplayIndex);
 
             // this is an absolute fucking mess and i am too lazy to fix it
             ActionMoveClipToNode *action = new ActionMoveClipToNode(
@@ -530,8 +683,7 @@ void track::ClipComponent::mouseUp(const juce::MouseEvent &event) {
 
         // dispatch to undomanager
         Tracklist *tracklist = tc->viewport->tracklist;
-        audioNode *node = tracklist->trackComponents[(size_t)nodeDisplayIndex]
-                              ->getCorrespondingTrack();
+        audioNode *node = tracklist->getNodeAtRow(nodeDisplayIndex);
         int index = track::utility::getIndexOfClip(node, correspondingClip);
 
         bool noChange =
@@ -543,7 +695,7 @@ void track::ClipComponent::mouseUp(const juce::MouseEvent &event) {
         if (!noChange) {
             ActionClipModified *action = new ActionClipModified(
                 tc->processorRef,
-                tracklist->trackComponents[(size_t)nodeDisplayIndex]->route,
+                tracklist->getRouteAtRow(nodeDisplayIndex),
                 index, *this->correspondingClip);
 
             action->oldClip.startPositionSample = startDragStartPositionSample;
@@ -617,9 +769,7 @@ bool track::ClipComponent::keyStateChanged(bool isKeyDown) {
                   juce::KeyPress::isKeyCurrentlyDown(268435711)) &&
                  !clipNameLabel.isBeingEdited()) {
             TimelineComponent *tc = (TimelineComponent *)getParentComponent();
-
-            if (!tc->renderingWaveforms())
-                tc->deleteClip(correspondingClip, nodeDisplayIndex);
+            tc->deleteClip(correspondingClip, nodeDisplayIndex);
 
             return true;
         }
@@ -639,7 +789,7 @@ track::ActionClipModified::ActionClipModified(void *processor,
                                               int indexOfClip, clip c)
     : juce::UndoableAction() {
     this->p = processor;
-    this->route = nodeRoute;
+    this->nodeID = utility::getNodeFromRoute(nodeRoute, processor)->id;
     this->clipIndex = indexOfClip;
     this->newClip = c;
     this->oldClip = c;
@@ -647,14 +797,20 @@ track::ActionClipModified::ActionClipModified(void *processor,
 track::ActionClipModified::~ActionClipModified() {}
 
 track::clip *track::ActionClipModified::getClip() {
-    return &utility::getNodeFromRoute(route, p)->clips[(size_t)clipIndex];
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    return &processor->getNodeByID(nodeID)->clips[(size_t)clipIndex];
 }
 
 bool track::ActionClipModified::perform() {
+    TRACE_SCOPE("ActionClipModified::perform");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
 
-    clip *c = getClip();
-    *c = newClip;
+    clip c = newClip;
+    {
+        const juce::ScopedLock sl(processor->getCallbackLock());
+        *getClip() = std::move(c);
+    }
 
     markClipComponentStale();
     updateGUI();
@@ -664,10 +820,15 @@ bool track::ActionClipModified::perform() {
 }
 
 bool track::ActionClipModified::undo() {
+    TRACE_SCOPE("ActionClipModified::undo");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
 
-    clip *c = getClip();
-    *c = oldClip;
+    clip c = oldClip;
+    {
+        const juce::ScopedLock sl(processor->getCallbackLock());
+        *getClip() = std::move(c);
+    }
 
     markClipComponentStale();
     updateGUI();
@@ -693,8 +854,8 @@ track::ActionMoveClipToNode::ActionMoveClipToNode(
 
     int sourceStartSample, int destinationStartSample) {
     this->p = processor;
-    this->srcRoute = src;
-    this->destRoute = dest;
+    this->srcNodeID = utility::getNodeFromRoute(src, processor)->id;
+    this->destNodeID = utility::getNodeFromRoute(dest, processor)->id;
     this->clipIndex = index;
     this->srcStartSample = sourceStartSample;
     this->destStartSample = destinationStartSample;
@@ -703,23 +864,28 @@ track::ActionMoveClipToNode::ActionMoveClipToNode(
 track::ActionMoveClipToNode::~ActionMoveClipToNode() {}
 
 bool track::ActionMoveClipToNode::perform() {
-    audioNode *srcNode = utility::getNodeFromRoute(srcRoute, p);
-    audioNode *destNode = utility::getNodeFromRoute(destRoute, p);
+    TRACE_SCOPE("ActionMoveClipToNode::perform");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *srcNode = processor->getNodeByID(srcNodeID);
+    audioNode *destNode = processor->getNodeByID(destNodeID);
 
-    if (!destNode->isTrack) {
+    if (!destNode->isTrack || destNode->isReturn) {
         srcNode->clips[(size_t)this->clipIndex].startPositionSample =
             srcStartSample;
         updateGUI();
         return false;
     }
 
-    clip c = srcNode->clips[(size_t)this->clipIndex];
-    c.startPositionSample = destStartSample;
+    {
+        const juce::ScopedLock sl(processor->getCallbackLock());
 
-    auto &x = destNode->clips.emplace_back();
-    x = c;
+        clip c = std::move(srcNode->clips[(size_t)this->clipIndex]);
+        srcNode->clips.erase(srcNode->clips.begin() + this->clipIndex);
 
-    srcNode->clips.erase(srcNode->clips.begin() + this->clipIndex);
+        c.startPositionSample = destStartSample;
+        destNode->clips.push_back(std::move(c));
+    }
 
     updateGUI();
 
@@ -727,14 +893,22 @@ bool track::ActionMoveClipToNode::perform() {
 }
 
 bool track::ActionMoveClipToNode::undo() {
-    audioNode *srcNode = utility::getNodeFromRoute(srcRoute, p);
-    audioNode *destNode = utility::getNodeFromRoute(destRoute, p);
+    TRACE_SCOPE("ActionMoveClipToNode::undo");
 
-    clip c = destNode->clips.back();
-    c.startPositionSample = srcStartSample;
-    srcNode->clips.emplace(srcNode->clips.begin() + this->clipIndex);
-    srcNode->clips[(size_t)clipIndex] = c;
-    destNode->clips.pop_back();
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *srcNode = processor->getNodeByID(srcNodeID);
+    audioNode *destNode = processor->getNodeByID(destNodeID);
+
+    {
+        const juce::ScopedLock sl(processor->getCallbackLock());
+
+        clip c = std::move(destNode->clips.back());
+        destNode->clips.pop_back();
+
+        c.startPositionSample = srcStartSample;
+        srcNode->clips.insert(srcNode->clips.begin() + this->clipIndex,
+                              std::move(c));
+    }
 
     updateGUI();
 
@@ -877,6 +1051,11 @@ track::TrackComponent::TrackComponent::getCorrespondingTrack() {
     return utility::getNodeFromRoute(this->route, processor);
 }
 
+bool track::TrackComponent::isPinned() {
+    return isMouseButtonDown(true) || hasKeyboardFocus(true) ||
+           trackNameLabel.isBeingEdited();
+}
+
 void track::TrackComponent::initializSliders() {
     gainSlider.setValue(getCorrespondingTrack()->gain);
     panSlider.setValue(getCorrespondingTrack()->pan);
@@ -903,7 +1082,7 @@ track::TrackComponent::TrackComponent(int trackIndex) : juce::Component() {
     };
 
     // starting text for track name label is set when TrackComponent is
-    // created in createTrackComponents()
+    // assigned a row in Tracklist::assignRow()
     trackNameLabel.setFont(
         getAudioNodeLabelFont().withHeight(17.f).withExtraKerningFactor(
             -0.02f));
@@ -940,6 +1119,9 @@ track::TrackComponent::TrackComponent(int trackIndex) : juce::Component() {
 
     this->siblingIndex = trackIndex;
 
+    addChildComponent(armBtn);
+    armBtn.setButtonText("R");
+
     addAndMakeVisible(muteBtn);
     muteBtn.setButtonText("M");
 
@@ -990,6 +1172,17 @@ track::TrackComponent::TrackComponent(int trackIndex) : juce::Component() {
         sendFocusToTimeline();
     };
 
+    armBtn.onClick = [this] {
+        getCorrespondingTrack()->recordArmed =
+            !(getCorrespondingTrack()->recordArmed);
+
+        AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+        p->updateRecordArmed();
+
+        repaint();
+        sendFocusToTimeline();
+    };
+
     soloBtn.onClick = [this] {
         getCorrespondingTrack()->s = !(getCorrespondingTrack()->s);
 
@@ -998,12 +1191,9 @@ track::TrackComponent::TrackComponent(int trackIndex) : juce::Component() {
         if (getCorrespondingTrack()->s) {
             p->soloMode = true;
         } else {
-            Tracklist *tracklist =
-                (Tracklist *)findParentComponentOfClass<Tracklist>();
-
             bool foundSolo = false;
-            for (auto &nodeComponents : tracklist->trackComponents) {
-                if (nodeComponents->getCorrespondingTrack()->s) {
+            for (auto *node : utility::getFlattenedNodes(processor)) {
+                if (node->s) {
                     foundSolo = true;
                     break;
                 }
@@ -1078,10 +1268,11 @@ void track::TrackComponent::mouseDown(const juce::MouseEvent &event) {
         contextMenu.addItem(
             "Paste node as child",
             !getCorrespondingTrack()->isTrack &&
-                clipboard::typecode == TYPECODE_NODE,
+                getClipboard(processor).typecode == TYPECODE_NODE,
             false, [this] {
                 ActionPasteNode *action = new ActionPasteNode(
-                    route, (audioNode *)clipboard::data, processor);
+                    route, (audioNode *)getClipboard(processor).data,
+                    processor);
 
                 AudioPluginAudioProcessor *p =
                     (AudioPluginAudioProcessor *)processor;
@@ -1104,6 +1295,34 @@ void track::TrackComponent::mouseDown(const juce::MouseEvent &event) {
                 p->undoManager.perform(action);
             });
 
+        PopupMenu sendsMenu;
+        addSendsMenu(sendsMenu);
+        contextMenu.addSubMenu("Sends", sendsMenu);
+
+        PopupMenu outputMenu;
+        addOutputMenu(outputMenu);
+        contextMenu.addSubMenu("Output", outputMenu);
+
+        contextMenu.addItem(
+            "Mono", getCorrespondingTrack()->isTrack,
+            getCorrespondingTrack()->mono, [this] {
+                TrivialNodeData oldState;
+                TrivialNodeData newState;
+
+                utility::getTrivialNodeData(&oldState, getCorrespondingTrack());
+                utility::getTrivialNodeData(&newState, getCorrespondingTrack());
+                newState.mono = !oldState.mono;
+
+                AudioPluginAudioProcessor *p =
+                    (AudioPluginAudioProcessor *)processor;
+                ActionModifyTrivialNodeData *action =
+                    new ActionModifyTrivialNodeData(route, oldState, newState,
+                                                    processor);
+                p->undoManager.beginNewTransaction(
+                    "action modify trivial node data");
+                p->undoManager.perform(action);
+            });
+
         contextMenu.addItem("Reset volume", [this] {
             getCorrespondingTrack()->gain = 1.f;
             gainSlider.setValue(1.f);
@@ -1185,50 +1404,178 @@ void track::TrackComponent::mouseDown(const juce::MouseEvent &event) {
     repaint();
 }
 
+void track::TrackComponent::addOutputMenu(juce::PopupMenu &menu) {
+    AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+    audioNode *node = getCorrespondingTrack();
+
+    for (int bus = 0; bus < MAX_OUTPUT_BUSES; ++bus) {
+        juce::String name =
+            bus == 0 ? juce::String("Main") : "Output " + juce::String(bus + 1);
+
+        // still selectable when the host has it off; it plays through main
+        if (bus > 0 && !p->isOutputBusEnabled(bus))
+            name += " (disabled)";
+
+        menu.addItem(name, true, node->outputBus == bus, [this, bus] {
+            TrivialNodeData oldState;
+            TrivialNodeData newState;
+
+            utility::getTrivialNodeData(&oldState, getCorrespondingTrack());
+            utility::getTrivialNodeData(&newState, getCorrespondingTrack());
+            newState.outputBus = bus;
+
+            AudioPluginAudioProcessor *p =
+                (AudioPluginAudioProcessor *)processor;
+            ActionModifyTrivialNodeData *action =
+                new ActionModifyTrivialNodeData(route, oldState, newState,
+                                                processor);
+            p->undoManager.beginNewTransaction(
+                "action modify trivial node data");
+            p->undoManager.perform(action);
+        });
+    }
+}
+
+void track::TrackComponent::addSendsMenu(juce::PopupMenu &menu) {
+    AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+    audioNode *node = getCorrespondingTrack();
+
+    bool foundReturn = false;
+
+    // every return that this node could send to
+    for (audioNode &t : p->tracks) {
+        if (!t.isReturn)
+            continue;
+
+        foundReturn = true;
+
+        bool alreadySending = false;
+        for (send &s : node->sends) {
+            if (s.returnID == t.returnID)
+                alreadySending = true;
+        }
+
+        bool enabled = &t != node && !alreadySending &&
+                       !p->sendWouldCreateCycle(node, t.returnID);
+        int id = t.returnID;
+
+        menu.addItem("Send to " + t.trackName, enabled, alreadySending,
+                     [this, id] {
+                         std::vector<send> newSends =
+                             getCorrespondingTrack()->sends;
+                         send &s = newSends.emplace_back();
+                         s.returnID = id;
+
+                         modifySends(newSends);
+                     });
+    }
+
+    if (!foundReturn)
+        menu.addItem("No returns", false, false, [] {});
+
+    if (node->sends.size() > 0)
+        menu.addSeparator();
+
+    // existing sends
+    for (size_t i = 0; i < node->sends.size(); ++i) {
+        send &s = node->sends[i];
+        audioNode *target = p->getReturn(s.returnID);
+
+        PopupMenu sendMenu;
+
+        sendMenu.addItem("Pre-fader", true, s.preFader, [this, i] {
+            std::vector<send> newSends = getCorrespondingTrack()->sends;
+            newSends[i].preFader = !newSends[i].preFader;
+            modifySends(newSends);
+        });
+
+        sendMenu.addSeparator();
+
+        for (float db : {6.f, 0.f, -6.f, -12.f, -18.f, -24.f}) {
+            float gain = juce::Decibels::decibelsToGain(db);
+            bool ticked = std::abs(s.gain - gain) < 0.001f;
+
+            sendMenu.addItem(juce::String(db, 0) + " dB", true, ticked,
+                             [this, i, gain] {
+                                 std::vector<send> newSends =
+                                     getCorrespondingTrack()->sends;
+                                 newSends[i].gain = gain;
+                                 modifySends(newSends);
+                             });
+        }
+
+        sendMenu.addSeparator();
+
+        sendMenu.addItem("Remove", [this, i] {
+            std::vector<send> newSends = getCorrespondingTrack()->sends;
+            newSends.erase(newSends.begin() + (long)i);
+            modifySends(newSends);
+        });
+
+        // the return might've been deleted; the send stays until removed
+        juce::String name =
+            target == nullptr ? "(deleted return)" : target->trackName;
+        name += juce::String(" (") +
+                juce::String(juce::Decibels::gainToDecibels(s.gain), 1) +
+                " dB" + (s.preFader ? ", pre)" : ")");
+
+        menu.addSubMenu(name, sendMenu);
+    }
+}
+
+void track::TrackComponent::modifySends(std::vector<send> newSends) {
+    AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+
+    ActionModifySends *action =
+        new ActionModifySends(route, newSends, processor);
+    p->undoManager.beginNewTransaction("action modify sends");
+    p->undoManager.perform(action);
+}
+
 void track::TrackComponent::mouseDrag(const juce::MouseEvent &event) {
+    engineContext &ctx = getContext(processor);
+
     if (event.mouseWasDraggedSinceMouseDown() &&
         event.mods.isLeftButtonDown()) {
         Tracklist *tracklist = findParentComponentOfClass<Tracklist>();
         float mouseYInTracklist =
             event.getEventRelativeTo(tracklist).position.getY() -
-            (UI_TRACK_HEIGHT / 2.f);
-        int displayNodes = (int)(mouseYInTracklist / (float)(UI_TRACK_HEIGHT));
+            (ctx.trackHeight / 2.f);
+        int displayNodes = (int)(mouseYInTracklist / (float)(ctx.trackHeight));
 
         tracklist->updateInsertIndicator(displayNodes);
     }
 }
 
 void track::TrackComponent::mouseUp(const juce::MouseEvent &event) {
+    engineContext &ctx = getContext(processor);
+
     if (event.mouseWasDraggedSinceMouseDown()) {
         Tracklist *tracklist = findParentComponentOfClass<Tracklist>();
         tracklist->updateInsertIndicator(-1);
 
         float mouseYInTracklist =
             event.getEventRelativeTo(tracklist).position.getY() -
-            (UI_TRACK_HEIGHT / 2.f);
-        int displayNodes = (int)(mouseYInTracklist / (float)(UI_TRACK_HEIGHT));
+            (ctx.trackHeight / 2.f);
+        int displayNodes = (int)(mouseYInTracklist / (float)(ctx.trackHeight));
 
         // clang-format off
-        if ((size_t)displayNodes >= tracklist->trackComponents.size() || displayNodes < 0)
+        if (displayNodes >= tracklist->getNumRows() || displayNodes < 0)
             return;
 
-        if (tracklist->trackComponents[(size_t)displayNodes]->getCorrespondingTrack()->isTrack) {
+        if (tracklist->getNodeAtRow(displayNodes)->isTrack) {
             AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
       
             std::vector<int> sourceRoute = this->route;
-            std::vector<int> movementRoute = tracklist->trackComponents[(size_t)displayNodes]->route;
+            std::vector<int> movementRoute = tracklist->getRouteAtRow(displayNodes);
 
             if (utility::isSibling(  
-                tracklist->trackComponents[(size_t)displayNodes]->route, this->route)) {
+                tracklist->getRouteAtRow(displayNodes), this->route)) {
                 ActionReorderNode *action = new ActionReorderNode(sourceRoute, movementRoute, processor);
                 p->undoManager.beginNewTransaction("action reorder node");
                 p->undoManager.perform(action);
 
-                // utility::reorderNodeAlt(sourceRoute, movementRoute, processor);
-
-                tracklist->trackComponents.clear();
                 tracklist->createTrackComponents();
-                tracklist->setTrackComponentBounds();
 
                 track::TimelineComponent* timelineComponent = (TimelineComponent*)tracklist->timelineComponent;
                 timelineComponent->updateClipComponents();
@@ -1282,7 +1629,8 @@ bool track::TrackComponent::keyStateChanged(bool isKeyDown) {
         else if (juce::KeyPress::isKeyCurrentlyDown(86)) {
             if (!getCorrespondingTrack()->isTrack) {
                 ActionPasteNode *action = new ActionPasteNode(
-                    route, (audioNode *)clipboard::data, processor);
+                    route, (audioNode *)getClipboard(processor).data,
+                    processor);
 
                 AudioPluginAudioProcessor *p =
                     (AudioPluginAudioProcessor *)processor;
@@ -1302,7 +1650,7 @@ void track::TrackComponent::copyNodeToClipboard() {
     // copy node
     audioNode *node = new audioNode;
     utility::copyNode(node, getCorrespondingTrack(), processor);
-    clipboard::setData(node, TYPECODE_NODE);
+    getClipboard(processor).setData(node, TYPECODE_NODE);
 
     // visual feedback
     // if we're group, find all other nodes whose route starts with this
@@ -1339,6 +1687,8 @@ void track::TrackComponent::copyNodeToClipboard() {
 }
 
 void track::TrackComponent::paint(juce::Graphics &g) {
+    engineContext &ctx = getContext(processor);
+
 
     juce::Colour bg = juce::Colour(0xFF'5F5F5F);
     juce::Colour trackBg = juce::Colour(0xFF'414141).darker(0.1f);
@@ -1375,6 +1725,8 @@ void track::TrackComponent::paint(juce::Graphics &g) {
 
     juce::Colour fillColor =
         getCorrespondingTrack()->isTrack ? trackBg : groupBg;
+    if (getCorrespondingTrack()->isReturn)
+        fillColor = trackBg.interpolatedWith(juce::Colour(0xFF'41C0FF), 0.08f);
     // fill main chunks (and outline if applicable)
     if (isFirstNodeInGroup) {
         juce::Rectangle<float> curvedBounds =
@@ -1433,7 +1785,7 @@ void track::TrackComponent::paint(juce::Graphics &g) {
         getInterSemiBoldFromThisFunctionBecauseOtherwiseThisWillNotBuildOnWindowsForSomeStupidReason()
             .withHeight(17.f));
     g.drawText(juce::String(displayIndex + 1), 0, 0, UI_TRACK_INDEX_WIDTH,
-               UI_TRACK_HEIGHT, juce::Justification::centred);
+               ctx.trackHeight, juce::Justification::centred);
 
     // this isn't scalable. if you move buttons in resized() they
     // should be able to automatically reflect over here, but that isn't the
@@ -1444,10 +1796,10 @@ void track::TrackComponent::paint(juce::Graphics &g) {
     // john you big ol' sack of dirt
     if (getCorrespondingTrack()->m || getCorrespondingTrack()->s) {
         int btnSize =
-            UI_TRACK_HEIGHT > UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT ? 24 : 18;
+            ctx.trackHeight > UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT ? 24 : 18;
 
         juce::Rectangle<int> btnBounds = juce::Rectangle<int>(
-            UI_TRACK_WIDTH - 130, (UI_TRACK_HEIGHT / 2) - (btnSize / 2),
+            UI_TRACK_WIDTH - 130, (ctx.trackHeight / 2) - (btnSize / 2),
             btnSize, btnSize);
 
         if (getCorrespondingTrack()->m)
@@ -1461,15 +1813,22 @@ void track::TrackComponent::paint(juce::Graphics &g) {
         btnBounds.expand(1, 1);
         g.drawRect(btnBounds);
     }
+
+    if (getCorrespondingTrack()->recordArmed) {
+        g.setColour(juce::Colour(0xFF'E0473D)); // red
+        g.drawRect(armBtn.getBounds().expanded(1, 1));
+    }
 }
 
 void track::TrackComponent::resized() {
+    engineContext &ctx = getContext(processor);
+
     int xOffset = (route.size() - 1) * UI_TRACK_DEPTH_INCREMENTS;
     juce::Rectangle<int> trackNameLabelBounds = juce::Rectangle<int>(
         UI_TRACK_INDEX_WIDTH + getLocalBounds().getX() + 5 + xOffset,
-        (UI_TRACK_HEIGHT / 4) - 4, 100, 20);
+        (ctx.trackHeight / 4) - 4, 100, 20);
 
-    if (UI_TRACK_HEIGHT <= UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT + 10) {
+    if (ctx.trackHeight <= UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT + 10) {
         trackNameLabel.setFont(
             getAudioNodeLabelFont().withHeight(16.f).withExtraKerningFactor(
                 -0.02f));
@@ -1482,23 +1841,28 @@ void track::TrackComponent::resized() {
     trackNameLabel.setBounds(trackNameLabelBounds);
 
     int btnSize =
-        UI_TRACK_HEIGHT > UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT ? 24 : 18;
+        ctx.trackHeight > UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT ? 24 : 18;
     int btnHeight = btnSize;
     int btnWidth = btnSize;
 
     juce::Rectangle<int> btnBounds = juce::Rectangle<int>(
-        UI_TRACK_WIDTH - 130, (UI_TRACK_HEIGHT / 2) - (btnHeight / 2), btnWidth,
+        UI_TRACK_WIDTH - 130, (ctx.trackHeight / 2) - (btnHeight / 2), btnWidth,
         btnHeight);
 
     muteBtn.setBounds(btnBounds);
 
+    // groups and returns can't record
+    armBtn.setVisible(getCorrespondingTrack()->isTrack &&
+                      !getCorrespondingTrack()->isReturn);
+    armBtn.setBounds(btnBounds.withX(btnBounds.getX() - btnSize - 5));
+
     btnBounds.setX(btnBounds.getX() + btnSize + 5);
 
     soloBtn.setBounds(btnBounds);
 
     // set pan slider bounds
     float panSliderSizeMultiplier =
-        UI_TRACK_HEIGHT > UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT ? 1.8f : 1.9f;
+        ctx.trackHeight > UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT ? 1.8f : 1.9f;
 
     juce::Rectangle<int> panSliderBounds = juce::Rectangle<int>(
         btnBounds.getX() + 20, btnBounds.getY() - 8,
@@ -1510,7 +1874,7 @@ void track::TrackComponent::resized() {
         panSliderBounds.getX() + 38, btnBounds.getY(), btnSize * 1.2f, btnSize);
     fxBtn.setBounds(fxBounds);
 
-    if (UI_TRACK_HEIGHT >= UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT + 10) {
+    if (ctx.trackHeight >= UI_TRACK_HEIGHT_COLLAPSE_BREAKPOINT + 10) {
         gainSlider.setVisible(true);
 
         int sliderHeight = 20;
@@ -1520,13 +1884,15 @@ void track::TrackComponent::resized() {
 
         // if you're nesting ridiclously many tracks, the gain slider overlaps
         // the mute button
-        if (sliderX + sliderWidth > muteBtn.getX() - 4) {
+        int leftmostBtnX =
+            armBtn.isVisible() ? armBtn.getX() : muteBtn.getX();
+        if (sliderX + sliderWidth > leftmostBtnX - 4) {
             sliderWidth -= xOffset / 2;
         }
 
         gainSlider.setBounds(sliderX,
-                             (UI_TRACK_HEIGHT / 2) - (sliderHeight / 2) +
-                                 (int)(UI_TRACK_HEIGHT * .2f) + 2,
+                             (ctx.trackHeight / 2) - (sliderHeight / 2) +
+                                 (int)(ctx.trackHeight * .2f) + 2,
                              sliderWidth, sliderHeight);
     } else {
         gainSlider.setVisible(false);
@@ -1548,30 +1914,53 @@ void track::TrackViewport::scrollBarMoved(juce::ScrollBar *bar,
     }
 }
 
+void track::TrackViewport::visibleAreaChanged(
+    const juce::Rectangle<int> & /*newArea*/) {
+    if (Tracklist *tracklist = (Tracklist *)getViewedComponent())
+        tracklist->updateVisibleTrackComponents();
+}
+
 track::ActionCreateNode::ActionCreateNode(std::vector<int> pRoute,
                                           bool isATrack, void *processor)
     : juce::UndoableAction() {
-    this->parentRoute = pRoute;
+    audioNode *parent = utility::getNodeFromRoute(pRoute, processor);
+    this->parentID = parent == nullptr ? -1 : parent->id;
     this->isTrack = isATrack;
     this->p = processor;
 }
 track::ActionCreateNode::~ActionCreateNode() {}
 bool track::ActionCreateNode::perform() {
+    TRACE_SCOPE("ActionCreateNode::perform");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
 
-    audioNode *parent = track::utility::getNodeFromRoute(parentRoute, p);
-    audioNode *x = nullptr;
-    if (parent == nullptr) {
-        x = &processor->tracks.emplace_back();
-    } else {
-        x = &parent->childNodes.emplace_back();
+    audioNode x;
+    x.isTrack = isTrack;
+    x.processor = p;
+
+    x.trackName = isTrack ? "Track" : "Group";
+
+    if (isReturn) {
+        jassert(parentID == -1 && isTrack);
+
+        if (returnID == -1)
+            returnID = processor->getNextReturnID();
+
+        x.isReturn = true;
+        x.returnID = returnID;
+        x.trackName = "Return";
     }
 
-    x->isTrack = isTrack;
-    x->processor = p;
+    // counting the new one
+    x.trackName +=
+        " " + juce::String(utility::getFlattenedNodes(p).size() + 1);
+
+    // same id on redo
+    x.id = nodeID;
+    nodeID = processor->insertNode(parentID, -1, std::move(x)).id;
 
-    x->trackName = isTrack ? "Track" : "Group";
-    x->trackName += " " + juce::String(utility::getFlattenedNodes(p).size());
+    if (isReturn)
+        processor->updateLatency();
 
     updateGUI();
     processor->requireSaving();
@@ -1580,15 +1969,13 @@ bool track::ActionCreateNode::perform() {
 }
 
 bool track::ActionCreateNode::undo() {
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    TRACE_SCOPE("ActionCreateNode::undo");
 
-    audioNode *parent = track::utility::getNodeFromRoute(parentRoute, p);
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    processor->removeNode(nodeID);
 
-    if (parent == nullptr) {
-        processor->tracks.pop_back();
-    } else {
-        parent->childNodes.pop_back();
-    }
+    if (isReturn)
+        processor->updateLatency();
 
     updateGUI();
     processor->requireSaving();
@@ -1602,49 +1989,84 @@ void track::ActionCreateNode::updateGUI() {
     processor->dispatchGUIInstruction(UI_INSTRUCTION_UPDATE_CORE_SCROLLS);
 }
 
+track::ActionModifySends::ActionModifySends(std::vector<int> nodeRoute,
+                                            std::vector<send> newState,
+                                            void *processor)
+    : juce::UndoableAction() {
+    this->newSends = newState;
+    this->p = processor;
+
+    audioNode *node = utility::getNodeFromRoute(nodeRoute, p);
+    this->nodeID = node->id;
+    this->oldSends = node->sends;
+}
+track::ActionModifySends::~ActionModifySends() {}
+
+bool track::ActionModifySends::perform() {
+    TRACE_SCOPE("ActionModifySends::perform");
+
+    apply(newSends);
+    return true;
+}
+
+bool track::ActionModifySends::undo() {
+    TRACE_SCOPE("ActionModifySends::undo");
+
+    apply(oldSends);
+    return true;
+}
+
+void track::ActionModifySends::apply(std::vector<send> &state) {
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
+
+    {
+        const juce::ScopedLock sl(processor->getCallbackLock());
+        node->sends = state;
+    }
+
+    // the schedule and the compensation delays depend on every send
+    processor->updateLatency();
+
+    updateGUI();
+    processor->requireSaving();
+}
+
+void track::ActionModifySends::updateGUI() {
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    processor->dispatchGUIInstruction(
+        UI_INSTRUCTION_UPDATE_EXISTING_NODE_COMPONENTS);
+}
+
 track::ActionDeleteNode::ActionDeleteNode(std::vector<int> nodeRoute,
                                           void *processor)
     : juce::UndoableAction() {
-    this->route = nodeRoute;
     this->p = processor;
+    this->nodeID = utility::getNodeFromRoute(nodeRoute, p)->id;
 }
 track::ActionDeleteNode::~ActionDeleteNode() {}
 
 bool track::ActionDeleteNode::perform() {
+    TRACE_SCOPE("ActionDeleteNode::perform");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
 
+    std::vector<int> route = processor->getRouteOfNode(nodeID);
+    if (route.empty()) {
+        DBG("refusal to perform() action delete node");
+        return false;
+    }
+
     // close subwindows relevant to this node
     processor->dispatchGUIInstruction(
         UI_INSTRUCTION_CLEAR_SUBWINDOWS_WITH_CONTAINED_ROUTE, nullptr, route);
 
-    if (route.size() == 1) {
-        if ((size_t)route[0] > processor->tracks.size()) {
-            DBG("refusla to perform() action delete node");
-        } else {
-
-            utility::copyNode(&this->nodeCopy,
-                              &processor->tracks[(size_t)route[0]], p);
-            processor->tracks.erase(processor->tracks.begin() + route[0]);
-        }
-
-    } else {
-        audioNode *head = &processor->tracks[(size_t)route[0]];
-        for (size_t i = 1; i < route.size() - 1; ++i) {
-            head = &head->childNodes[(size_t)route[i]];
-        }
-
-        if ((size_t)route.back() + 1 > head->childNodes.size()) {
-            DBG("refusl to perform() action delete node");
-        } else {
-
-            utility::copyNode(
-                &this->nodeCopy,
-                &head->childNodes[(size_t)route[route.size() - 1]], p);
+    parentID = processor->getParentID(nodeID);
+    index = route.back();
+    deletedNode = processor->removeNode(nodeID);
 
-            head->childNodes.erase(head->childNodes.begin() +
-                                   route[route.size() - 1]);
-        }
-    }
+    // returns/sends might be gone
+    processor->updateLatencyAfterDelay();
 
     updateGUI();
     processor->requireSaving();
@@ -1653,18 +2075,12 @@ bool track::ActionDeleteNode::perform() {
 }
 
 bool track::ActionDeleteNode::undo() {
+    TRACE_SCOPE("ActionDeleteNode::undo");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
-    if (route.size() == 1) {
-        processor->tracks.insert(processor->tracks.begin() + route[0],
-                                 std::move(nodeCopy));
-    } else {
-        std::vector<int> parentRoute = route;
-        parentRoute.resize(route.size() - 1);
+    processor->insertNode(parentID, index, std::move(deletedNode));
 
-        audioNode *parent = utility::getNodeFromRoute(parentRoute, processor);
-        parent->childNodes.insert(parent->childNodes.begin() + route.back(),
-                                  std::move(nodeCopy));
-    }
+    processor->updateLatencyAfterDelay();
 
     updateGUI();
     processor->requireSaving();
@@ -1680,42 +2096,53 @@ void track::ActionDeleteNode::updateGUI() {
 track::ActionPasteNode::ActionPasteNode(std::vector<int> pRoute,
                                         track::audioNode *node, void *processor)
     : juce::UndoableAction() {
-    this->parentRoute = pRoute;
     this->p = processor;
 
+    audioNode *parent = utility::getNodeFromRoute(pRoute, p);
+    this->parentID = parent == nullptr ? -1 : parent->id;
+
+    // a pasted node is a new node, so it (and everything in it) gets new ids
+    // on the first perform()
     this->nodeToPaste = new audioNode;
     utility::copyNode(this->nodeToPaste, node, p);
+    utility::resetNodeIDs(this->nodeToPaste);
+
+    // a pasted return is a new return; inside a group it's just a track
+    if (nodeToPaste->isReturn) {
+        AudioPluginAudioProcessor *pr = (AudioPluginAudioProcessor *)p;
+        nodeToPaste->isReturn = parent == nullptr;
+        nodeToPaste->returnID =
+            nodeToPaste->isReturn ? pr->getNextReturnID() : -1;
+    }
 }
 track::ActionPasteNode::~ActionPasteNode() { delete this->nodeToPaste; }
 bool track::ActionPasteNode::perform() {
-    audioNode *parentNode = utility::getNodeFromRoute(parentRoute, p);
+    TRACE_SCOPE("ActionPasteNode::perform");
 
-    if (parentNode != nullptr) {
-        pastedNodeRoute = parentRoute;
-        pastedNodeRoute.push_back(parentNode->childNodes.size());
-        audioNode &pastedNode = parentNode->childNodes.emplace_back();
-        utility::copyNode(&pastedNode, nodeToPaste, p);
-    } else {
-        AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
-        pastedNodeRoute.clear();
-        pastedNodeRoute.push_back(processor->tracks.size());
-        audioNode &pastedNode = processor->tracks.emplace_back();
-        utility::copyNode(&pastedNode, nodeToPaste, p);
-    }
+    AudioPluginAudioProcessor *pr = (AudioPluginAudioProcessor *)p;
+    audioNode &pasted =
+        pr->insertNode(parentID, -1, std::move(*this->nodeToPaste));
+    pastedNodeID = pasted.id;
+
+    if (pasted.isReturn)
+        pr->updateLatency();
 
     updateGUI();
 
-    AudioPluginAudioProcessor *pr = (AudioPluginAudioProcessor *)p;
     pr->requireSaving();
 
     return true;
 }
 bool track::ActionPasteNode::undo() {
-    utility::deleteNode(pastedNodeRoute, p);
-
-    updateGUI();
+    TRACE_SCOPE("ActionPasteNode::undo");
 
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    *this->nodeToPaste = processor->removeNode(pastedNodeID);
+
+    if (nodeToPaste->isReturn)
+        processor->updateLatency();
+
+    updateGUI();
     processor->requireSaving();
 
     return true;
@@ -1730,34 +2157,38 @@ track::ActionModifyTrivialNodeData::ActionModifyTrivialNodeData(
     TrivialNodeData newData, void *processor)
     : juce::UndoableAction() {
 
-    this->route = nodeRoute;
     this->p = processor;
+    this->nodeID = utility::getNodeFromRoute(nodeRoute, p)->id;
     this->oldState = oldData;
     this->newState = newData;
 }
 track::ActionModifyTrivialNodeData::~ActionModifyTrivialNodeData() {}
 
 bool track::ActionModifyTrivialNodeData::perform() {
-    audioNode *node = utility::getNodeFromRoute(route, p);
+    TRACE_SCOPE("ActionModifyTrivialNodeData::perform");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
 
     utility::writeTrivialNodeDataToNode(node, newState);
 
     updateGUI();
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->requireSaving();
 
     return true;
 }
 
 bool track::ActionModifyTrivialNodeData::undo() {
-    audioNode *node = utility::getNodeFromRoute(route, p);
+    TRACE_SCOPE("ActionModifyTrivialNodeData::undo");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    audioNode *node = processor->getNodeByID(nodeID);
 
     utility::writeTrivialNodeDataToNode(node, oldState);
 
     updateGUI();
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->requireSaving();
 
     return true;
@@ -1768,21 +2199,27 @@ void track::ActionModifyTrivialNodeData::updateGUI() {
     processor->dispatchGUIInstruction(
         UI_INSTRUCTION_UPDATE_EXISTING_NODE_COMPONENTS);
     processor->dispatchGUIInstruction(UI_INSTRUCTION_NODE_NAME_CHANGE, nullptr,
-                                      route);
+                                      processor->getRouteOfNode(nodeID));
 }
 
 track::ActionMoveNodeToGroup::ActionMoveNodeToGroup(std::vector<int> toMove,
                                                     std::vector<int> group,
                                                     void *processor) {
-    this->nodeToMoveRoute = toMove;
-    this->groupRoute = group;
     this->p = processor;
+    this->nodeID = utility::getNodeFromRoute(toMove, p)->id;
+    this->groupID = utility::getNodeFromRoute(group, p)->id;
 }
 track::ActionMoveNodeToGroup::~ActionMoveNodeToGroup() {}
 
 // future john here; man i was LOCKED IN WHEN WRITING THIS SHIT
 bool track::ActionMoveNodeToGroup::perform() {
-    bool valid = true;
+    TRACE_SCOPE("ActionMoveNodeToGroup::perform");
+
+    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+    std::vector<int> nodeToMoveRoute = processor->getRouteOfNode(nodeID);
+    std::vector<int> groupRoute = processor->getRouteOfNode(groupID);
+
+    bool valid = !nodeToMoveRoute.empty() && !groupRoute.empty();
 
     if (nodeToMoveRoute == groupRoute) {
         valid = false;
@@ -1799,37 +2236,16 @@ bool track::ActionMoveNodeToGroup::perform() {
     if (!valid)
         return false;
 
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(UI_INSTRUCTION_CLEAR_SUBWINDOWS);
 
-    // stain nodes
-    audioNode *group = utility::getNodeFromRoute(groupRoute, p);
-    group->stain = STAIN_MOVENODETOGROUP_GROUP;
+    oldParentID = processor->getParentID(nodeID);
+    oldIndex = nodeToMoveRoute.back();
 
-    audioNode *nodeToMove = utility::getNodeFromRoute(nodeToMoveRoute, p);
-    nodeToMove->stain = STAIN_MOVENODETOGROUP_NODE;
+    // moved, not copied, so it keeps its ids and plugin instances
+    processor->moveNode(nodeID, groupID, -1);
 
-    // copy to temp node
-    audioNode *temp = new audioNode;
-    utility::copyNode(temp, nodeToMove, p);
-
-    // now delete the "original" node that we will move
-    utility::deleteNode(nodeToMoveRoute, p);
-
-    // state mutated; re-get group by using its stain and add "temp" to that
-    groupRouteAfterMoving = getStainedRoute(STAIN_MOVENODETOGROUP_GROUP);
-
-    DBG("group route after moving is "
-        << utility::prettyVector(groupRouteAfterMoving));
-
-    group = utility::getNodeFromRoute(groupRouteAfterMoving, p);
-    audioNode &newNode = group->childNodes.emplace_back();
-    utility::copyNode(&newNode, temp, p);
-
-    // now we can get route after moving by STAIN_MOVENODETOGROUP_NODE yay!
-    routeAfterMoving = getStainedRoute(STAIN_MOVENODETOGROUP_NODE);
-
-    delete temp;
+    DBG("route after moving is "
+        << utility::prettyVector(processor->getRouteOfNode(nodeID)));
 
     updateGUI();
     processor->requireSaving();
@@ -1838,42 +2254,12 @@ bool track::ActionMoveNodeToGroup::perform() {
 }
 
 bool track::ActionMoveNodeToGroup::undo() {
+    TRACE_SCOPE("ActionMoveNodeToGroup::undo");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(UI_INSTRUCTION_CLEAR_SUBWINDOWS);
 
-    // get the node that we moved and copy it to temp
-    audioNode *movedNode = utility::getNodeFromRoute(routeAfterMoving, p);
-
-    audioNode *temp = new audioNode;
-    utility::copyNode(temp, movedNode, p);
-
-    // find the group node and stain it
-    audioNode *group = utility::getNodeFromRoute(groupRouteAfterMoving, p);
-    group->stain = STAIN_MOVENODETOGROUP_GROUP;
-
-    // okay now remove the moved node
-    utility::deleteNode(routeAfterMoving, p);
-
-    group = utility::getNodeFromRoute(
-        getStainedRoute(STAIN_MOVENODETOGROUP_GROUP), p);
-
-    // add a node back to original position
-    audioNode *newNode = nullptr;
-    if (nodeToMoveRoute.size() == 1) {
-        // no parent
-        processor->tracks.emplace(processor->tracks.begin() +
-                                  nodeToMoveRoute.back());
-    } else {
-        // yes parent
-        audioNode *parent = utility::getParentFromRoute(nodeToMoveRoute, p);
-        parent->childNodes.emplace(parent->childNodes.begin() +
-                                   nodeToMoveRoute.back());
-    }
-
-    newNode = utility::getNodeFromRoute(nodeToMoveRoute, p);
-    utility::copyNode(newNode, temp, p);
-
-    delete temp;
+    processor->moveNode(nodeID, oldParentID, oldIndex);
 
     updateGUI();
     processor->requireSaving();
@@ -1891,80 +2277,42 @@ void track::ActionMoveNodeToGroup::updateOnlyTracklist() {
     processor->dispatchGUIInstruction(UI_INSTRUCTION_RECREATE_RELAY_NODES);
 }
 
-std::vector<int> track::ActionMoveNodeToGroup::getStainedRoute(int staincode) {
-    std::vector<int> retval;
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
+track::ActionReorderNode::ActionReorderNode(std::vector<int> route1,
+                                            std::vector<int> route2,
+                                            void *processor) {
+    this->p = processor;
 
-    for (size_t i = 0; i < processor->tracks.size(); ++i) {
-        std::vector<int> tmp;
-        tmp.push_back(i);
+    jassert(utility::isSibling(route1, route2));
+    this->nodeID = utility::getNodeFromRoute(route1, p)->id;
 
-        audioNode *n = &processor->tracks[i];
+    audioNode *parent = utility::getParentFromRoute(route1, p);
+    this->parentID = parent == nullptr ? -1 : parent->id;
 
-        if (n->stain == staincode) {
-            return tmp;
-        }
-
-        auto x = traverseStain(staincode, n, tmp, 0);
-
-        if (x.size() > 1)
-            return x;
-    }
-
-    return retval;
-}
-
-std::vector<int> track::ActionMoveNodeToGroup::traverseStain(
-    int staincode, audioNode *parentNode, std::vector<int> r, int depth = 0) {
-    std::vector<int> retval = r;
-
-    for (size_t i = 0; i < parentNode->childNodes.size(); ++i) {
-        r.push_back(i);
-
-        audioNode *n = &parentNode->childNodes[i];
-        if (n->stain == staincode) {
-            return r;
-        }
-
-        if (!n->isTrack) {
-            auto x = traverseStain(staincode, n, r, depth + 1);
-
-            if (x.size() > r.size())
-                return x;
-        }
-
-        r.pop_back();
-    }
-
-    return retval;
-}
-
-track::ActionReorderNode::ActionReorderNode(std::vector<int> route1,
-                                            std::vector<int> route2,
-                                            void *processor) {
-    this->r1 = route1;
-    this->r2 = route2;
-
-    this->p = processor;
-}
-track::ActionReorderNode::~ActionReorderNode() {}
+    this->srcIndex = route1.back();
+    this->destIndex = route2.back() > srcIndex ? route2.back() - 1
+                                               : route2.back();
+}
+track::ActionReorderNode::~ActionReorderNode() {}
 
 bool track::ActionReorderNode::perform() {
+    TRACE_SCOPE("ActionReorderNode::perform");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(UI_INSTRUCTION_CLEAR_SUBWINDOWS);
 
-    utility::reorderNodeAlt(r1, r2, p);
+    processor->moveNode(nodeID, parentID, destIndex);
     updateGUI();
     processor->requireSaving();
     return true;
 }
 
 bool track::ActionReorderNode::undo() {
+    TRACE_SCOPE("ActionReorderNode::undo");
 
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(UI_INSTRUCTION_CLEAR_SUBWINDOWS);
 
-    utility::reorderNodeAlt(r1, r2, p);
+    processor->moveNode(nodeID, parentID, srcIndex);
     updateGUI();
     processor->requireSaving();
     return true;
@@ -1977,69 +2325,39 @@ void track::ActionReorderNode::updateGUI() {
 
 track::ActionUngroup::ActionUngroup(std::vector<int> nodeRoute,
                                     void *processor) {
-    this->route = nodeRoute;
     this->p = processor;
-
-    audioNode *node = utility::getNodeFromRoute(route, p);
-    utility::copyNode(&this->nodeCopy, node, p);
+    this->nodeID = utility::getNodeFromRoute(nodeRoute, p)->id;
 }
 track::ActionUngroup::~ActionUngroup(){};
 
 bool track::ActionUngroup::perform() {
-    audioNode *node = utility::getNodeFromRoute(route, p);
+    TRACE_SCOPE("ActionUngroup::perform");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(UI_INSTRUCTION_CLEAR_SUBWINDOWS);
 
-    if (node->isTrack) {
-        // move this node to grapdparent
-        audioNode *grandparent = nullptr;
-
-        // find grandparent
-        if (route.size() >= 3) {
-            std::vector<int> grandparentRoute = route;
-            grandparentRoute.pop_back();
-            grandparentRoute.pop_back();
-
-            grandparent = utility::getNodeFromRoute(grandparentRoute, p);
-
-            this->trackRouteAfterUngroup = grandparentRoute;
-            this->trackRouteAfterUngroup.push_back(
-                grandparent->childNodes.size());
-
-        } else {
-            grandparent = nullptr;
-            trackRouteAfterUngroup.push_back(processor->tracks.size());
-        }
-
-        // add new node and copy contents over
-        audioNode *newNode = nullptr;
-        if (grandparent == nullptr)
-            newNode = &processor->tracks.emplace_back();
-        else
-            newNode = &grandparent->childNodes.emplace_back();
-
-        utility::copyNode(newNode, &this->nodeCopy, p);
+    std::vector<int> route = processor->getRouteOfNode(nodeID);
+    parentID = processor->getParentID(nodeID);
+    index = route.back();
 
-        utility::deleteNode(route, p);
+    if (processor->getNodeByID(nodeID)->isTrack) {
+        // move this node to its grandparent (or the top level)
+        int grandparentID =
+            parentID == -1 ? -1 : processor->getParentID(parentID);
+        processor->moveNode(nodeID, grandparentID, -1);
     } else {
-        utility::deleteNode(route, p);
-
-        // get parent and add all nodes; loop backward, emplace at route.back()
-        audioNode *parent = utility::getParentFromRoute(route, p);
-        for (int i = nodeCopy.childNodes.size() - 1; i >= 0; --i) {
-            // add node and copy data
-            if (parent == nullptr) {
-                auto &newNode = *processor->tracks.emplace(
-                    processor->tracks.begin() + route.back());
-                utility::copyNode(&newNode,
-                                  &this->nodeCopy.childNodes[(size_t)i], p);
-            } else {
-                auto &newNode = *parent->childNodes.emplace(
-                    parent->childNodes.begin() + route.back());
-                utility::copyNode(&newNode,
-                                  &this->nodeCopy.childNodes[(size_t)i], p);
-            }
+        // the children take the group's place, in the same order
+        AudioPluginAudioProcessor::ScopedTreeEdit edit(*processor);
+        group = processor->removeNode(nodeID);
+        childIDs.clear();
+
+        for (size_t i = 0; i < group.childNodes.size(); ++i) {
+            audioNode &child = processor->insertNode(
+                parentID, index + (int)i, std::move(group.childNodes[i]));
+            childIDs.push_back(child.id);
         }
+
+        group.childNodes.clear();
     }
 
     updateGUI();
@@ -2049,36 +2367,20 @@ bool track::ActionUngroup::perform() {
 }
 
 bool track::ActionUngroup::undo() {
+    TRACE_SCOPE("ActionUngroup::undo");
+
     AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
     processor->dispatchGUIInstruction(UI_INSTRUCTION_CLEAR_SUBWINDOWS);
 
-    audioNode *originalParent = utility::getParentFromRoute(route, p);
-    if (nodeCopy.isTrack) {
-        audioNode &newNode = *originalParent->childNodes.emplace(
-            originalParent->childNodes.begin() + route.back());
-
-        utility::copyNode(&newNode, &this->nodeCopy, p);
-        utility::deleteNode(trackRouteAfterUngroup, p);
+    if (processor->getNodeByID(nodeID) != nullptr) {
+        // a track; it's still in the tree, just somewhere else
+        processor->moveNode(nodeID, parentID, index);
     } else {
-        for (size_t i = 0; i < nodeCopy.childNodes.size(); ++i) {
-            if (originalParent == nullptr) {
-                processor->tracks.erase(processor->tracks.begin() +
-                                        route.back());
-            } else {
-                originalParent->childNodes.erase(
-                    originalParent->childNodes.begin() + route.back());
-            }
-        }
+        AudioPluginAudioProcessor::ScopedTreeEdit edit(*processor);
+        for (int id : childIDs)
+            group.childNodes.push_back(processor->removeNode(id));
 
-        if (originalParent == nullptr) {
-            auto &newNode = *processor->tracks.emplace(
-                processor->tracks.begin() + route.back());
-            utility::copyNode(&newNode, &this->nodeCopy, p);
-        } else {
-            auto &newNode = *originalParent->childNodes.emplace(
-                originalParent->childNodes.begin() + route.back());
-            utility::copyNode(&newNode, &this->nodeCopy, p);
-        }
+        processor->insertNode(parentID, index, std::move(group));
     }
 
     updateGUI();
@@ -2103,8 +2405,8 @@ track::Tracklist::Tracklist() : juce::Component() {
     addAndMakeVisible(unmuteAllBtn);
     unmuteAllBtn.setButtonText("UNMUTE ALL");
     unmuteAllBtn.onClick = [this] {
-        for (auto &tc : trackComponents) {
-            tc->getCorrespondingTrack()->m = false;
+        for (auto *node : utility::getFlattenedNodes(processor)) {
+            node->m = false;
         }
 
         repaint();
@@ -2113,8 +2415,8 @@ track::Tracklist::Tracklist() : juce::Component() {
     addAndMakeVisible(unsoloAllBtn);
     unsoloAllBtn.setButtonText("UNSOLO ALL");
     unsoloAllBtn.onClick = [this] {
-        for (auto &tc : trackComponents) {
-            tc->getCorrespondingTrack()->s = false;
+        for (auto *node : utility::getFlattenedNodes(processor)) {
+            node->s = false;
         }
 
         AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
@@ -2142,6 +2444,16 @@ void track::Tracklist::addNewNode(bool isTrack, std::vector<int> parentRoute) {
     p->undoManager.perform(action);
 }
 
+void track::Tracklist::addNewReturn() {
+    AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)this->processor;
+
+    ActionCreateNode *action =
+        new ActionCreateNode(std::vector<int>(), true, p);
+    action->isReturn = true;
+    p->undoManager.beginNewTransaction("action create return");
+    p->undoManager.perform(action);
+}
+
 bool track::Tracklist::isDescendant(audioNode *parent, audioNode *possibleChild,
                                     bool directDescandant) {
     for (audioNode &child : parent->childNodes) {
@@ -2196,13 +2508,13 @@ void track::Tracklist::deepCopyGroupInsideGroup(audioNode *childNode,
 void track::Tracklist::moveNodeToGroup(track::TrackComponent *caller,
                                        int targetIndex) {
 
-    if (targetIndex < 0 || (size_t)targetIndex > trackComponents.size() - 1 ||
+    if (targetIndex < 0 || targetIndex > getNumRows() - 1 ||
         caller->displayIndex == targetIndex) {
         return;
     }
 
     std::vector<int> toMove = caller->route;
-    std::vector<int> group = trackComponents[(size_t)targetIndex]->route;
+    std::vector<int> group = getRouteAtRow(targetIndex);
 
     audioNode *nodeToMove = utility::getNodeFromRoute(toMove, processor);
     audioNode *groupToUse = utility::getNodeFromRoute(group, processor);
@@ -2210,6 +2522,10 @@ void track::Tracklist::moveNodeToGroup(track::TrackComponent *caller,
         return;
     }
 
+    // returns only get processed from the top level
+    if (nodeToMove->isReturn)
+        return;
+
     ActionMoveNodeToGroup *action =
         new ActionMoveNodeToGroup(toMove, group, processor);
 
@@ -2224,10 +2540,11 @@ void track::Tracklist::mouseDown(const juce::MouseEvent &event) {
         contextMenu.setLookAndFeel(&getLookAndFeel());
 
         contextMenu.addItem(
-            "Paste", clipboard::typecode == TYPECODE_NODE, false, [this] {
+            "Paste", getClipboard(processor).typecode == TYPECODE_NODE, false,
+            [this] {
                 ActionPasteNode *action = new ActionPasteNode(
-                    std::vector<int>(), (audioNode *)clipboard::data,
-                    processor);
+                    std::vector<int>(),
+                    (audioNode *)getClipboard(processor).data, processor);
 
                 AudioPluginAudioProcessor *p =
                     (AudioPluginAudioProcessor *)processor;
@@ -2238,6 +2555,7 @@ void track::Tracklist::mouseDown(const juce::MouseEvent &event) {
         contextMenu.addItem("Add new track", [this] { this->addNewNode(); });
         contextMenu.addItem("Add new group",
                             [this] { this->addNewNode(false); });
+        contextMenu.addItem("Add new return", [this] { addNewReturn(); });
 
         contextMenu.showMenuAsync(juce::PopupMenu::Options());
     }
@@ -2246,72 +2564,169 @@ void track::Tracklist::mouseDown(const juce::MouseEvent &event) {
         ->grabKeyboardFocus(); // just rid any track components of focus
 }
 
-int track::Tracklist::findChildren(audioNode *parentNode,
-                                   std::vector<int> route, int foundItems,
-                                   int depth) {
+void track::Tracklist::findChildren(audioNode *parentNode,
+                                    std::vector<int> route) {
     for (size_t i = 0; i < parentNode->childNodes.size(); ++i) {
-        juce::String tabs;
-        for (int x = 0; x < depth; ++x) {
-            tabs.append("    ", 4);
-        }
-
         audioNode *childNode = &parentNode->childNodes[i];
 
         route.push_back(i);
+        rows.push_back({route, (int)i});
 
-        this->trackComponents.push_back(std::make_unique<TrackComponent>(i));
-        trackComponents.back().get()->processor = processor;
-        trackComponents.back().get()->route = route;
-        trackComponents.back().get()->initializSliders();
-        trackComponents.back().get()->trackNameLabel.setText(
-            childNode->trackName, juce::NotificationType::dontSendNotification);
+        if (!childNode->isTrack)
+            findChildren(childNode, route);
 
-        addAndMakeVisible(*trackComponents.back());
+        route.pop_back();
+    }
+}
 
-        if (!childNode->isTrack) {
-            foundItems = findChildren(childNode, route, foundItems, depth + 1);
-        } else {
-        }
+void track::Tracklist::updateRows() {
+    AudioPluginAudioProcessor *p =
+        (AudioPluginAudioProcessor *)(this->processor);
 
-        ++foundItems;
-        route.pop_back();
+    rows.clear();
+
+    for (size_t i = 0; i < p->tracks.size(); ++i) {
+        std::vector<int> route = {(int)i};
+        rows.push_back({route, (int)i});
+        findChildren(&p->tracks[i], route);
     }
+}
 
-    return foundItems;
+std::vector<int> track::Tracklist::getRouteAtRow(int row) {
+    jassert(row >= 0 && row < getNumRows());
+    return rows[(size_t)row].route;
 }
 
-void track::Tracklist::setDisplayIndexes() {
-    for (size_t i = 0; i < this->trackComponents.size(); ++i) {
-        this->trackComponents[i]->displayIndex = i;
-    }
+track::audioNode *track::Tracklist::getNodeAtRow(int row) {
+    jassert(row >= 0 && row < getNumRows());
+    return utility::getNodeFromRoute(rows[(size_t)row].route, processor);
 }
 
-void track::Tracklist::createTrackComponents() {
-    AudioPluginAudioProcessor *p =
-        (AudioPluginAudioProcessor *)(this->processor);
+void track::Tracklist::assignRow(TrackComponent *tc, int row) {
+    engineContext &ctx = getContext(processor);
 
-    int j = 0;
-    int foundItems = 0;
-    for (audioNode &t : p->tracks) {
-        std::vector<int> route;
-        route.push_back(j);
+    tc->route = rows[(size_t)row].route;
+    tc->siblingIndex = rows[(size_t)row].siblingIndex;
+    tc->displayIndex = row;
+    tc->coolColors = false;
+
+    tc->initializSliders();
+    tc->trackNameLabel.setText(tc->getCorrespondingTrack()->trackName,
+                               juce::NotificationType::dontSendNotification);
+
+    tc->setBounds(0, UI_TRACK_VERTICAL_OFFSET + (ctx.trackHeight * row),
+                  UI_TRACK_WIDTH, ctx.trackHeight);
+    tc->resized();
+    tc->setVisible(true);
+    tc->repaint();
+}
+
+void track::Tracklist::updateVisibleTrackComponents() {
+    engineContext &ctx = getContext(processor);
 
-        this->trackComponents.push_back(std::make_unique<TrackComponent>(j));
-        trackComponents.back().get()->processor = processor;
-        trackComponents.back().get()->route = route;
-        trackComponents.back().get()->initializSliders();
-        trackComponents.back().get()->trackNameLabel.setText(
-            t.trackName, juce::NotificationType::dontSendNotification);
-        addAndMakeVisible(*trackComponents.back());
+    int numRows = getNumRows();
 
-        foundItems = findChildren(&t, route, foundItems, 1);
+    // without a viewport yet, just do the first screenful
+    int first = 0;
+    int last = juce::jmin(numRows, 32) - 1;
 
-        trackComponents.back().get()->displayIndex = foundItems;
+    if (auto *viewport = findParentComponentOfClass<juce::Viewport>()) {
+        juce::Rectangle<int> area = viewport->getViewArea();
 
-        j++;
+        first = (area.getY() - UI_TRACK_VERTICAL_OFFSET) / ctx.trackHeight -
+                virtualizationMarginRows;
+        last = (area.getBottom() - UI_TRACK_VERTICAL_OFFSET) / ctx.trackHeight +
+               virtualizationMarginRows;
     }
 
-    setDisplayIndexes();
+    first = juce::jmax(0, first);
+    last = juce::jmin(numRows - 1, last);
+
+    std::vector<std::unique_ptr<TrackComponent>> old;
+    old.swap(trackComponents);
+
+    auto stillMatches = [this, numRows](TrackComponent *tc) {
+        return tc->displayIndex >= 0 && tc->displayIndex < numRows &&
+               rows[(size_t)tc->displayIndex].route == tc->route;
+    };
+
+    // components that are being edited keep their row even when scrolled
+    // away, as long as that row still points at the same node
+    for (auto &tc : old) {
+        if (tc != nullptr && tc->isPinned() && stillMatches(tc.get()) &&
+            (tc->displayIndex < first || tc->displayIndex > last)) {
+            assignRow(tc.get(), tc->displayIndex);
+            trackComponents.push_back(std::move(tc));
+        }
+    }
+
+    for (int row = first; row <= last; ++row) {
+        std::unique_ptr<TrackComponent> tc;
+
+        // prefer whatever was showing this row already so focus survives
+        for (auto &candidate : old) {
+            if (candidate != nullptr && candidate->displayIndex == row &&
+                stillMatches(candidate.get())) {
+                tc = std::move(candidate);
+                break;
+            }
+        }
+
+        if (tc == nullptr) {
+            for (auto &candidate : old) {
+                if (candidate != nullptr && !candidate->isPinned()) {
+                    tc = std::move(candidate);
+                    break;
+                }
+            }
+        }
+
+        if (tc == nullptr && spareTrackComponents.size() > 0) {
+            tc = std::move(spareTrackComponents.back());
+            spareTrackComponents.pop_back();
+        }
+
+        if (tc == nullptr) {
+            tc = std::make_unique<TrackComponent>(
+                rows[(size_t)row].siblingIndex);
+            tc->processor = processor;
+            addChildComponent(*tc);
+        }
+
+        assignRow(tc.get(), row);
+        trackComponents.push_back(std::move(tc));
+    }
+
+    for (auto &tc : old) {
+        if (tc == nullptr)
+            continue;
+
+        tc->setVisible(false);
+        tc->displayIndex = -1;
+        spareTrackComponents.push_back(std::move(tc));
+    }
+
+    insertIndicator.toFront(false);
+}
+
+void track::Tracklist::rebindTrackComponents() {
+    updateRows();
+
+    int numRows = getNumRows();
+
+    for (auto &tc : trackComponents) {
+        if (tc->displayIndex >= 0 && tc->displayIndex < numRows &&
+            rows[(size_t)tc->displayIndex].route == tc->route)
+            continue;
+
+        tc->setVisible(false);
+        tc->displayIndex = -1;
+    }
+}
+
+void track::Tracklist::createTrackComponents() {
+    // components are recycled, so this only has to redo the rows
+    updateRows();
     setTrackComponentBounds();
     repaint();
 
@@ -2329,22 +2744,8 @@ void track::Tracklist::updateExistingTrackComponents() {
     }
 }
 
-void track::Tracklist::clearStains() {
-    for (auto &x : trackComponents) {
-        x->getCorrespondingTrack()->stain = -1;
-    }
-}
-
 void track::Tracklist::setTrackComponentBounds() {
-    int counter = 0;
-    for (auto &tc : trackComponents) {
-        tc->setBounds(0, UI_TRACK_VERTICAL_OFFSET + (UI_TRACK_HEIGHT * counter),
-                      UI_TRACK_WIDTH, UI_TRACK_HEIGHT);
-
-        counter++;
-        tc->resized();
-        tc->repaint();
-    }
+    engineContext &ctx = getContext(processor);
 
     int btnWidth = 70;
     int btnMargin = 4;
@@ -2358,11 +2759,13 @@ void track::Tracklist::setTrackComponentBounds() {
                            UI_TRACK_VERTICAL_OFFSET);
 
     if (getParentComponent()) {
-        int newTracklistHeight = juce::jmax((counter + 2) * UI_TRACK_HEIGHT,
-                                            getParentComponent()->getHeight());
+        int newTracklistHeight =
+            juce::jmax((getNumRows() + 2) * ctx.trackHeight,
+                       getParentComponent()->getHeight());
         this->setSize(getWidth(), newTracklistHeight);
     }
 
+    updateVisibleTrackComponents();
     repaint();
 
     if (getParentComponent())
@@ -2374,7 +2777,9 @@ void track::Tracklist::updateInsertIndicator(int index) {
         this->insertIndicator.setVisible(true);
         this->insertIndicator.toFront(false);
         this->insertIndicator.setBounds(
-            0, (UI_TRACK_HEIGHT * index) + UI_TRACK_VERTICAL_OFFSET,
+            0,
+            (getContext(processor).trackHeight * index) +
+                UI_TRACK_VERTICAL_OFFSET,
             UI_TRACK_WIDTH, 1);
         repaint();
         return;
@@ -2384,6 +2789,8 @@ void track::Tracklist::updateInsertIndicator(int index) {
 }
 
 void track::subplugin::relayParamsToPlugin() {
+    TRACE_SCOPE("subplugin::relayParamsToPlugin");
+
     for (size_t i = 0; i < relayParams.size(); ++i) {
         relayParam *rp = &this->relayParams[i];
 
@@ -2412,38 +2819,269 @@ void track::subplugin::relayParamsToPlugin() {
     }
 }
 
-void track::subplugin::process(juce::AudioBuffer<float> &buffer) {
-    juce::MidiBuffer mb;
+namespace {
+template <typename SampleType>
+void allocateBuffers(track::subplugin::processBuffers<SampleType> &buffers,
+                     int numChannels, int blockSize, int fifoSize) {
+    buffers.dry.setSize(2, blockSize, false, true, false);
+    buffers.fifoIn.setSize(numChannels, fifoSize, false, true, false);
+    buffers.fifoOut.setSize(numChannels, fifoSize, false, true, false);
+    buffers.fifoIn.clear();
+    buffers.fifoOut.clear();
+}
+
+// the plugin's current layout, with its main buses switched to numChannels
+juce::AudioProcessor::BusesLayout getMainBusLayout(juce::AudioProcessor &plugin,
+                                                   int numChannels) {
+    juce::AudioChannelSet set = numChannels == 1
+                                    ? juce::AudioChannelSet::mono()
+                                    : juce::AudioChannelSet::stereo();
+
+    juce::AudioProcessor::BusesLayout layout = plugin.getBusesLayout();
+    if (!layout.inputBuses.isEmpty())
+        layout.inputBuses.getReference(0) = set;
+    if (!layout.outputBuses.isEmpty())
+        layout.outputBuses.getReference(0) = set;
+
+    return layout;
+}
+} // namespace
+
+bool track::subplugin::supportsMono() {
+    if (plugin.get() == nullptr)
+        return false;
+
+    return plugin->checkBusesLayoutSupported(getMainBusLayout(*plugin, 1));
+}
 
-    juce::AudioBuffer<float> dryBuffer;
-    dryBuffer.makeCopyOf(buffer);
+void track::subplugin::prepare() {
+    engineContext &ctx = getContext(processor);
 
-    if (this->plugin.get() != nullptr) {
-        this->plugin->processBlock(buffer, mb);
+    fixedBlockSize = juce::jmax(0, ctx.fixedPluginBlockSize);
+    int blockSize =
+        fixedBlockSize > 0 ? fixedBlockSize
+                           : juce::jmax(1, ctx.samplesPerBlock);
 
-        float dryMix = 1.f - dryWetMix;
-        float wetMix = dryWetMix;
+    if (plugin.get() != nullptr) {
+        juce::AudioProcessor::BusesLayout layout =
+            getMainBusLayout(*plugin, numChannels);
 
-        for (int ch = 0; ch < buffer.getNumChannels(); ++ch) {
-            auto *dry = dryBuffer.getReadPointer(ch);
-            auto *wet = buffer.getReadPointer(ch);
-            auto *out = buffer.getWritePointer(ch);
+        if (layout != plugin->getBusesLayout()) {
+            plugin->releaseResources();
 
-            for (int i = 0; i < buffer.getNumSamples(); ++i) {
-                out[i] = dry[i] * dryMix + wet[i] * wetMix;
+            if (!plugin->setBusesLayout(layout)) {
+                DBG("couldn't give " << plugin->getName() << " "
+                                     << numChannels << " channels");
+                numChannels = 2;
+                plugin->setBusesLayout(getMainBusLayout(*plugin, 2));
             }
         }
+
+        // double wherever the plugin can take it; the rest get converted
+        juce::AudioProcessor::ProcessingPrecision precision =
+            ctx.doublePrecision && plugin->supportsDoublePrecisionProcessing()
+                ? juce::AudioProcessor::doublePrecision
+                : juce::AudioProcessor::singlePrecision;
+
+        if (precision != plugin->getProcessingPrecision()) {
+            plugin->releaseResources();
+            plugin->setProcessingPrecision(precision);
+        }
+
+        processesDouble = precision == juce::AudioProcessor::doublePrecision;
+
+        plugin->setRateAndBufferSizeDetails(ctx.sampleRate, blockSize);
+        plugin->prepareToPlay(ctx.sampleRate, blockSize);
+    }
+
+    midi.ensureSize(2048);
+
+    fifoPosition = 0;
+    int fifoSize = juce::jmax(1, fixedBlockSize);
+
+    if (ctx.doublePrecision) {
+        allocateBuffers(doubleBuffers, numChannels, blockSize, fifoSize);
+        floatBuffers = {};
+    } else {
+        allocateBuffers(floatBuffers, numChannels, blockSize, fifoSize);
+        doubleBuffers = {};
+    }
+
+    bool converting = ctx.doublePrecision && !processesDouble;
+    conversion.setSize(converting ? 2 : 0, converting ? blockSize : 0, false,
+                       true, false);
+}
+
+int track::subplugin::getLatencySamples() {
+    if (plugin.get() == nullptr)
+        return 0;
+
+    return plugin->getLatencySamples() + fixedBlockSize;
+}
+
+template <typename SampleType>
+void track::subplugin::process(juce::AudioBuffer<SampleType> &buffer) {
+    TRACE_SCOPE("subplugin::process");
+
+    if (this->plugin.get() == nullptr)
+        return;
+
+    if (fixedBlockSize <= 0) {
+        processDirect(buffer);
+        return;
+    }
+
+    // the plugin only runs once a whole block has come in. meanwhile buffer
+    // gets what it put out last time, which is where the latency comes from
+    juce::AudioBuffer<SampleType> &fifoIn = getBuffers<SampleType>().fifoIn;
+    juce::AudioBuffer<SampleType> &fifoOut = getBuffers<SampleType>().fifoOut;
+    int numSamples = buffer.getNumSamples();
+    int numChannels =
+        juce::jmin(buffer.getNumChannels(), fifoIn.getNumChannels());
+    int done = 0;
+
+    while (done < numSamples) {
+        int n = juce::jmin(numSamples - done, fixedBlockSize - fifoPosition);
+
+        for (int ch = 0; ch < numChannels; ++ch) {
+            fifoIn.copyFrom(ch, fifoPosition, buffer, ch, done, n);
+            buffer.copyFrom(ch, done, fifoOut, ch, fifoPosition, n);
+        }
+
+        done += n;
+        fifoPosition += n;
+
+        if (fifoPosition == fixedBlockSize) {
+            processDirect(fifoIn);
+
+            for (int ch = 0; ch < numChannels; ++ch)
+                fifoOut.copyFrom(ch, 0, fifoIn, ch, 0, fixedBlockSize);
+
+            fifoPosition = 0;
+        }
     }
 }
 
+template <typename SampleType>
+void track::subplugin::processDirect(juce::AudioBuffer<SampleType> &buffer) {
+    juce::AudioBuffer<SampleType> &dryBuffer = getBuffers<SampleType>().dry;
+
+    // ramped like audioNode's gain
+    float startMix = rampedDryWetMix < 0.f ? dryWetMix : rampedDryWetMix;
+    float endMix = dryWetMix;
+    rampedDryWetMix = endMix;
+
+    // fully wet is the usual case; no need to keep the dry signal then
+    bool mixing = startMix < 1.f || endMix < 1.f;
+    if (mixing)
+        dryBuffer.makeCopyOf(buffer, true);
+
+    midi.clear();
+
+    engineContext &ctx = getContext(processor);
+    bool watched = ctx.pluginWatchdogBlocks > 0 && ctx.sampleRate > 0;
+    juce::int64 start = watched ? juce::Time::getHighResolutionTicks() : 0;
+    double budget = watched ? buffer.getNumSamples() / ctx.sampleRate : 0.0;
+
+    // a single call that takes as long as the whole run of late blocks would
+    // is caught by PluginWatchdog while it's still going
+    if (watched) {
+        deadline.store(start + juce::Time::secondsToHighResolutionTicks(
+                                   budget * ctx.pluginWatchdogBlocks),
+                       std::memory_order_release);
+    }
+
+    // only c++ exceptions end up here. a plugin that crashes takes the host
+    // with it; that could only be contained by running it in another process
+    try {
+        processBlock(buffer);
+    } catch (...) {
+        DBG("plugin threw from processBlock()");
+        deadline.store(0, std::memory_order_release);
+        buffer.clear();
+        markFaulted();
+        return;
+    }
+
+    deadline.store(0, std::memory_order_release);
+
+    // the watchdog gave up on it while it was in there. it leaves overruns
+    // alone, since that's only ever touched from here
+    if (faulted) {
+        overruns = 0;
+        buffer.clear();
+        return;
+    }
+
+    if (watched) {
+        double elapsed = juce::Time::highResolutionTicksToSeconds(
+            juce::Time::getHighResolutionTicks() - start);
+
+        overruns = elapsed > budget ? overruns + 1 : 0;
+        if (overruns >= ctx.pluginWatchdogBlocks)
+            markFaulted();
+    }
+
+    if (!mixing)
+        return;
+
+    int numSamples = buffer.getNumSamples();
+    float increment = (endMix - startMix) / (float)juce::jmax(1, numSamples);
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch) {
+        auto *dry = dryBuffer.getReadPointer(ch);
+        auto *wet = buffer.getReadPointer(ch);
+        auto *out = buffer.getWritePointer(ch);
+
+        for (int i = 0; i < numSamples; ++i) {
+            float wetMix = startMix + increment * (float)i;
+            out[i] = dry[i] * (1.f - wetMix) + wet[i] * wetMix;
+        }
+    }
+}
+
+void track::subplugin::processBlock(juce::AudioBuffer<float> &buffer) {
+    plugin->processBlock(buffer, midi);
+}
+
+void track::subplugin::processBlock(juce::AudioBuffer<double> &buffer) {
+    if (processesDouble) {
+        plugin->processBlock(buffer, midi);
+        return;
+    }
+
+    // prepare() sized conversion for this
+    jassert(buffer.getNumSamples() <= conversion.getNumSamples());
+
+    int numChannels =
+        juce::jmin(buffer.getNumChannels(), conversion.getNumChannels());
+    int numSamples =
+        juce::jmin(buffer.getNumSamples(), conversion.getNumSamples());
+    juce::AudioBuffer<float> block(conversion.getArrayOfWritePointers(),
+                                   numChannels, numSamples);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        convertSamples(buffer.getReadPointer(ch), block.getWritePointer(ch),
+                       numSamples);
+
+    plugin->processBlock(block, midi);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+        convertSamples(block.getReadPointer(ch), buffer.getWritePointer(ch),
+                       numSamples);
+}
+
 bool track::subplugin::initializePlugin(juce::String path) {
     juce::OwnedArray<PluginDescription> pluginDescriptions;
     juce::KnownPluginList plist;
     juce::AudioPluginFormatManager apfm;
     juce::String errorMsg;
 
-    if (track::SAMPLE_RATE < 0) {
-        track::SAMPLE_RATE = 44100;
+    jassert(processor != nullptr);
+    engineContext &ctx = getContext(processor);
+
+    if (ctx.sampleRate < 0) {
+        ctx.sampleRate = 44100;
     }
 
     juce::addDefaultFormatsToManager(apfm);
@@ -2458,29 +3096,80 @@ bool track::subplugin::initializePlugin(juce::String path) {
     }
 
     plugin =
-        apfm.createPluginInstance(*pluginDescriptions[0], track::SAMPLE_RATE,
-                                  track::SAMPLES_PER_BLOCK, errorMsg);
+        apfm.createPluginInstance(*pluginDescriptions[0], ctx.sampleRate,
+                                  ctx.samplesPerBlock, errorMsg);
 
     if (plugin.get() == nullptr) {
         DBG("plugin = nullptr: " << path);
         return false;
     }
 
-    plugin->setPlayConfigDetails(2, 2, track::SAMPLE_RATE,
-                                 track::SAMPLES_PER_BLOCK);
-    if (track::SAMPLES_PER_BLOCK <= 0) {
-        track::SAMPLES_PER_BLOCK = 512;
+    if (ctx.samplesPerBlock <= 0) {
+        ctx.samplesPerBlock = 512;
+    }
+
+    prepare();
+
+    return true;
+}
+void track::subplugin::markFaulted() {
+    overruns = 0;
+    faulted = true;
+
+    AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+    p->pluginFaulted = true;
+}
+
+bool track::subplugin::reload() {
+    jassert(plugin.get() != nullptr);
+    AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+
+    // still stuck in processBlock(), with the callback lock held. taking it
+    // (or asking the plugin for its state) would hang the message thread too
+    if (deadline.load(std::memory_order_acquire) != 0) {
+        DBG(plugin->getName() << " hasn't returned yet; not reloading");
+        return false;
+    }
+
+    juce::MemoryBlock state;
+    plugin->getStateInformation(state);
+
+    // build and restore the new instance before the audio thread sees it
+    subplugin fresh;
+    fresh.processor = processor;
+    fresh.numChannels = numChannels;
+    if (!fresh.initializePlugin(
+            plugin->getPluginDescription().fileOrIdentifier)) {
+        DBG("couldn't reload " << plugin->getName());
+        return false;
     }
 
-    plugin->prepareToPlay(track::SAMPLE_RATE, track::SAMPLES_PER_BLOCK);
+    fresh.plugin->setStateInformation(state.getData(), (int)state.getSize());
+
+    {
+        const juce::ScopedLock sl(p->getCallbackLock());
+        std::swap(plugin, fresh.plugin);
+        faulted = false;
+    }
 
+    // the old instance goes away with fresh, outside the lock
+    p->updateLatencyAfterDelay();
     return true;
 }
-track::subplugin::subplugin() : plugin() {}
-track::subplugin::~subplugin() {}
 
-bool track::clip::updateBuffer() {
+track::subplugin::subplugin() : plugin() { PluginWatchdog::watch(this); }
+track::subplugin::~subplugin() { PluginWatchdog::unwatch(this); }
+
+int track::clip::getNewID() {
+    // only has to be unique within the process; it isn't saved
+    static std::atomic<int> nextID{0};
+    return nextID++;
+}
+
+bool track::clip::updateBuffer(double newHostSampleRate,
+                               clipStorage storage) {
     juce::File file(path);
+    source.reset();
 
     if (!file.exists()) {
         buffer.setSize(0, 0);
@@ -2488,38 +3177,119 @@ bool track::clip::updateBuffer() {
         return false;
     }
 
+    // compressed files get decoded into the cache once and read from there
+    // after that, which for mapped clips means they can be mapped too.
+    // packing goes by the original though, since that has the real bit depth
+    juce::String readPath = path;
+    if (diskcache::needsDecoding(path)) {
+        juce::String decoded = diskcache::decodeToCache(path);
+        if (decoded.isNotEmpty())
+            readPath = decoded;
+    }
+
+    if (storage == clipStorage::mapped)
+        source = mappedSource::open(readPath);
+    else if (storage == clipStorage::packed)
+        source = packedSource::load(path);
+
+    if (source != nullptr) {
+        buffer.setSize(0, 0);
+        sampleRate = source->sampleRate;
+        updatePlaybackTable(newHostSampleRate);
+        return true;
+    }
+
     juce::AudioFormatManager afm;
     afm.registerBasicFormats();
 
-    std::unique_ptr<juce::AudioFormatReader> reader(afm.createReaderFor(file));
+    std::unique_ptr<juce::AudioFormatReader> reader(
+        afm.createReaderFor(juce::File(readPath)));
+
+    if (reader == nullptr) {
+        buffer.setSize(0, 0);
+        DBG("updateBuffer() called--couldn't create reader for " << path);
+        return false;
+    }
+
     buffer = juce::AudioBuffer<float>((int)reader->numChannels,
                                       reader->lengthInSamples);
 
     reader->read(&buffer, 0, buffer.getNumSamples(), 0, true, true);
+
+    sampleRate = reader->sampleRate;
+    updatePlaybackTable(newHostSampleRate);
+
     return true;
 }
 
+bool track::clip::needsResampling() {
+    return sampleRate > 0.0 && hostSampleRate > 0.0 &&
+           !juce::approximatelyEqual(sampleRate, hostSampleRate);
+}
+
+void track::clip::updatePlaybackTable(double newHostSampleRate) {
+    hostSampleRate = newHostSampleRate;
+
+    if (needsResampling())
+        playbackTable =
+            resampler::getPlaybackTable(sampleRate, hostSampleRate);
+    else
+        playbackTable.reset();
+}
+
+int track::clip::getNumChannels() {
+    return source != nullptr ? source->numChannels : buffer.getNumChannels();
+}
+
+int track::clip::getSourceNumSamples() {
+    return source != nullptr ? (int)source->lengthInSamples
+                             : buffer.getNumSamples();
+}
+
+int track::clip::getNumSamples() {
+    if (!needsResampling())
+        return getSourceNumSamples();
+
+    return (int)((double)getSourceNumSamples() * hostSampleRate / sampleRate);
+}
+
 bool track::audioNode::addPlugin(juce::String path) {
     jassert(processor != nullptr);
     AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
 
-    plugins.push_back(std::make_unique<subplugin>());
-    bool success = plugins.back()->initializePlugin(path);
+    // loaded before the audio thread can see it
+    auto sp = std::make_unique<subplugin>();
+    sp->processor = processor;
+    sp->numChannels = numChannels;
+    bool success = sp->initializePlugin(path);
 
     if (success) {
-        plugins.back()->processor = processor;
+        {
+            const juce::ScopedLock sl(p->getCallbackLock());
+            plugins.push_back(std::move(sp));
+        }
+
+        updateChannels();
         p->updateLatencyAfterDelay();
-    } else {
-        plugins.pop_back();
     }
 
     return success;
 }
 
 void track::audioNode::removePlugin(int index) {
-    this->plugins.erase(this->plugins.begin() + index);
-
     AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+
+    // destroyed at the end, out of the audio thread's reach
+    std::unique_ptr<subplugin> removed;
+    {
+        const juce::ScopedLock sl(p->getCallbackLock());
+        removed = std::move(plugins[(size_t)index]);
+        plugins.erase(plugins.begin() + index);
+    }
+
+    // might've been the one keeping a mono track in stereo
+    updateChannels();
+
     p->updateLatencyAfterDelay();
 }
 
@@ -2527,13 +3297,15 @@ int track::audioNode::getLatencySamples() {
     int retval = 0;
 
     for (auto &pluginInstance : plugins) {
-        retval += pluginInstance->plugin->getLatencySamples();
+        retval += pluginInstance->getLatencySamples();
     }
 
     return retval;
 }
 
 int track::audioNode::getTotalLatencySamples() {
+    engineContext &ctx = getContext(processor);
+
     int retval = 0;
 
     retval += this->getLatencySamples();
@@ -2542,8 +3314,8 @@ int track::audioNode::getTotalLatencySamples() {
         retval += node.getTotalLatencySamples();
     }
 
-    if (retval > MAX_LATENT_SAMPLES)
-        MAX_LATENT_SAMPLES = retval;
+    if (retval > ctx.maxLatentSamples)
+        ctx.maxLatentSamples = retval;
 
     this->latency = retval;
     return retval;
@@ -2551,38 +3323,124 @@ int track::audioNode::getTotalLatencySamples() {
 
 void track::audioNode::preparePlugins() {
     for (auto &p : plugins) {
-        p->plugin->prepareToPlay(track::SAMPLE_RATE, track::SAMPLES_PER_BLOCK);
+        p->prepare();
     }
 }
 
-void track::audioNode::process(int numSamples, int currentSample) {
+void track::audioNode::updateChannels() {
     AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+    jassert(p != nullptr);
+
+    // a mono track only stays mono if every plugin on it can
+    bool wantMono = isTrack && !isReturn && mono;
+    for (auto &sp : plugins) {
+        if (sp->plugin.get() != nullptr && !sp->supportsMono())
+            wantMono = false;
+    }
+
+    int channels = wantMono ? 1 : 2;
+    bool changed = false;
+
+    const juce::ScopedLock sl(p->getCallbackLock());
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        bool ok = true;
+
+        for (auto &sp : plugins) {
+            if (sp->plugin.get() == nullptr || sp->numChannels == channels)
+                continue;
+
+            sp->numChannels = channels;
+            sp->prepare();
+            changed = true;
+
+            // the plugin said it could, then didn't
+            ok = ok && sp->numChannels == channels;
+        }
+
+        if (ok || channels == 2)
+            break;
+
+        channels = 2;
+    }
+
+    numChannels = channels;
+
+    if (changed)
+        p->updateLatencyAfterDelay();
+}
+
+float track::audioNode::getPanGain(int channel) const {
+    return getPanGain(channel, pan);
+}
+
+float track::audioNode::getPanGain(int channel, float panValue) {
+    float normalisedPan = (0.5f) * (panValue + 1.f);
+
+    float l = juce::jmin(0.5f, 1.f - normalisedPan);
+    float r = juce::jmin(0.5f, normalisedPan);
+    float boost = 2.f;
+
+    return (channel == 0 ? l : r) * boost;
+}
+
+namespace {
+// adds numSamples of src onto dest, starting srcStart samples into src and
+// moving step samples of src per sample of dest. without a table srcStart
+// has to be whole and step 1
+// clips are float; dest is whatever the tree renders in
+template <typename SampleType>
+void mixClipChannel(SampleType *dest, const float *src, int srcLength,
+                    double srcStart, double step,
+                    const track::polyphaseTable *table, int numSamples,
+                    float gain) {
+    if (table == nullptr) {
+        src += (int)srcStart;
+
+        if constexpr (std::is_same_v<SampleType, float>) {
+            juce::FloatVectorOperations::addWithMultiply(dest, src, gain,
+                                                         numSamples);
+        } else {
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] += gain * src[i];
+        }
 
-    if (this->m || (p->soloMode && !this->s)) {
-        buffer.clear();
         return;
     }
 
-    if (buffer.getNumSamples() != numSamples)
-        buffer.setSize(2, numSamples, false, false, true);
+    for (int i = 0; i < numSamples; ++i)
+        dest[i] +=
+            gain * table->interpolate(src, srcLength, srcStart + i * step);
+}
+} // namespace
+
+template <typename SampleType>
+void track::audioNode::process(int numSamples, int currentSample) {
+    TRACE_SCOPE("audioNode::process");
 
-    buffer.clear();
+    juce::AudioBuffer<SampleType> &out = getBuffer<SampleType>();
 
     int outputBufferLength = numSamples;
-    int totalNumInputChannels = 2;
 
-    int latencyOffset = MAX_LATENT_SAMPLES - this->latency;
-    currentSample -= latencyOffset;
+    if (isReturn) {
+        // everything sent here this block, already lined up
+        juce::AudioBuffer<SampleType> &input = getSendInput<SampleType>();
 
-    if (isTrack) {
+        if (input.getNumSamples() >= numSamples) {
+            for (int channel = 0; channel < out.getNumChannels(); ++channel)
+                out.copyFrom(channel, 0, input, channel, 0, numSamples);
+        }
+    } else if (isTrack) {
         // add sample data to buffer
         for (clip &c : clips) {
             if (!c.active)
                 continue;
 
+            // everything here is at the host's rate, even if the clip isn't
+            int clipNumSamples = c.getNumSamples();
             int clipStart = c.startPositionSample;
-            int clipEnd = c.startPositionSample + c.buffer.getNumSamples();
-            int clipUsableNumSamples = c.buffer.getNumSamples() - c.trimLeft;
+            int clipEnd = c.startPositionSample + clipNumSamples;
+            int clipUsableNumSamples = clipNumSamples - c.trimLeft;
 
             if (clipUsableNumSamples <= 0)
                 continue;
@@ -2602,47 +3460,91 @@ void track::audioNode::process(int numSamples, int currentSample) {
                 ++clipBufferStart; // avoid doing this the "proper" way;
                                    // besides 1 sample doesn't matter
                 // how many samples can we safely copy?
-                int samplesToCopy =
-                    juce::jmin(outputBufferLength - outputOffset,
-                               c.buffer.getNumSamples() - c.trimRight -
-                                   clipBufferStart - 1);
+                int samplesToCopy = juce::jmin(
+                    outputBufferLength - outputOffset,
+                    clipNumSamples - c.trimRight - clipBufferStart - 1);
 
                 if (samplesToCopy <= 0 || clipBufferStart < 0)
                     continue;
 
-                if (c.buffer.getNumChannels() > 1) {
-                    for (int channel = 0; channel < buffer.getNumChannels();
-                         ++channel) {
-                        buffer.addFrom(channel, outputOffset, c.buffer,
-                                       channel % totalNumInputChannels,
-                                       clipBufferStart, samplesToCopy);
+                // one pass per channel of buffer, except that a mono node
+                // takes the average of a stereo clip's two channels
+                int clipChannels = c.getNumChannels();
+                bool downmix =
+                    out.getNumChannels() == 1 && clipChannels > 1;
+                int passes = downmix ? 2 : out.getNumChannels();
+                float passGain = downmix ? .5f : 1.f;
+
+                // clip's rate doesn't match the host's; pull each sample
+                // through the shared polyphase filter instead of copying
+                const polyphaseTable *table =
+                    c.needsResampling() ? c.playbackTable.get() : nullptr;
+                double step =
+                    table != nullptr ? c.sampleRate / c.hostSampleRate : 1.0;
+
+                if (c.source == nullptr) {
+                    for (int pass = 0; pass < passes; ++pass) {
+                        int channel = downmix ? 0 : pass;
+                        int srcChannel = clipChannels > 1 ? pass % 2 : 0;
+
+                        mixClipChannel(
+                            out.getWritePointer(channel, outputOffset),
+                            c.buffer.getReadPointer(srcChannel),
+                            c.buffer.getNumSamples(), clipBufferStart * step,
+                            step, table, samplesToCopy, passGain);
                     }
-                }
-
-                else {
-                    for (int channel = 0; channel < buffer.getNumChannels();
-                         ++channel) {
-                        buffer.addFrom(channel, outputOffset, c.buffer, 0,
-                                       clipBufferStart, samplesToCopy);
+                } else {
+                    // convert whatever this block needs into the graph's
+                    // scratch buffer first, plus enough either side for the
+                    // filter. in chunks if the clip's rate is so much higher
+                    // than the host's that it doesn't fit at once
+                    AudioPluginAudioProcessor *p =
+                        (AudioPluginAudioProcessor *)processor;
+                    juce::AudioBuffer<float> &scratch = p->graph.clipScratch;
+
+                    int margin = table != nullptr ? table->taps / 2 + 16 : 0;
+                    int room = scratch.getNumSamples() - margin * 2 - 2;
+                    int chunk = (int)(room / step);
+                    int readChannels =
+                        juce::jmin(clipChannels, scratch.getNumChannels());
+
+                    for (int done = 0; chunk > 0 && done < samplesToCopy;
+                         done += chunk) {
+                        int n = juce::jmin(chunk, samplesToCopy - done);
+                        double pos = (clipBufferStart + done) * step;
+
+                        juce::int64 windowStart = juce::jmax(
+                            (juce::int64)0, (juce::int64)pos - margin);
+                        int windowLength = juce::jmin(
+                            scratch.getNumSamples(),
+                            (int)((juce::int64)(pos + n * step) - windowStart) +
+                                margin + 2);
+
+                        if (!c.source->isResident(c.id, windowStart,
+                                                  windowStart + windowLength))
+                            ++p->telemetry.underruns;
+
+                        c.source->read(scratch.getArrayOfWritePointers(),
+                                       readChannels, windowStart, windowLength);
+
+                        for (int pass = 0; pass < passes; ++pass) {
+                            int channel = downmix ? 0 : pass;
+                            int srcChannel = clipChannels > 1 ? pass % 2 : 0;
+
+                            mixClipChannel(
+                                out.getWritePointer(channel,
+                                                    outputOffset + done),
+                                scratch.getReadPointer(srcChannel),
+                                windowLength, pos - (double)windowStart, step,
+                                table, n, passGain);
+                        }
                     }
-                }
-
-                buffer.applyGain(c.gain);
-            }
-        }
-    } else {
-        // let child tracks process
-        for (audioNode &child : this->childNodes) {
-            child.process(numSamples, currentSample);
-        }
 
-        // sum up buffers
-        for (track::audioNode &t : childNodes) {
-            int totalNumOutputChannels = 2;
-            for (int channel = 0; channel < totalNumOutputChannels; ++channel) {
+                    double played = (clipBufferStart + samplesToCopy) * step;
+                    c.source->markPlayed(c.id, (juce::int64)played);
+                }
 
-                buffer.addFrom(channel, 0, t.buffer, channel, 0,
-                               buffer.getNumSamples());
+                out.applyGain(c.gain);
             }
         }
     }
@@ -2652,23 +3554,176 @@ void track::audioNode::process(int numSamples, int currentSample) {
         if (this->plugins[i] == nullptr)
             return;
 
-        if (this->plugins[i]->bypassed == true)
+        if (this->plugins[i]->bypassed == true || this->plugins[i]->faulted)
             continue;
 
+        AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+        bool timed = p != nullptr && p->telemetry.isEnabled();
+        juce::int64 start = timed ? juce::Time::getHighResolutionTicks() : 0;
+
         this->plugins[i]->relayParamsToPlugin();
         this->plugins[i]->process(this->buffer);
+
+        if (timed) {
+            this->plugins[i]->telemetrySeconds +=
+                juce::Time::highResolutionTicksToSeconds(
+                    juce::Time::getHighResolutionTicks() - start);
+        }
     }
 
-    // pan audio
-    float normalisedPan = (0.5f) * (pan + 1.f);
+    processSends<SampleType>(true);
 
-    float l = juce::jmin(0.5f, 1.f - normalisedPan);
-    float r = juce::jmin(0.5f, normalisedPan);
-    float boost = 2.f;
+    // ramped from wherever the last block left off, so a slider or control
+    // surface moving these doesn't click
+    float startGain = rampedGain < 0.f ? gain : rampedGain;
+    float startPan = rampedGain < 0.f ? pan : rampedPan;
+    rampedGain = gain;
+    rampedPan = pan;
+    panRampStart = startPan;
 
-    buffer.applyGain(0, 0, buffer.getNumSamples(), l * boost);
-    buffer.applyGain(1, 0, buffer.getNumSamples(), r * boost);
+    // pan audio. mono nodes get panned by the RenderGraph instead, when
+    // they're added onto a stereo buffer
+    if (out.getNumChannels() > 1) {
+        for (int channel = 0; channel < 2; ++channel) {
+            out.applyGainRamp(channel, 0, out.getNumSamples(),
+                                 getPanGain(channel, startPan),
+                                 getPanGain(channel, pan));
+        }
+    }
 
     // main audio processing is done; add gain as final step
-    buffer.applyGain(gain);
+    out.applyGainRamp(0, out.getNumSamples(), startGain, gain);
+
+    // stereo buffers are already panned by now; mono ones get it on the way
+    // into the return
+    processSends<SampleType>(false, startPan, pan);
+}
+
+template <typename SampleType>
+void track::audioNode::processSends(bool preFader, float startPan,
+                                    float endPan) {
+    AudioPluginAudioProcessor *p = (AudioPluginAudioProcessor *)processor;
+    juce::AudioBuffer<SampleType> &buffer = getBuffer<SampleType>();
+
+    for (send &s : sends) {
+        if (s.preFader != preFader)
+            continue;
+
+        // sends to a deleted return stick around (for undo) but do nothing
+        audioNode *target = p->graph.getReturn(s.returnID);
+        if (target == nullptr || target == this)
+            continue;
+
+        juce::AudioBuffer<SampleType> &input =
+            target->getSendInput<SampleType>();
+        if (input.getNumSamples() < buffer.getNumSamples())
+            continue;
+
+        s.compensation.processAndAdd(buffer, input,
+                                     buffer.getNumSamples(), s.gain,
+                                     startPan, endPan);
+    }
+}
+
+void track::delayBuffer::setDelay(int newDelay) {
+    newDelay = juce::jmax(0, newDelay);
+
+    if (newDelay == delay)
+        return;
+
+    delay = newDelay;
+    writePosition = 0;
+    data.setSize(2, juce::jmax(1, delay), false, true, false);
+    data.clear();
+}
+
+template <typename SampleType>
+void track::delayBuffer::process(juce::AudioBuffer<SampleType> &buffer,
+                                 int numSamples) {
+    if (delay == 0)
+        return;
+
+    int numChannels =
+        juce::jmin(buffer.getNumChannels(), data.getNumChannels());
+    int pos = writePosition;
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        SampleType *x = buffer.getWritePointer(channel);
+        double *d = data.getWritePointer(channel);
+        pos = writePosition;
+
+        for (int i = 0; i < numSamples; ++i) {
+            SampleType y = (SampleType)d[pos];
+            d[pos] = x[i];
+            x[i] = y;
+
+            if (++pos == delay)
+                pos = 0;
+        }
+    }
+
+    writePosition = pos;
+}
+
+template <typename SampleType>
+void track::delayBuffer::processAndAdd(
+    const juce::AudioBuffer<SampleType> &src,
+    juce::AudioBuffer<SampleType> &dest, int numSamples, float gain,
+    float startPan, float endPan) {
+    // a mono source goes to every channel of dest, panned like the node's
+    // stereo output would have been
+    bool fanOut = src.getNumChannels() == 1;
+    int numChannels =
+        fanOut ? dest.getNumChannels()
+               : juce::jmin(src.getNumChannels(), dest.getNumChannels());
+
+    if (delay == 0) {
+        for (int channel = 0; channel < numChannels; ++channel) {
+            if (fanOut) {
+                dest.addFromWithRamp(
+                    channel, 0, src.getReadPointer(0), numSamples,
+                    gain * audioNode::getPanGain(channel, startPan),
+                    gain * audioNode::getPanGain(channel, endPan));
+            } else {
+                dest.addFrom(channel, 0, src, channel, 0, numSamples, gain);
+            }
+        }
+
+        return;
+    }
+
+    numChannels = juce::jmin(numChannels, data.getNumChannels());
+    int pos = writePosition;
+
+    for (int channel = 0; channel < numChannels; ++channel) {
+        const SampleType *x = src.getReadPointer(fanOut ? 0 : channel);
+        SampleType *out = dest.getWritePointer(channel);
+        double *d = data.getWritePointer(channel);
+        pos = writePosition;
+
+        // panned going in, so the delay line holds what a stereo source's
+        // would have
+        float panGain = fanOut ? audioNode::getPanGain(channel, startPan) : 1.f;
+        float panStep =
+            fanOut ? (audioNode::getPanGain(channel, endPan) - panGain) /
+                         (float)juce::jmax(1, numSamples)
+                   : 0.f;
+
+        for (int i = 0; i < numSamples; ++i) {
+            double y = d[pos];
+            d[pos] = x[i] * (panGain + panStep * (float)i);
+            out[i] += (SampleType)(y * gain);
+
+            if (++pos == delay)
+                pos = 0;
+        }
+    }
+
+    writePosition = pos;
 }
+
+// the tree renders in float or double, depending on the host
+template void track::audioNode::process<float>(int, int);
+template void track::audioNode::process<double>(int, int);
+template void track::delayBuffer::process(juce::AudioBuffer<float> &, int);
+template void track::delayBuffer::process(juce::AudioBuffer<double> &, int);
@@ -1,12 +1,22 @@
 #pragma once
 #include "BinaryData.h"
+#include "defs.h"
+#include "mapped.h"
+#include "packed.h"
+#include "resampler.h"
 #include "subwindow.h"
 #include <JuceHeader.h>
+#include <type_traits>
 
 namespace track {
 class clip {
   public:
     juce::String path;
+
+    // the file a clip imported with "resample to host rate" was made from.
+    // path is then its resampled copy in the cache, which can be evicted
+    // and gets made again from this (see diskcache::trim())
+    juce::String sourcePath;
     juce::String name = "untitled clip";
 
     int startPositionSample = -1; // absolute sample position within host
@@ -17,8 +27,34 @@ class clip {
     int trimLeft = 0;
     int trimRight = 0;
 
+    // identifies the clip to its component on the timeline, since the clip's
+    // address changes whenever its node's clips do. copies keep it, so
+    // anything that turns one clip into two gives the new one getNewID()
+    int id = -1;
+    static int getNewID();
+
+    // exactly one of these holds the audio once it's loaded. clips with a
+    // source leave buffer empty, so go through the getters below instead of
+    // asking buffer how big it is
     juce::AudioBuffer<float> buffer;
-    bool updateBuffer();
+    std::shared_ptr<clipSource> source;
+    bool updateBuffer(double newHostSampleRate,
+                      clipStorage storage = clipStorage::decoded);
+
+    int getNumChannels();
+    int getSourceNumSamples(); // length at the clip's own rate
+    bool isLoaded() { return getNumChannels() > 0; }
+
+    // rate of buffer; clips get resampled on the fly if this isn't the host's.
+    // startPositionSample/trimLeft/trimRight are always at the host's rate,
+    // which is whatever updatePlaybackTable() was last told
+    double sampleRate = 0.0;
+    double hostSampleRate = 0.0;
+    std::shared_ptr<const polyphaseTable> playbackTable;
+
+    bool needsResampling();
+    void updatePlaybackTable(double newHostSampleRate); // not from audio thread
+    int getNumSamples(); // length at the host's rate
 };
 
 struct clipCoordinate {
@@ -26,20 +62,32 @@ struct clipCoordinate {
     int pluginIndex = -1;
 };
 
+class PeakCache;
 class ClipComponent : public juce::Component, public juce::ChangeListener {
   public:
-    ClipComponent(clip *c, int clipHash);
+    ClipComponent(clip *c, PeakCache *cache, void *processor);
     ~ClipComponent();
 
-    juce::AudioThumbnailCache thumbnailCache;
-    juce::AudioThumbnail thumbnail;
-    juce::AudioFormatManager afm;
+    void *processor = nullptr;
+
+    // shared with every other clip component; repaints when peaks come in
+    PeakCache *peakCache = nullptr;
     void changeListenerCallback(ChangeBroadcaster *source) override;
+    void drawWaveform(juce::Graphics &g, juce::Rectangle<int> bounds);
 
+    // rebound by the timeline whenever the clips move; clipID is what it
+    // goes by to find which clip is this component's again
     clip *correspondingClip = nullptr;
+    int clipID = -1;
 
     void paint(juce::Graphics &g) override;
     bool stale = true;
+
+    // what the clip looked like when this was last painted. components get
+    // reused, so this is how we know whether the clip behind it changed
+    juce::String drawnState;
+    juce::String getClipState();
+    bool isPinned(); // being dragged/edited; don't recycle it
     int nodeDisplayIndex = -1;
     int curDragNodeDisplayIndex = -1;
 
@@ -92,7 +140,7 @@ class ClipComponent : public juce::Component, public juce::ChangeListener {
 class ActionClipModified : public juce::UndoableAction {
   public:
     void *p = nullptr;
-    std::vector<int> route;
+    int nodeID = -1;
     int clipIndex;
 
     // int oldStartSample;
@@ -115,8 +163,8 @@ class ActionClipModified : public juce::UndoableAction {
 class ActionMoveClipToNode : public juce::UndoableAction {
   public:
     void *p = nullptr;
-    std::vector<int> srcRoute;
-    std::vector<int> destRoute;
+    int srcNodeID = -1;
+    int destNodeID = -1;
     int clipIndex = -1;
 
     int srcStartSample = -1;
@@ -177,21 +225,138 @@ class subplugin {
     void relayParamsToPlugin();
 
     void *processor = nullptr;
+    int id = -1;
     bool bypassed = false;
     float dryWetMix = 1.f;
+    float rampedDryWetMix = -1.f; // see audioNode::rampedGain
+
+    // message thread. prepares the plugin and everything process() needs,
+    // so that it never has to allocate. the plugin's main buses get
+    // numChannels channels (falls back to 2 if it won't take that)
+    void prepare();
+    int numChannels = 2;
+    bool supportsMono();
+    int getLatencySamples();
+
+    // SampleType is whatever the tree renders in (see
+    // engineContext::doublePrecision). plugins that only do float get double
+    // blocks converted through conversion
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType> &buffer);
+    template <typename SampleType>
+    void processDirect(juce::AudioBuffer<SampleType> &buffer);
+    bool processesDouble = false; // set by prepare()
+
+    // a plugin that threw from processBlock() or tripped the watchdog is
+    // skipped like a bypassed one. reload() swaps in a fresh instance with
+    // the old one's state; message thread only
+    std::atomic<bool> faulted{false};
+    int overruns = 0; // consecutive blocks over budget; audio thread only
+
+    // while the watchdog is on, when the call to processBlock() that's in
+    // progress has taken too long (in high resolution ticks). 0 outside of
+    // it. PluginWatchdog marks the plugin faulted once it's passed
+    std::atomic<juce::int64> deadline{0};
+
+    // time spent in process() since the last telemetry flush; audio thread
+    // only (see RenderGraph::flushTelemetry())
+    double telemetrySeconds = 0.0;
+    void markFaulted(); // audio thread
+
+    // false if it couldn't, including while the old instance is still stuck
+    // in processBlock()
+    bool reload();
+
+    juce::MidiBuffer midi;
+
+    // see engineContext::fixedPluginBlockSize. fifoIn collects input until
+    // there's a whole block, fifoOut plays back what the last block came out as
+    int fixedBlockSize = 0;
+    int fifoPosition = 0;
+
+    // one set per precision; prepare() only allocates the one in use
+    template <typename SampleType> struct processBuffers {
+        juce::AudioBuffer<SampleType> dry;
+        juce::AudioBuffer<SampleType> fifoIn;
+        juce::AudioBuffer<SampleType> fifoOut;
+    };
+    processBuffers<float> floatBuffers;
+    processBuffers<double> doubleBuffers;
+
+    template <typename SampleType> processBuffers<SampleType> &getBuffers() {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return floatBuffers;
+        else
+            return doubleBuffers;
+    }
+
+    // hands buffer to the plugin. a double one goes through conversion if
+    // the plugin isn't processing in double
+    void processBlock(juce::AudioBuffer<float> &buffer);
+    void processBlock(juce::AudioBuffer<double> &buffer);
+    juce::AudioBuffer<float> conversion;
+};
 
-    void process(juce::AudioBuffer<float> &buffer);
+// fixed delay used to line sends and returns up with the main path. setDelay()
+// allocates, so only call it from the message thread under the callback lock.
+// the line itself is double, so it works for either precision
+struct delayBuffer {
+    juce::AudioBuffer<double> data;
+    int delay = 0;
+    int writePosition = 0;
+
+    void setDelay(int newDelay);
+
+    // in place
+    template <typename SampleType>
+    void process(juce::AudioBuffer<SampleType> &buffer, int numSamples);
+
+    // delays src, scales it by gain and adds it onto dest. a mono src is
+    // panned out to dest's channels, ramping from startPan to endPan
+    template <typename SampleType>
+    void processAndAdd(const juce::AudioBuffer<SampleType> &src,
+                       juce::AudioBuffer<SampleType> &dest, int numSamples,
+                       float gain, float startPan = 0.f, float endPan = 0.f);
+};
+
+struct send {
+    int returnID = -1;
+    float gain = 1.f;
+    bool preFader = false; // taps after plugins instead of after pan/gain
+
+    // set by updateLatency() so that every source reaches the return at the
+    // same time
+    delayBuffer compensation;
 };
 
 class audioNode {
   public:
     bool s = false;
     bool m = false;
+    bool recordArmed = false; // tracks only
     float gain = 1.f;
     float pan = 0.f;
 
+    // anything other than 0 skips the parent and goes straight to that host
+    // output, or to the main one if the host hasn't enabled it
+    int outputBus = 0;
+
+    // mono tracks render one channel through their whole plugin chain, and
+    // are only panned out to stereo when they're summed into their parent.
+    // numChannels is what's actually used; see updateChannels()
+    bool mono = false;
+    int numChannels = 2;
+    float getPanGain(int channel) const;
+    static float getPanGain(int channel, float panValue);
+
+    // gain and pan as of the end of the last block. changes get ramped from
+    // these over one block instead of jumping; -1 before the first block
+    float rampedGain = -1.f;
+    float rampedPan = 0.f;
+    float panRampStart = 0.f; // where this block's pan ramp started
+
     juce::String trackName = "Untitled Node";
-    int stain = -1;
+    int id = -1; // see AudioPluginAudioProcessor::rebuildNodeIndex()
 
     // future john, have fun trying to implement hosting audio plugins :skull:
     // haha screw you past john you old sack of dirt
@@ -200,8 +365,24 @@ class audioNode {
     void removePlugin(int index);
     void preparePlugins();
 
+    // message thread. works out numChannels from mono and the plugins, and
+    // re-prepares any plugin whose layout has to change
+    void updateChannels();
+
+    // renders just this node; a group's children have already been summed
+    // into its buffer by then. buffer is a slice of the RenderGraph's arena,
+    // and so is doubleBuffer when the host renders in double instead
+    template <typename SampleType>
     void process(int numSamples, int currentSample);
     juce::AudioBuffer<float> buffer;
+    juce::AudioBuffer<double> doubleBuffer;
+
+    template <typename SampleType> juce::AudioBuffer<SampleType> &getBuffer() {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return buffer;
+        else
+            return doubleBuffer;
+    }
 
     void *processor = nullptr;
 
@@ -212,6 +393,30 @@ class audioNode {
     int latency = -1;
     int getLatencySamples();
     int getTotalLatencySamples();
+
+    // returns are top level tracks without clips; their input is whatever
+    // gets sent to them. they're processed after the rest of the tree, in
+    // the order given by processor->returnSchedule
+    bool isReturn = false;
+    int returnID = -1;
+    juce::AudioBuffer<float> sendInput;
+    juce::AudioBuffer<double> doubleSendInput;
+    delayBuffer returnCompensation;
+
+    template <typename SampleType>
+    juce::AudioBuffer<SampleType> &getSendInput() {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return sendInput;
+        else
+            return doubleSendInput;
+    }
+    int returnInputLatency = 0;  // latest arrival of any of its sources
+    int returnOutputLatency = 0; // + its own plugins
+
+    std::vector<send> sends;
+    template <typename SampleType>
+    void processSends(bool preFader, float startPan = 0.f,
+                      float endPan = 0.f);
 };
 
 class TrackComponent : public juce::Component {
@@ -235,13 +440,18 @@ class TrackComponent : public juce::Component {
     }
 
     void copyNodeToClipboard();
+    void addSendsMenu(juce::PopupMenu &menu);
+    void addOutputMenu(juce::PopupMenu &menu);
+    void modifySends(std::vector<send> newSends);
 
     audioNode *getCorrespondingTrack();
+    bool isPinned(); // shouldn't be handed to another row right now
     void *processor = nullptr;
     int siblingIndex = -1;
     std::vector<int> route;
     int displayIndex = -1;
 
+    juce::TextButton armBtn;
     juce::TextButton muteBtn;
     juce::TextButton soloBtn;
     juce::TextButton fxBtn; // like in REAPER
@@ -281,11 +491,19 @@ class InsertIndicator : public juce::Component {
     void paint(juce::Graphics &g) { g.fillAll(juce::Colours::silver); }
 };
 
+// node actions hold on to node ids rather than routes, since routes shift
+// with every edit made after the action
 class ActionCreateNode : public juce::UndoableAction {
   public:
-    // audioNode *parent;
     bool isTrack = true;
-    std::vector<int> parentRoute;
+    int parentID = -1;
+
+    // returns are always created at the top level. the id gets picked on the
+    // first perform() and kept so that redo doesn't orphan any sends
+    bool isReturn = false;
+    int returnID = -1;
+
+    int nodeID = -1; // same idea; picked on the first perform()
 
     void *p = nullptr;
 
@@ -297,15 +515,36 @@ class ActionCreateNode : public juce::UndoableAction {
     void updateGUI(); // y
 };
 
+class ActionModifySends : public juce::UndoableAction {
+  public:
+    int nodeID = -1;
+    std::vector<send> oldSends;
+    std::vector<send> newSends;
+
+    void *p = nullptr;
+
+    ActionModifySends(std::vector<int> nodeRoute, std::vector<send> newState,
+                      void *processor);
+    ~ActionModifySends();
+
+    bool perform() override;
+    bool undo() override;
+    void apply(std::vector<send> &state);
+    void updateGUI(); // y
+};
+
 class ActionDeleteNode : public juce::UndoableAction {
   public:
-    std::vector<int> route;
+    int nodeID = -1;
     void *p = nullptr;
 
     ActionDeleteNode(std::vector<int> nodeRoute, void *processor);
     ~ActionDeleteNode();
 
-    audioNode nodeCopy;
+    // the node itself while it's out of the tree, and where it goes back
+    audioNode deletedNode;
+    int parentID = -1;
+    int index = -1;
 
     bool perform() override;
     bool undo() override;
@@ -314,13 +553,15 @@ class ActionDeleteNode : public juce::UndoableAction {
 
 class ActionPasteNode : public juce::UndoableAction {
   public:
-    std::vector<int> parentRoute;
-    std::vector<int> pastedNodeRoute;
+    int parentID = -1;
+    int pastedNodeID = -1;
     void *p = nullptr;
 
     ActionPasteNode(std::vector<int> pRoute, audioNode *node, void *processor);
     ~ActionPasteNode();
 
+    // a copy of the clipboard, moved into the tree by perform() and back out
+    // by undo(), so that redo pastes the same node (same ids) again
     audioNode *nodeToPaste = nullptr;
 
     bool perform() override;
@@ -334,10 +575,12 @@ struct TrivialNodeData {
     float gain;
     bool s;
     bool m;
+    int outputBus;
+    bool mono;
 };
 class ActionModifyTrivialNodeData : public juce::UndoableAction {
   public:
-    std::vector<int> route;
+    int nodeID = -1;
     // audioNode oldState;
     // audioNode newState;
 
@@ -356,10 +599,13 @@ class ActionModifyTrivialNodeData : public juce::UndoableAction {
     void updateGUI(); // y
 };
 
+// moves the node at route1 to just before whatever is at route2 (a sibling)
 class ActionReorderNode : public juce::UndoableAction {
   public:
-    std::vector<int> r1;
-    std::vector<int> r2;
+    int nodeID = -1;
+    int parentID = -1;
+    int srcIndex = -1;
+    int destIndex = -1; // where it ends up, once it's out of the way
 
     ActionReorderNode(std::vector<int> route1, std::vector<int> route2,
                       void *processor);
@@ -377,12 +623,16 @@ class ActionUngroup : public juce::UndoableAction {
     ActionUngroup(std::vector<int> nodeRoute, void *processor);
     ~ActionUngroup();
 
-    std::vector<int> route;
-    std::vector<int> trackRouteAfterUngroup;
+    int nodeID = -1;
+    int parentID = -1;
+    int index = -1;
 
     void *p = nullptr;
 
-    audioNode nodeCopy;
+    // a group is taken out of the tree and its children put where it was.
+    // this holds the emptied group until undo() puts them back into it
+    audioNode group;
+    std::vector<int> childIDs;
 
     bool perform() override;
     bool undo() override;
@@ -391,11 +641,12 @@ class ActionUngroup : public juce::UndoableAction {
 
 class ActionMoveNodeToGroup : public juce::UndoableAction {
   public:
-    std::vector<int> nodeToMoveRoute;
-    std::vector<int> groupRoute;
+    int nodeID = -1;
+    int groupID = -1;
 
-    std::vector<int> routeAfterMoving;
-    std::vector<int> groupRouteAfterMoving;
+    // where it was, for undo()
+    int oldParentID = -1;
+    int oldIndex = -1;
 
     void *p = nullptr;
 
@@ -408,9 +659,6 @@ class ActionMoveNodeToGroup : public juce::UndoableAction {
     void updateGUI(); // y
 
     void updateOnlyTracklist();
-    std::vector<int> getStainedRoute(int staincode);
-    std::vector<int> traverseStain(int staincode, audioNode *parentNode,
-                                   std::vector<int> r, int depth);
 };
 
 class Tracklist : public juce::Component {
@@ -418,9 +666,31 @@ class Tracklist : public juce::Component {
     Tracklist();
     ~Tracklist();
 
+    // one row per node in display order. rebuilt with a flat walk whenever the
+    // tree's structure changes, which is cheap compared to creating components
+    struct displayRow {
+        std::vector<int> route;
+        int siblingIndex = -1;
+    };
+    std::vector<displayRow> rows;
+    void findChildren(audioNode *parentNode, std::vector<int> route);
+    void updateRows();
+
+    int getNumRows() { return (int)rows.size(); }
+    std::vector<int> getRouteAtRow(int row);
+    audioNode *getNodeAtRow(int row);
+
+    // only the rows in view (plus a few either side) get a component. the rest
+    // are hidden in spareTrackComponents and handed out again when scrolling
     std::vector<std::unique_ptr<TrackComponent>> trackComponents;
-    int findChildren(audioNode *parentNode, std::vector<int> route,
-                     int foundItems, int depth);
+    std::vector<std::unique_ptr<TrackComponent>> spareTrackComponents;
+    static constexpr int virtualizationMarginRows = 4;
+    void updateVisibleTrackComponents();
+    void assignRow(TrackComponent *tc, int row);
+
+    // refreshes the rows and hides components whose row doesn't hold their
+    // node anymore. they get reassigned on the next frame
+    void rebindTrackComponents();
     juce::String getPrettyVector(std::vector<int> v) {
         juce::String retval = "[";
         for (int x : v) {
@@ -431,12 +701,9 @@ class Tracklist : public juce::Component {
         return retval;
     }
     void createTrackComponents();
-    void setDisplayIndexes();
     void setTrackComponentBounds();
     void updateExistingTrackComponents();
 
-    void clearStains();
-
     InsertIndicator insertIndicator;
     void updateInsertIndicator(int index);
 
@@ -445,6 +712,7 @@ class Tracklist : public juce::Component {
     void copyNode(audioNode *dest, audioNode *src);
     void addNewNode(bool isTrack = true,
                     std::vector<int> parentRoute = std::vector<int>());
+    void addNewReturn();
     void deleteTrack(std::vector<int> route);
     void recursivelyDeleteNodePlugins(audioNode *node);
     bool isDescendant(audioNode *parent, audioNode *possibleChild,
@@ -467,6 +735,7 @@ class TrackViewport : public juce::Viewport {
     ~TrackViewport();
 
     void scrollBarMoved(juce::ScrollBar *bar, double newRangeStart) override;
+    void visibleAreaChanged(const juce::Rectangle<int> &newArea) override;
 
     void *timelineViewport = nullptr;
 };
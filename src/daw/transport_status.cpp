@@ -5,7 +5,7 @@ track::TransportStatusComponent::TransportStatusComponent()
 
 track::TransportStatusComponent::~TransportStatusComponent(){};
 
-void track::TransportStatusComponent::paint(juce::Graphics &g) {
+void track::TransportStatusComponent::updateDisplay() {
     // this whole function is absolute cinema
 
     // get time info
@@ -55,6 +55,33 @@ void track::TransportStatusComponent::paint(juce::Graphics &g) {
         division = (totalDivisions % divisionPerBar) + 1;
     }
 
+    // bar.beat.division
+    juce::String timeInfoToDisplay = juce::String(bar);
+    timeInfoToDisplay.append(".", 1);
+    timeInfoToDisplay.append(juce::String(beat), 3);
+    timeInfoToDisplay.append(".", 1);
+    timeInfoToDisplay.append(juce::String(division), 3);
+
+    juce::String tempoToDisplay;
+    tempoToDisplay.append(juce::String(tempo), 4);
+
+    juce::String timeSignatureInfoToDisplay;
+    timeSignatureInfoToDisplay.append(juce::String(timeSignature.numerator), 3);
+    timeSignatureInfoToDisplay.append("/", 1);
+    timeSignatureInfoToDisplay.append(juce::String(timeSignature.numerator), 3);
+
+    // the gradients aren't free, so only repaint when something changed
+    if (timeInfoToDisplay == timeInfo && tempoToDisplay == tempoInfo &&
+        timeSignatureInfoToDisplay == timeSignatureInfo)
+        return;
+
+    timeInfo = timeInfoToDisplay;
+    tempoInfo = tempoToDisplay;
+    timeSignatureInfo = timeSignatureInfoToDisplay;
+    repaint();
+}
+
+void track::TransportStatusComponent::paint(juce::Graphics &g) {
     float cornerSize = 4.f;
 
     // fill bg color
@@ -81,33 +108,18 @@ void track::TransportStatusComponent::paint(juce::Graphics &g) {
     juce::Rectangle<int> timeInfoTextRectangle = getLocalBounds();
     timeInfoTextRectangle.reduce(14, 0);
 
-    // draw text for time info
-    // bar.beat.division
-    juce::String timeInfoToDisplay = juce::String(bar);
-    timeInfoToDisplay.append(".", 1);
-    timeInfoToDisplay.append(juce::String(beat), 3);
-    timeInfoToDisplay.append(".", 1);
-    timeInfoToDisplay.append(juce::String(division), 3);
-
-    juce::String tempoToDisplay;
-    tempoToDisplay.append(juce::String(tempo), 4);
-
-    juce::String timeSignatureInfoToDisplay;
-    timeSignatureInfoToDisplay.append(juce::String(timeSignature.numerator), 3);
-    timeSignatureInfoToDisplay.append("/", 1);
-    timeSignatureInfoToDisplay.append(juce::String(timeSignature.numerator), 3);
-
     g.setColour(juce::Colour(0xFF'CDD8E4).withAlpha(0.7f));
     g.setFont(
         getRobotoMonoThin().withHeight(26.f).boldened().withExtraKerningFactor(
             -.06f));
 
-    g.drawText(timeInfoToDisplay, timeInfoTextRectangle,
-               juce::Justification::left, false);
+    // draw text for time info
+    g.drawText(timeInfo, timeInfoTextRectangle, juce::Justification::left,
+               false);
 
-    g.drawText(tempoToDisplay, timeInfoTextRectangle,
+    g.drawText(tempoInfo, timeInfoTextRectangle,
                juce::Justification::horizontallyCentred, false);
 
-    g.drawText(timeSignatureInfoToDisplay, timeInfoTextRectangle,
+    g.drawText(timeSignatureInfo, timeInfoTextRectangle,
                juce::Justification::right, false);
 }
@@ -10,6 +10,12 @@ class TransportStatusComponent : public juce::Component {
 
     void paint(juce::Graphics &g) override;
 
+    // polled by the editor; repaints only if the text would change
+    void updateDisplay();
+    juce::String timeInfo;
+    juce::String tempoInfo;
+    juce::String timeSignatureInfo;
+
     AudioPluginAudioProcessor *processorRef = nullptr;
 
     // visual studio is an absolute truckload of shit
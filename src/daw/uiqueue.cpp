@@ -0,0 +1,93 @@
+#include "uiqueue.h"
+#include <algorithm>
+
+bool track::GUIInstructionQueue::canBeDeferred(int command) {
+    // the clip components rebuilt by UPDATE_CORE and UPDATE_CLIP_COMPONENTS
+    // point into clip vectors that were just changed. the editor rebinds them
+    // by clip id as soon as those are dispatched, so only the rebuild waits
+    switch (command) {
+    case UI_INSTRUCTION_UPDATE_CORE:
+    case UI_INSTRUCTION_UPDATE_CLIP_COMPONENTS:
+    case UI_INSTRUCTION_UPDATE_STALE_TIMELINE:
+    case UI_INSTRUCTION_RECREATE_ALL_PNCS:
+    case UI_INSTRUCTION_UPDATE_PLUGIN_CHAIN_WITHOUT_RECREATING_PNCS:
+    case UI_INSTRUCTION_RECREATE_RELAY_NODES:
+    case UI_INSTRUCTION_UPDATE_NODE_COMPONENTS:
+    case UI_INSTRUCTION_UPDATE_EXISTING_NODE_COMPONENTS:
+    case UI_INSTRUCTION_RESIZE_CLIP_COMPONENTS:
+    case UI_INSTRUCTION_NODE_NAME_CHANGE:
+    case UI_INSTRUCTION_UPDATE_CORE_SCROLLS:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool track::GUIInstructionQueue::absorbs(const uiinstruction &big,
+                                         const uiinstruction &small) {
+    if (big.command == small.command && big.r == small.r &&
+        big.metadata == small.metadata)
+        return true;
+
+    switch (big.command) {
+    // rebuilds the tracklist and the clip components
+    case UI_INSTRUCTION_UPDATE_CORE:
+        return small.command == UI_INSTRUCTION_UPDATE_CLIP_COMPONENTS ||
+               small.command == UI_INSTRUCTION_UPDATE_NODE_COMPONENTS ||
+               small.command ==
+                   UI_INSTRUCTION_UPDATE_EXISTING_NODE_COMPONENTS ||
+               small.command == UI_INSTRUCTION_RESIZE_CLIP_COMPONENTS;
+
+    // every row gets reassigned, which refreshes names and sliders too
+    case UI_INSTRUCTION_UPDATE_NODE_COMPONENTS:
+        return small.command == UI_INSTRUCTION_UPDATE_EXISTING_NODE_COMPONENTS;
+
+    case UI_INSTRUCTION_UPDATE_CLIP_COMPONENTS:
+        return small.command == UI_INSTRUCTION_RESIZE_CLIP_COMPONENTS;
+
+    case UI_INSTRUCTION_RECREATE_ALL_PNCS:
+        return small.command ==
+                   UI_INSTRUCTION_UPDATE_PLUGIN_CHAIN_WITHOUT_RECREATING_PNCS &&
+               small.r == big.r;
+
+    default:
+        return false;
+    }
+}
+
+bool track::GUIInstructionQueue::push(uiinstruction x) {
+    const juce::ScopedLock sl(lock);
+
+    bool deferred = canBeDeferred(x.command);
+
+    if (deferred) {
+        for (auto &queued : pending) {
+            if (absorbs(queued, x))
+                return false;
+        }
+    }
+
+    // whatever the new one covers doesn't need doing anymore
+    pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                 [&x](const uiinstruction &queued) {
+                                     return canBeDeferred(queued.command) &&
+                                            absorbs(x, queued);
+                                 }),
+                  pending.end());
+
+    pending.push_back(x);
+    return !deferred;
+}
+
+std::vector<track::uiinstruction> track::GUIInstructionQueue::take() {
+    const juce::ScopedLock sl(lock);
+
+    std::vector<uiinstruction> retval;
+    retval.swap(pending);
+    return retval;
+}
+
+void track::GUIInstructionQueue::clear() {
+    const juce::ScopedLock sl(lock);
+    pending.clear();
+}
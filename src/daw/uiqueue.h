@@ -0,0 +1,29 @@
+#pragma once
+#include "defs.h"
+#include <JuceHeader.h>
+
+namespace track {
+// instructions the processor sends to the editor. ones that only refresh
+// components get merged here and flushed together once per frame, so a batch
+// of actions rebuilds the ui once instead of once per action. everything else
+// (closing windows, raw pointers in metadata, ...) has to happen straight away
+class GUIInstructionQueue {
+  public:
+    // true if x has to be handled before the caller carries on. the queue
+    // should be flushed synchronously then, so earlier ones keep their order.
+    // otherwise it waits for the editor's next frame
+    bool push(uiinstruction x);
+
+    std::vector<uiinstruction> take();
+    void clear();
+
+    static bool canBeDeferred(int command);
+
+    // true if handling big makes handling small pointless
+    static bool absorbs(const uiinstruction &big, const uiinstruction &small);
+
+  private:
+    juce::CriticalSection lock;
+    std::vector<uiinstruction> pending;
+};
+} // namespace track
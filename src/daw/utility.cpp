@@ -66,7 +66,12 @@ void track::utility::copyNode(audioNode *dest, audioNode *src,
     dest->s = src->s;
     dest->m = src->m;
     dest->pan = src->pan;
-    dest->stain = src->stain;
+    dest->outputBus = src->outputBus;
+    dest->mono = src->mono;
+    dest->id = src->id;
+    dest->isReturn = src->isReturn;
+    dest->returnID = src->returnID;
+    dest->sends = src->sends;
 
     if (src->isTrack) {
         dest->clips = src->clips;
@@ -92,12 +97,28 @@ void track::utility::copyNode(audioNode *dest, audioNode *src,
         dest->addPlugin(identifier);
         dest->plugins.back()->plugin->setStateInformation(pluginData.getData(),
                                                           pluginData.getSize());
+        dest->plugins.back()->id = p->id;
         dest->plugins.back()->bypassed = p->bypassed;
 
         dest->plugins.back()->dryWetMix = p->dryWetMix;
 
         dest->plugins.back()->relayParams = p->relayParams;
     }
+
+    dest->updateChannels();
+}
+
+void track::utility::resetNodeIDs(audioNode *node) {
+    node->id = -1;
+
+    for (auto &sp : node->plugins)
+        sp->id = -1;
+
+    for (auto &c : node->clips)
+        c.id = clip::getNewID();
+
+    for (auto &child : node->childNodes)
+        resetNodeIDs(&child);
 }
 
 void track::utility::getTrivialNodeData(TrivialNodeData *dest, audioNode *src) {
@@ -106,6 +127,8 @@ void track::utility::getTrivialNodeData(TrivialNodeData *dest, audioNode *src) {
     dest->m = src->m;
     dest->s = src->s;
     dest->pan = src->pan;
+    dest->outputBus = src->outputBus;
+    dest->mono = src->mono;
 }
 
 void track::utility::writeTrivialNodeDataToNode(audioNode *dest,
@@ -115,6 +138,12 @@ void track::utility::writeTrivialNodeDataToNode(audioNode *dest,
     dest->m = src.m;
     dest->s = src.s;
     dest->pan = src.pan;
+    dest->outputBus = src.outputBus;
+
+    if (dest->mono != src.mono) {
+        dest->mono = src.mono;
+        dest->updateChannels();
+    }
 }
 
 bool track::utility::isDescendant(audioNode *parent, audioNode *possibleChild,
@@ -134,82 +163,12 @@ bool track::utility::isDescendant(audioNode *parent, audioNode *possibleChild,
     return false;
 }
 
-void track::utility::reorderNodeAlt(std::vector<int> r1, std::vector<int> r2,
-                                    void *p) {
-
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
-    audioNode *src = utility::getNodeFromRoute(r1, p);
-    audioNode *adj = utility::getNodeFromRoute(r2, p);
-
-    jassert(src != nullptr);
-    jassert(adj != nullptr);
-
-    audioNode tmp;
-    utility::copyNode(&tmp, src, p);
-
-    if (r2.size() == 1) {
-        // invalid bounds check
-        jassert((size_t)r2.back() < processor->tracks.size());
-
-        audioNode &newNode =
-            *processor->tracks.emplace(processor->tracks.begin() + r2.back());
-
-        utility::copyNode(&newNode, &tmp, p);
-
-        // delete node
-        int deletionIndex = r1.back();
-
-        if (deletionIndex > r2.back())
-            ++deletionIndex;
-
-        processor->tracks.erase(processor->tracks.begin() + deletionIndex);
-    }
-
-    // if nested and siblings
-    if (r1.size() == r2.size() && r2.size() > 1) {
-        std::vector<int> insertionParentRoute = r2;
-        insertionParentRoute.resize(r2.size() - 1);
-
-        audioNode *parent = utility::getNodeFromRoute(insertionParentRoute, p);
-
-        // invalid bounds check
-        jassert((size_t)r2.back() < parent->childNodes.size());
-
-        audioNode &newNode =
-            *parent->childNodes.emplace(parent->childNodes.begin() + r2.back());
-
-        utility::copyNode(&newNode, &tmp, p);
-
-        // delete node
-        int deletionIndex = r1.back();
-
-        if (deletionIndex > r2.back())
-            ++deletionIndex;
-
-        parent->childNodes.erase(parent->childNodes.begin() + deletionIndex);
-    }
-}
-
 bool track::utility::isSibling(std::vector<int> r1, std::vector<int> r2) {
     r1.pop_back();
     r2.pop_back();
     return r1 == r2;
 }
 
-void track::utility::deleteNode(std::vector<int> route, void *p) {
-    jassert(route.size() > 0);
-
-    AudioPluginAudioProcessor *processor = (AudioPluginAudioProcessor *)p;
-
-    if (route.size() == 1) {
-        processor->tracks.erase(processor->tracks.begin() + route.back());
-        return;
-    }
-
-    audioNode *parent = utility::getParentFromRoute(route, p);
-    parent->childNodes.erase(parent->childNodes.begin() + route.back());
-}
-
 std::vector<track::audioNode *> track::utility::getFlattenedNodes(void *p) {
     std::vector<track::audioNode *> retval;
 
@@ -235,112 +194,12 @@ void track::utility::traverseAndFlattenNodes(std::vector<audioNode *> *vec,
     }
 }
 
-// RIP Keychron K6
-juce::String track::utility::resampledToHostSampleRate(juce::String path) {
-    track::clip retval;
-
-    bool forceWav = false;
-    // init reader
-    juce::AudioFormatManager afm;
-    afm.registerBasicFormats();
-    std::unique_ptr<juce::AudioFormatReader> reader(afm.createReaderFor(path));
-
-    juce::AudioFormat *fmt = nullptr;
-    juce::File originalFile = juce::File(path);
-
-    for (int i = 0; i < afm.getNumKnownFormats(); ++i) {
-        if (afm.getKnownFormat(i)->canHandleFile(originalFile)) {
-            fmt = afm.getKnownFormat(i);
-            break;
-        }
-    }
-    jassert(fmt != nullptr);
-    DBG("USING FORMAT: " << fmt->getFormatName());
-
-    if (fmt->getFormatName().containsIgnoreCase("mp3")) {
-        DBG("force wav = true");
-        forceWav = true;
-    }
-
-    // read original buffer
-    juce::AudioBuffer<float> originalBuffer = juce::AudioBuffer<float>(
-        (int)reader->numChannels, reader->lengthInSamples);
-
-    reader->read(&originalBuffer, 0, originalBuffer.getNumSamples(), 0, true,
-                 true);
-
-    // le juice
-    double ratio = reader->sampleRate / track::SAMPLE_RATE;
-    juce::AudioBuffer<float> resampledBuffer = juce::AudioBuffer<float>(
-        (int)reader->numChannels,
-        (int)((double)reader->lengthInSamples / ratio));
-
-    auto inputs = originalBuffer.getArrayOfReadPointers();
-    auto outputs = resampledBuffer.getArrayOfWritePointers();
-
-    DBG(reader->lengthInSamples << " samples became "
-                                << resampledBuffer.getNumSamples()
-                                << " samples with a ratio of " << ratio);
-
-    for (int ch = 0; ch < (int)reader->numChannels; ++ch) {
-        std::unique_ptr<juce::LagrangeInterpolator> resampler =
-            std::make_unique<juce::LagrangeInterpolator>();
-        resampler->reset();
-        resampler->process(ratio, inputs[ch], outputs[ch],
-                           resampledBuffer.getNumSamples());
-
-        DBG("resampled channel " << ch);
-    }
-
-    // now write resampled file
-    juce::File parentDir = originalFile.getParentDirectory();
-    juce::String originalFileName = originalFile.getFileName();
-
-    // because windows is stupid
-    char dirSep = '/';
-#if JUCE_WINDOWS
-    dirSep = '\\';
-#endif
-
-    // ex., /home/johnston/j35-44100hz.wav
-    juce::String resampledFilePath =
-        parentDir.getFullPathName() + dirSep +
-        originalFile.getFileNameWithoutExtension() + "-" +
-        juce::String(track::SAMPLE_RATE) + "hz" +
-        (forceWav ? ".wav" : originalFile.getFileExtension());
-
-    juce::File resampledFile = juce::File(resampledFilePath);
-    resampledFile.create();
-
-    std::unique_ptr<juce::AudioFormatWriter> writer;
-
-    if (forceWav) {
-        fmt = new juce::WavAudioFormat();
-    }
-
-    writer.reset(fmt->createWriterFor(
-        new juce::FileOutputStream(resampledFilePath), track::SAMPLE_RATE,
-        (unsigned int)reader->numChannels, (int)reader->bitsPerSample,
-        reader->metadataValues, 0));
-
-    jassert(writer != nullptr);
-
-    DBG("writing...");
-    writer->writeFromAudioSampleBuffer(resampledBuffer, 0,
-                                       resampledBuffer.getNumSamples());
-    writer->flush();
-    writer.reset();
-
-    DBG("written succesfully to " << resampledFilePath);
-
-    if (forceWav)
-        delete fmt;
-
-    return resampledFilePath;
-}
-
 void track::utility::reorderPlugin(int srcIndex, int destIndex,
                                    audioNode *node) {
+    AudioPluginAudioProcessor *processor =
+        (AudioPluginAudioProcessor *)node->processor;
+    const juce::ScopedLock sl(processor->getCallbackLock());
+
     // std::move is absolute magic how have i not known of this sooner
     std::unique_ptr<track::subplugin> plugin =
         std::move(node->plugins[(size_t)srcIndex]);
@@ -456,7 +315,7 @@ juce::String track::utility::prettyVector(std::vector<int> x) {
 bool track::utility::clipsEqual(track::clip x, track::clip y) {
     bool retval = true;
 
-    if (x.buffer != y.buffer)
+    if (x.buffer != y.buffer || x.source != y.source)
         retval = false;
     else if (!juce::approximatelyEqual(x.gain, y.gain))
         retval = false;
@@ -472,12 +331,15 @@ bool track::utility::clipsEqual(track::clip x, track::clip y) {
     return retval;
 }
 
-int track::utility::snapSample(int sample, int division, int offset) {
+int track::utility::snapSample(int sample, int division, void *p,
+                               int offset) {
+    engineContext &ctx = getContext(p);
+
     if (division == 0)
         division = 1;
 
-    double secondsPerBeat = 60.f / BPM;
-    int samplesPerBar = (secondsPerBeat * SAMPLE_RATE) * 4; // for 4/4
+    double secondsPerBeat = 60.f / ctx.bpm;
+    int samplesPerBar = (secondsPerBeat * ctx.sampleRate) * 4; // for 4/4
     int samplesPerSnap = samplesPerBar / division;
 
     int snapped = (((sample + samplesPerSnap / 2) / samplesPerSnap) + offset) *
@@ -498,10 +360,12 @@ std::vector<int> track::utility::rWithSize(std::vector<int> r, size_t s) {
     return retval;
 }
 
-void track::utility::setAutoGrid() {
-    if (track::AUTO_GRID) {
+void track::utility::setAutoGrid(void *p) {
+    engineContext &ctx = getContext(p);
+
+    if (ctx.autoGrid) {
         // set grid depending on UI zoom muls
-        int snap = UI_ZOOM_MULTIPLIER / 10;
+        int snap = ctx.zoomMultiplier / 10;
 
         // round to nearest power of 2
         snap--;
@@ -512,7 +376,7 @@ void track::utility::setAutoGrid() {
         snap |= snap >> 16;
         snap++;
 
-        SNAP_DIVISION = snap;
+        ctx.snapDivision = snap;
     }
 }
 
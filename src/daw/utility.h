@@ -28,20 +28,19 @@ inline audioNode *getNodeFromRoute(const std::vector<int> &route, void *p) {
 }
 audioNode *getParentFromRoute(std::vector<int> route, void *p);
 audioNode *findDuplicate(audioNode *parent, audioNode *src);
+// keeps src's ids. if src is still in the tree when the copy goes in,
+// AudioPluginAudioProcessor::insertNode() hands the copy new ones
 void copyNode(audioNode *dest, audioNode *src, void *processor);
+void resetNodeIDs(audioNode *node); // for it and everything inside it
 void getTrivialNodeData(TrivialNodeData *dest, audioNode *src);
 void writeTrivialNodeDataToNode(audioNode *dest, TrivialNodeData src);
 
-void reorderNodeAlt(std::vector<int> r1, std::vector<int> r2, void *p);
 bool isSibling(std::vector<int> r1, std::vector<int> r2);
-void deleteNode(std::vector<int> route, void *p);
 
 std::vector<audioNode *> getFlattenedNodes(void *p);
 void traverseAndFlattenNodes(std::vector<audioNode *> *vec, audioNode *parent,
                              void *p);
 
-juce::String resampledToHostSampleRate(juce::String path);
-
 // plugins
 void reorderPlugin(int srcIndex, int destIndex, audioNode *node);
 void closeOpenedEditors(std::vector<int> nodeRoute,
@@ -61,12 +60,12 @@ void openRelayParamWindows(std::vector<int> nodeRoute,
 void clearSubwindows(void *e);
 
 bool clipsEqual(track::clip x, track::clip y);
-int snapSample(int sample, int division, int offset = 0);
+int snapSample(int sample, int division, void *p, int offset = 0);
 
 std::vector<int> rWithPopBack(std::vector<int> r);
 std::vector<int> rWithSize(std::vector<int> r, size_t s);
 
-void setAutoGrid();
+void setAutoGrid(void *p);
 
 // ui
 void gloss(juce::Graphics &g, juce::Rectangle<int> b, juce::Colour c,
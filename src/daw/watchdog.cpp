@@ -0,0 +1,65 @@
+#include "watchdog.h"
+#include "../processor.h"
+#include "track.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+// also held while a stuck plugin is being marked, so unwatch() (and with it
+// the subplugin's destructor) waits for that to finish
+juce::CriticalSection &getRegistryLock() {
+    static juce::CriticalSection lock;
+    return lock;
+}
+
+std::vector<track::subplugin *> &getRegistry() {
+    static std::vector<track::subplugin *> plugins;
+    return plugins;
+}
+} // namespace
+
+track::PluginWatchdog::PluginWatchdog() : juce::Thread("plugin watchdog") {
+    startThread(juce::Thread::Priority::low);
+}
+
+track::PluginWatchdog::~PluginWatchdog() { stopThread(1000); }
+
+void track::PluginWatchdog::watch(subplugin *sp) {
+    const juce::ScopedLock sl(getRegistryLock());
+    getRegistry().push_back(sp);
+}
+
+void track::PluginWatchdog::unwatch(subplugin *sp) {
+    const juce::ScopedLock sl(getRegistryLock());
+    auto &plugins = getRegistry();
+    plugins.erase(std::remove(plugins.begin(), plugins.end(), sp),
+                  plugins.end());
+}
+
+void track::PluginWatchdog::run() {
+    while (!threadShouldExit()) {
+        juce::int64 now = juce::Time::getHighResolutionTicks();
+
+        {
+            const juce::ScopedLock sl(getRegistryLock());
+
+            for (subplugin *sp : getRegistry()) {
+                juce::int64 deadline =
+                    sp->deadline.load(std::memory_order_acquire);
+                if (deadline == 0 || now < deadline || sp->faulted)
+                    continue;
+
+                // nothing gets the audio thread back out of the plugin, but
+                // it's skipped from the moment it does return. only the flags
+                // are set here; everything else about the fault is left to the
+                // audio thread. the processor is alive for as long as one of
+                // its plugins is being called
+                sp->faulted = true;
+                ((AudioPluginAudioProcessor *)sp->processor)->pluginFaulted =
+                    true;
+            }
+        }
+
+        wait(intervalMs);
+    }
+}
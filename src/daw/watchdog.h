@@ -0,0 +1,27 @@
+#pragma once
+#include <JuceHeader.h>
+
+namespace track {
+class subplugin;
+
+// catches plugins that get stuck in processBlock(). the audio thread can only
+// time a call once it's returned, so a call that never does would otherwise
+// never be noticed. this looks at subplugin::deadline from the outside and
+// marks the plugin faulted as soon as it's passed, which the editor picks up
+// without waiting for the audio thread. one thread for the whole process;
+// every processor holds a SharedResourcePointer to it
+class PluginWatchdog : private juce::Thread {
+  public:
+    PluginWatchdog();
+    ~PluginWatchdog() override;
+
+    static constexpr int intervalMs = 10;
+
+    // every subplugin registers itself for as long as it exists
+    static void watch(subplugin *sp);
+    static void unwatch(subplugin *sp);
+
+  private:
+    void run() override;
+};
+} // namespace track
@@ -3,11 +3,14 @@
 #include "daw/clipboard.h"
 #include "daw/defs.h"
 #include "daw/plugin_chain.h"
+#include "daw/resampler.h"
 #include "daw/timeline.h"
+#include "daw/trace.h"
 #include "daw/track.h"
 #include "daw/utility.h"
 #include "lookandfeel.h"
 #include "processor.h"
+#include <array>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
@@ -21,7 +24,10 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
 
     juce::ignoreUnused(processorRef);
 
-    // listen for messages from processor (for un/redoable actions UI updates)
+    // listen for messages from processor (for un/redoable actions UI updates).
+    // anything queued while there was no editor is covered by building the ui
+    // from scratch below
+    processorRef.guiQueue.clear();
     processorRef.addChangeListener(this);
 
     // sizing
@@ -32,6 +38,7 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
     // TimelineViewport holds TimelineComponent
     timelineComponent->viewport = &timelineViewport;
     timelineComponent->processorRef = &processorRef;
+    timelineComponent->barNumbers.processorRef = &processorRef;
     timelineViewport.setViewedComponent(timelineComponent.get(), true);
     timelineViewport.setBounds(track::UI_TRACK_WIDTH, 55,
                                getWidth() - track::UI_TRACK_WIDTH, 665);
@@ -65,7 +72,8 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
 
     startTimerHz(20);
 
-    int tcHeight = processorRef.tracks.size() * (size_t)track::UI_TRACK_HEIGHT;
+    int tcHeight =
+        processorRef.tracks.size() * (size_t)processorRef.context.trackHeight;
     timelineComponent->setSize(
         4000, juce::jmax(tcHeight, timelineViewport.getHeight()) - 4);
 
@@ -95,6 +103,31 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
 #define MENU_WRITE_STATE_FROM_CLIPBOARD 12
 #define MENU_WRITE_STATE_FROM_FILE 13
 #define MENU_TAKE_SCREENSHOT 14
+#define MENU_RECORDING_STATS 15
+#define MENU_RECORDING_FIFO_5S 16
+#define MENU_RECORDING_FIFO_30S 17
+#define MENU_RECORDING_FIFO_120S 18
+#define MENU_RECORDING_FIFO_600S 19
+#define MENU_TELEMETRY_OFF 20
+#define MENU_TELEMETRY_PORT 21
+#define MENU_REMOTE_OFF 22
+#define MENU_REMOTE_PORT 23
+#define MENU_TRACE_RECORD 24
+#define MENU_TRACE_SAVE 25
+#define MENU_CLIP_STORAGE_DECODED 26
+#define MENU_CLIP_STORAGE_MAPPED 27
+#define MENU_CLIP_STORAGE_PACKED 28
+// the rest of the engine settings are picked from lists; item id is the
+// base plus the index into the list
+#define MENU_RENDER_BLOCK_SIZE 100
+#define MENU_PLUGIN_BLOCK_SIZE 200
+#define MENU_PLUGIN_WATCHDOG 300
+
+        static const std::array<int, 5> renderBlockSizes = {128, 256, 512,
+                                                            1024, 2048};
+        static const std::array<int, 6> pluginBlockSizes = {0,   32,  64,
+                                                            128, 256, 512};
+        static const std::array<int, 4> watchdogBlocks = {0, 4, 16, 64};
 
         contextMenu.addItem(MENU_PLUGIN_SCAN, "Scan plugins");
         contextMenu.addItem(MENU_PLUGIN_LAZY_SCAN, "Lazy scan for plugins");
@@ -104,6 +137,102 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
                             "Open relay params inspector");
         contextMenu.addSeparator();
         contextMenu.addItem(MENU_UPDATE_LATENCY, "Update latency");
+
+        // fifo between the audio thread and the disk writer. can't be
+        // resized mid-take
+        juce::PopupMenu recordingMenu;
+        bool canResize = !processorRef.recorder.isRecording();
+        double fifoSeconds = processorRef.recorder.fifoSeconds;
+        recordingMenu.addItem(MENU_RECORDING_FIFO_5S, "5 second buffer",
+                              canResize,
+                              juce::approximatelyEqual(fifoSeconds, 5.0));
+        recordingMenu.addItem(MENU_RECORDING_FIFO_30S, "30 second buffer",
+                              canResize,
+                              juce::approximatelyEqual(fifoSeconds, 30.0));
+        recordingMenu.addItem(MENU_RECORDING_FIFO_120S, "120 second buffer",
+                              canResize,
+                              juce::approximatelyEqual(fifoSeconds, 120.0));
+        recordingMenu.addItem(MENU_RECORDING_FIFO_600S, "600 second buffer",
+                              canResize,
+                              juce::approximatelyEqual(fifoSeconds, 600.0));
+        recordingMenu.addSeparator();
+        recordingMenu.addItem(MENU_RECORDING_STATS, "Show buffer stats");
+        contextMenu.addSubMenu("Recording", recordingMenu);
+
+        // osc to localhost; see track::Telemetry for what gets sent
+        juce::PopupMenu telemetryMenu;
+        int telemetryPort = processorRef.telemetry.getPort();
+        telemetryMenu.addItem(MENU_TELEMETRY_OFF, "Off", true,
+                              telemetryPort == 0);
+        telemetryMenu.addItem(MENU_TELEMETRY_PORT,
+                              telemetryPort == 0
+                                  ? juce::String("Send to port...")
+                                  : "Sending to port " +
+                                        juce::String(telemetryPort) + "...",
+                              true, telemetryPort != 0);
+        contextMenu.addSubMenu("Telemetry", telemetryMenu);
+
+        // osc server; see track::RemoteControl for the addresses
+        juce::PopupMenu remoteMenu;
+        int remotePort = processorRef.remote.getPort();
+        remoteMenu.addItem(MENU_REMOTE_OFF, "Off", true, remotePort == 0);
+        remoteMenu.addItem(MENU_REMOTE_PORT,
+                           remotePort == 0
+                               ? juce::String("Listen on port...")
+                               : "Listening on port " +
+                                     juce::String(remotePort) + "...",
+                           true, remotePort != 0);
+        contextMenu.addSubMenu("Remote control", remoteMenu);
+
+        // timelines of every thread, for chrome://tracing or perfetto
+        juce::PopupMenu traceMenu;
+        traceMenu.addItem(MENU_TRACE_RECORD, "Record", true,
+                          track::trace::isEnabled());
+        traceMenu.addItem(MENU_TRACE_SAVE, "Save trace...");
+        contextMenu.addSubMenu("Trace", traceMenu);
+
+        // project settings that used to only be changeable by editing the
+        // saved state
+        track::engineContext &ctx = processorRef.context;
+        juce::PopupMenu engineMenu;
+        engineMenu.addSectionHeader("Render block size");
+        for (size_t i = 0; i < renderBlockSizes.size(); ++i) {
+            engineMenu.addItem(MENU_RENDER_BLOCK_SIZE + (int)i,
+                               juce::String(renderBlockSizes[i]) + " samples",
+                               true,
+                               ctx.maxRenderBlockSize == renderBlockSizes[i]);
+        }
+
+        engineMenu.addSectionHeader("Fixed plugin block size");
+        for (size_t i = 0; i < pluginBlockSizes.size(); ++i) {
+            engineMenu.addItem(
+                MENU_PLUGIN_BLOCK_SIZE + (int)i,
+                pluginBlockSizes[i] == 0
+                    ? juce::String("Off")
+                    : juce::String(pluginBlockSizes[i]) + " samples",
+                true, ctx.fixedPluginBlockSize == pluginBlockSizes[i]);
+        }
+
+        engineMenu.addSectionHeader("Plugin watchdog");
+        for (size_t i = 0; i < watchdogBlocks.size(); ++i) {
+            engineMenu.addItem(
+                MENU_PLUGIN_WATCHDOG + (int)i,
+                watchdogBlocks[i] == 0
+                    ? juce::String("Off")
+                    : "Bypass after " + juce::String(watchdogBlocks[i]) +
+                          " late blocks",
+                true, ctx.pluginWatchdogBlocks == watchdogBlocks[i]);
+        }
+
+        engineMenu.addSectionHeader("Clip storage");
+        engineMenu.addItem(MENU_CLIP_STORAGE_DECODED, "Decode into memory",
+                           true, ctx.storage == track::clipStorage::decoded);
+        engineMenu.addItem(MENU_CLIP_STORAGE_MAPPED, "Read from disk", true,
+                           ctx.storage == track::clipStorage::mapped);
+        engineMenu.addItem(MENU_CLIP_STORAGE_PACKED, "Keep packed in memory",
+                           true, ctx.storage == track::clipStorage::packed);
+        contextMenu.addSubMenu("Engine", engineMenu);
+
         contextMenu.addSeparator();
         contextMenu.addItem(
             MENU_UNDO,
@@ -155,6 +284,151 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
                 repaint();
             }
 
+            else if (result == MENU_RECORDING_FIFO_5S ||
+                     result == MENU_RECORDING_FIFO_30S ||
+                     result == MENU_RECORDING_FIFO_120S ||
+                     result == MENU_RECORDING_FIFO_600S) {
+                double seconds = 30.0;
+                if (result == MENU_RECORDING_FIFO_5S)
+                    seconds = 5.0;
+                else if (result == MENU_RECORDING_FIFO_120S)
+                    seconds = 120.0;
+                else if (result == MENU_RECORDING_FIFO_600S)
+                    seconds = 600.0;
+
+                processorRef.recorder.fifoSeconds = seconds;
+                processorRef.recorder.prepare(processorRef.context.sampleRate);
+                processorRef.recorder.resetCounters();
+            }
+
+            else if (result == MENU_RECORDING_STATS) {
+                track::Recorder &r = processorRef.recorder;
+
+                juce::String stats =
+                    "Buffer size: " + juce::String(r.getFifoSize()) +
+                    " samples (" + juce::String(r.fifoSeconds) + "s)\n" +
+                    "Peak usage: " + juce::String(r.peakFifoUsage.load()) +
+                    " samples\n" + "Overruns: " +
+                    juce::String(r.overruns.load()) + "\n" +
+                    "Dropped samples: " +
+                    juce::String(r.droppedSamples.load()) + "\n\n" +
+                    "Recordings are saved to " +
+                    r.getRecordingsDirectory().getFullPathName();
+
+                juce::NativeMessageBox::showMessageBoxAsync(
+                    juce::MessageBoxIconType::InfoIcon, "Recording", stats);
+            }
+
+            else if (result == MENU_TELEMETRY_OFF) {
+                processorRef.telemetry.setPort(0);
+                processorRef.requireSaving();
+            }
+
+            else if (result == MENU_TELEMETRY_PORT) {
+                askForPort("Telemetry",
+                           "Send engine metrics as OSC to localhost on",
+                           processorRef.telemetry.getPort(), 9000,
+                           [this](int port) {
+                               processorRef.telemetry.setPort(port);
+                               return processorRef.telemetry.getPort() != 0;
+                           });
+            }
+
+            else if (result == MENU_REMOTE_OFF) {
+                processorRef.remote.setPort(0);
+                processorRef.requireSaving();
+            }
+
+            else if (result == MENU_REMOTE_PORT) {
+                askForPort("Remote control", "Listen for OSC on",
+                           processorRef.remote.getPort(), 8000,
+                           [this](int port) {
+                               processorRef.remote.setPort(port);
+                               return processorRef.remote.getPort() != 0;
+                           });
+            }
+
+            else if (result == MENU_TRACE_RECORD) {
+                track::trace::setEnabled(!track::trace::isEnabled());
+            }
+
+            else if (result == MENU_TRACE_SAVE) {
+                fileChooser = std::make_unique<juce::FileChooser>(
+                    "Save trace",
+                    juce::File::getSpecialLocation(
+                        juce::File::SpecialLocationType::userDesktopDirectory)
+                        .getChildFile("track-trace.json"),
+                    "*.json");
+
+                auto flags = juce::FileBrowserComponent::saveMode |
+                             juce::FileBrowserComponent::canSelectFiles |
+                             juce::FileBrowserComponent::
+                                 warnAboutOverwriting;
+
+                fileChooser->launchAsync(
+                    flags, [](const juce::FileChooser &c) {
+                        juce::File f = c.getResult();
+                        if (f == juce::File())
+                            return;
+
+                        if (!track::trace::dump(f)) {
+                            juce::NativeMessageBox::showMessageBoxAsync(
+                                juce::MessageBoxIconType::WarningIcon,
+                                "Trace",
+                                "Nothing was recorded, or " +
+                                    f.getFullPathName() +
+                                    " couldn't be written");
+                        }
+                    });
+            }
+
+            else if (result >= MENU_RENDER_BLOCK_SIZE &&
+                     result < MENU_RENDER_BLOCK_SIZE +
+                                  (int)renderBlockSizes.size()) {
+                processorRef.context.maxRenderBlockSize =
+                    renderBlockSizes[(size_t)(result - MENU_RENDER_BLOCK_SIZE)];
+                processorRef.applyRenderSettings();
+                latencyPoller.updateLastKnownLatency();
+                processorRef.requireSaving();
+                repaint();
+            }
+
+            else if (result >= MENU_PLUGIN_BLOCK_SIZE &&
+                     result < MENU_PLUGIN_BLOCK_SIZE +
+                                  (int)pluginBlockSizes.size()) {
+                processorRef.context.fixedPluginBlockSize =
+                    pluginBlockSizes[(size_t)(result - MENU_PLUGIN_BLOCK_SIZE)];
+                processorRef.applyRenderSettings();
+                latencyPoller.updateLastKnownLatency();
+                processorRef.requireSaving();
+                repaint();
+            }
+
+            else if (result >= MENU_PLUGIN_WATCHDOG &&
+                     result <
+                         MENU_PLUGIN_WATCHDOG + (int)watchdogBlocks.size()) {
+                // read every block, so there's nothing to re-prepare
+                processorRef.context.pluginWatchdogBlocks =
+                    watchdogBlocks[(size_t)(result - MENU_PLUGIN_WATCHDOG)];
+                processorRef.requireSaving();
+            }
+
+            else if (result == MENU_CLIP_STORAGE_DECODED ||
+                     result == MENU_CLIP_STORAGE_MAPPED ||
+                     result == MENU_CLIP_STORAGE_PACKED) {
+                track::clipStorage storage = track::clipStorage::decoded;
+                if (result == MENU_CLIP_STORAGE_MAPPED)
+                    storage = track::clipStorage::mapped;
+                else if (result == MENU_CLIP_STORAGE_PACKED)
+                    storage = track::clipStorage::packed;
+
+                if (storage != processorRef.context.storage) {
+                    processorRef.context.storage = storage;
+                    processorRef.reloadClips();
+                    processorRef.requireSaving();
+                }
+            }
+
             else if (result == MENU_OPEN_RELAY_PARAMS_INSPECTOR) {
                 openRelayParamInspector();
             }
@@ -208,8 +482,8 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
                             clipPropertiesWindows.clear();
                             pluginEditorWindows.clear();
 
-                            timelineComponent->clipComponents.clear();
-                            tracklist.trackComponents.clear();
+                            timelineComponent->clearClipComponents();
+                            tracklist.rows.clear();
                             processorRef.undoManager.clearUndoHistory();
 
                             juce::String xmlText =
@@ -225,9 +499,7 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
                             timelineComponent->clipComponentsUpdated = false;
                             timelineComponent->updateClipComponents();
 
-                            tracklist.trackComponents.clear();
                             tracklist.createTrackComponents();
-                            tracklist.setTrackComponentBounds();
 
                             timelineComponent->updateClipComponents();
                             timelineComponent->repaint();
@@ -259,8 +531,8 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
                         clipPropertiesWindows.clear();
                         pluginEditorWindows.clear();
 
-                        timelineComponent->clipComponents.clear();
-                        tracklist.trackComponents.clear();
+                        timelineComponent->clearClipComponents();
+                        tracklist.rows.clear();
                         processorRef.undoManager.clearUndoHistory();
 
                         DBG("launched...");
@@ -282,9 +554,7 @@ AudioPluginAudioProcessorEditor::AudioPluginAudioProcessorEditor(
                         timelineComponent->clipComponentsUpdated = false;
                         timelineComponent->updateClipComponents();
 
-                        tracklist.trackComponents.clear();
                         tracklist.createTrackComponents();
-                        tracklist.setTrackComponentBounds();
 
                         timelineComponent->updateClipComponents();
                         timelineComponent->repaint();
@@ -351,7 +621,7 @@ AudioPluginAudioProcessorEditor::~AudioPluginAudioProcessorEditor() {
     processorRef.removeChangeListener(this);
 
     setLookAndFeel(nullptr);
-    track::clipboard::releaseResources();
+    processorRef.clipboard.releaseResources();
 }
 
 void AudioPluginAudioProcessorEditor::paint(juce::Graphics &g) {
@@ -419,16 +689,18 @@ void AudioPluginAudioProcessorEditor::paint(juce::Graphics &g) {
         AudioProcessor::getWrapperTypeDescription(processorRef.wrapperType);
     audioInfoText += " ";
 
-    audioInfoText += juce::String(track::SAMPLE_RATE / 1000);
+    audioInfoText += juce::String(processorRef.context.sampleRate / 1000);
     audioInfoText += "kHz ";
-    audioInfoText += juce::String(track::SAMPLES_PER_BLOCK);
+    audioInfoText += juce::String(processorRef.context.samplesPerBlock);
 
     audioInfoText += "spls ";
     if (latencyPoller.knownLatencySamples == -1)
         audioInfoText += "-";
     else {
         int latencyMs = std::round(
-            (latencyPoller.knownLatencySamples / track::SAMPLE_RATE) * 1000.f);
+            (latencyPoller.knownLatencySamples /
+             processorRef.context.sampleRate) *
+            1000.f);
         audioInfoText += latencyMs;
         audioInfoText += "ms";
     }
@@ -458,16 +730,29 @@ void AudioPluginAudioProcessorEditor::resized() {
 
 void AudioPluginAudioProcessorEditor::changeListenerCallback(
     ChangeBroadcaster * /*source*/) {
+    flushGUIInstructions();
+}
 
-    track::uiinstruction x = processorRef.GUIInstruction;
+void AudioPluginAudioProcessorEditor::flushGUIInstructions() {
+    // handlers can dispatch more instructions; those go into a fresh queue
+    for (const track::uiinstruction &x : processorRef.guiQueue.take())
+        handleGUIInstruction(x);
+}
 
+void AudioPluginAudioProcessorEditor::rebindComponents() {
+    tracklist.rebindTrackComponents();
+    timelineComponent->rebindClipComponents();
+}
+
+void AudioPluginAudioProcessorEditor::handleGUIInstruction(
+    const track::uiinstruction &x) {
     if (x.command == UI_INSTRUCTION_UPDATE_CORE) {
-        timelineComponent->clipComponents.clear();
-        tracklist.trackComponents.clear();
+        // an armed track might've been deleted
+        processorRef.updateRecordArmed();
 
+        // neither track nor clip components get recreated; they're diffed
+        // against the new layout
         tracklist.createTrackComponents();
-        tracklist.setTrackComponentBounds();
-        tracklist.clearStains();
 
         timelineComponent->updateClipComponents();
     }
@@ -475,7 +760,7 @@ void AudioPluginAudioProcessorEditor::changeListenerCallback(
     else if (x.command == UI_INSTRUCTION_MARK_CC_STALE) {
         track::clip *c = (track::clip *)x.metadata;
         for (auto &cc : timelineComponent->clipComponents) {
-            if (cc->correspondingClip == c) {
+            if (cc->clipID == c->id) {
                 cc->stale = true;
             }
         }
@@ -487,9 +772,8 @@ void AudioPluginAudioProcessorEditor::changeListenerCallback(
     }
 
     else if (x.command == UI_INSTRUCTION_RESIZE_CLIP_COMPONENTS) {
-        for (auto &cc : timelineComponent->clipComponents) {
-            timelineComponent->resizeClipComponent(cc.get());
-        }
+        // clips might've moved into or out of view
+        timelineComponent->updateVisibleClipComponents();
     }
 
     else if (x.command == UI_INSTRUCTION_RECREATE_ALL_PNCS) {
@@ -527,18 +811,11 @@ void AudioPluginAudioProcessorEditor::changeListenerCallback(
     }
 
     else if (x.command == UI_INSTRUCTION_UPDATE_CLIP_COMPONENTS) {
-        bool queueUpdate = (bool)x.metadata;
-
-        if (queueUpdate)
-            clipComponentsPendingUpdate = true;
-        else
-            timelineComponent->updateClipComponents();
+        timelineComponent->updateClipComponents();
     }
 
     else if (x.command == UI_INSTRUCTION_UPDATE_NODE_COMPONENTS) {
-        tracklist.trackComponents.clear();
         tracklist.createTrackComponents();
-        tracklist.setTrackComponentBounds();
         tracklist.repaint();
     }
 
@@ -569,8 +846,8 @@ void AudioPluginAudioProcessorEditor::changeListenerCallback(
         tracklist.setTrackComponentBounds();
         trackViewport.repaint();
 
-        int tcHeight = (tracklist.trackComponents.size() + 2) *
-                       (size_t)track::UI_TRACK_HEIGHT;
+        int tcHeight =
+            (tracklist.getNumRows() + 2) * processorRef.context.trackHeight;
         timelineComponent->setSize(timelineComponent->getWidth(),
                                    juce::jmax(tcHeight, this->getHeight()));
         timelineComponent->resized();
@@ -753,6 +1030,48 @@ void AudioPluginAudioProcessorEditor::closeAllFxChainsWithRoute(
     }
 }
 
+void AudioPluginAudioProcessorEditor::askForPort(
+    juce::String title, juce::String message, int currentPort,
+    int defaultPort, std::function<bool(int)> setPort) {
+    auto *w = new juce::AlertWindow(title, message,
+                                    juce::MessageBoxIconType::NoIcon, this);
+
+    w->addTextEditor(
+        "port", juce::String(currentPort == 0 ? defaultPort : currentPort),
+        "Port");
+    w->addButton("OK", 1, juce::KeyPress(juce::KeyPress::returnKey));
+    w->addButton("Cancel", 0, juce::KeyPress(juce::KeyPress::escapeKey));
+
+    // the window's still around in here; it's deleted once this returns
+    w->enterModalState(
+        true,
+        juce::ModalCallbackFunction::create([this, w, title, setPort](int r) {
+            if (r != 1)
+                return;
+
+            int port = w->getTextEditorContents("port").getIntValue();
+            if (port <= 0 || port > 65535)
+                return;
+
+            bool ok = setPort(port);
+            processorRef.requireSaving();
+
+            if (!ok) {
+                juce::NativeMessageBox::showMessageBoxAsync(
+                    juce::MessageBoxIconType::WarningIcon, title,
+                    "Couldn't use port " + juce::String(port));
+            }
+        }),
+        true);
+}
+
+void AudioPluginAudioProcessorEditor::updatePluginChains() {
+    for (auto &pcc : pluginChainComponents) {
+        pcc->nodesWrapper.updateExistingPluginNodeComponents();
+        pcc->nodesWrapper.repaint();
+    }
+}
+
 void AudioPluginAudioProcessorEditor::openPluginEditorWindow(
     std::vector<int> route, int pluginIndex) {
     timelineComponent
@@ -886,22 +1205,14 @@ bool AudioPluginAudioProcessorEditor::keyStateChanged(bool isKeyDown) {
     if (isKeyDown) {
         // ctrl+z
         if (juce::KeyPress::isKeyCurrentlyDown(90)) {
-            // this is temporary; in the future, implement a toast
-            // system that tells the user smth "please wait, clips are still
-            // rendering..." or smth idk bro i'm vibing to south arcade now,
-            // bleed out bangs
-            //
-            // future john here: NOPE
-            if (!timelineComponent->renderingWaveforms())
-                processorRef.undoManager.undo();
+            processorRef.undoManager.undo();
 
             return true;
         }
 
         // ctrl+y
         else if (juce::KeyPress::isKeyCurrentlyDown(89)) {
-            if (!timelineComponent->renderingWaveforms())
-                processorRef.undoManager.redo();
+            processorRef.undoManager.redo();
 
             return true;
         }
@@ -922,11 +1233,56 @@ void AudioPluginAudioProcessorEditor::handleSampleRateMismatch(
             .withTitle("Sample rate mismatch")
             .withMessage(msg)
 
-            .withButton("Resample all clips")
+            .withButton("Resample clips in realtime")
+            .withButton("Resample all clip files")
             .withButton("Cancel"),
 
         [this, oldSampleRate](int result) {
+            // clips already play back at the right speed since they carry
+            // their own rate; only their positions need to be moved over
             if (result == 0) {
+                double rate = processorRef.context.sampleRate;
+                double ratio = rate / oldSampleRate;
+                std::vector<track::audioNode *> nodes =
+                    track::utility::getFlattenedNodes(&processorRef);
+
+                // building a filter allocates, so they're all found (or
+                // built) before taking the lock, which only swaps them in
+                std::vector<std::shared_ptr<const track::polyphaseTable>>
+                    tables;
+                for (track::audioNode *node : nodes) {
+                    for (track::clip &c : node->clips) {
+                        bool resample =
+                            c.sampleRate > 0.0 && rate > 0.0 &&
+                            !juce::approximatelyEqual(c.sampleRate, rate);
+                        tables.push_back(
+                            resample ? track::resampler::getPlaybackTable(
+                                           c.sampleRate, rate)
+                                     : nullptr);
+                    }
+                }
+
+                {
+                    const juce::ScopedLock sl(processorRef.getCallbackLock());
+                    size_t t = 0;
+
+                    for (track::audioNode *node : nodes) {
+                        for (track::clip &c : node->clips) {
+                            c.startPositionSample =
+                                (int)(c.startPositionSample * ratio);
+                            c.trimLeft = (int)(c.trimLeft * ratio);
+                            c.trimRight = (int)(c.trimRight * ratio);
+                            c.hostSampleRate = rate;
+                            std::swap(c.playbackTable, tables[t++]);
+                        }
+                    }
+                }
+
+                processorRef.requireSaving();
+                processorRef.dispatchGUIInstruction(UI_INSTRUCTION_UPDATE_CORE);
+            }
+
+            else if (result == 1) {
                 std::vector<track::audioNode *> nodes =
                     track::utility::getFlattenedNodes(&processorRef);
 
@@ -944,15 +1300,28 @@ void AudioPluginAudioProcessorEditor::handleSampleRateMismatch(
 
                         track::clip *unsampledClip = &node->clips[j];
 
-                        juce::String resampledPath =
-                            track::utility::resampledToHostSampleRate(
-                                unsampledClip->path);
+                        // copy over data (and multiply with ratio)
+                        double ratio =
+                            processorRef.context.sampleRate / oldSampleRate;
+
+                        // conversion happens on the importer's pool; the
+                        // clip stays a placeholder until it's done
+                        // the cache path comes from hashing the whole file,
+                        // so the importer works that out too
+                        // a clip that's already a resampled copy goes back
+                        // to its original rather than being resampled twice
+                        track::importRequest r;
+                        r.sourcePath = unsampledClip->path;
+                        if (unsampledClip->sourcePath.isNotEmpty() &&
+                            juce::File(unsampledClip->sourcePath)
+                                .existsAsFile())
+                            r.sourcePath = unsampledClip->sourcePath;
+                        r.lengthInSamples = unsampledClip->getNumSamples();
+                        r.resample = true;
 
                         track::clip &resampledClip = newClips.emplace_back();
-                        resampledClip.path = resampledPath;
-
-                        // copy over data (and multiply with ratio)
-                        double ratio = track::SAMPLE_RATE / oldSampleRate;
+                        resampledClip.id = track::clip::getNewID();
+                        resampledClip.path = r.sourcePath;
                         resampledClip.startPositionSample =
                             unsampledClip->startPositionSample * ratio;
                         resampledClip.trimLeft =
@@ -964,10 +1333,14 @@ void AudioPluginAudioProcessorEditor::handleSampleRateMismatch(
                         resampledClip.name = unsampledClip->name;
                         resampledClip.active = unsampledClip->active;
 
-                        resampledClip.updateBuffer();
+                        r.clipIDs.push_back(resampledClip.id);
+                        processorRef.importer.queueDecode(r);
                     }
 
-                    node->clips = newClips;
+                    // the old clips (and their audio) go with newClips,
+                    // outside the lock
+                    const juce::ScopedLock sl(processorRef.getCallbackLock());
+                    std::swap(node->clips, newClips);
                 }
 
                 processorRef.dispatchGUIInstruction(UI_INSTRUCTION_UPDATE_CORE);
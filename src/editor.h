@@ -48,6 +48,15 @@ class AudioPluginAudioProcessorEditor : public juce::AudioProcessorEditor,
     void resized() override;
 
     void changeListenerCallback(ChangeBroadcaster *source) override;
+    void handleGUIInstruction(const track::uiinstruction &x);
+
+    // handles whatever the processor queued up; runs every frame and
+    // whenever an instruction can't wait
+    void flushGUIInstructions();
+
+    // points the track and clip components at the nodes and clips as they
+    // are right now, without rebuilding anything
+    void rebindComponents();
 
     // scanning
     juce::AudioPluginFormatManager apfm;
@@ -112,25 +121,45 @@ class AudioPluginAudioProcessorEditor : public juce::AudioProcessorEditor,
     std::vector<track::subplugin *> tmpOpenedRMCs;
 
     void timerCallback() override {
-        transportStatus.repaint();
+        transportStatus.updateDisplay();
         playhead.updateBounds();
 
-        if (clipComponentsPendingUpdate) {
-            if (!timelineComponent->renderingWaveforms()) {
-                timelineComponent->updateClipComponents();
-                clipComponentsPendingUpdate = false;
+        // keep "DECODING"/"RESAMPLING" placeholders up to date
+        if (processorRef.importer.isBusy()) {
+            for (auto &cc : timelineComponent->clipComponents) {
+                if (cc->correspondingClip != nullptr &&
+                    !cc->correspondingClip->isLoaded())
+                    cc->repaint();
             }
         }
+
+        // a plugin faulted on the audio thread
+        if (processorRef.pluginFaulted.exchange(false))
+            updatePluginChains();
+
+        // a control surface changed something
+        if (processorRef.remoteChanged.exchange(false)) {
+            processorRef.dispatchGUIInstruction(
+                UI_INSTRUCTION_UPDATE_EXISTING_NODE_COMPONENTS);
+            updatePluginChains();
+        }
     }
 
-    bool keyStateChanged(bool isKeyDown) override;
+    void updatePluginChains();
+
+    // prompts for a port number. setPort returns false if it couldn't use it
+    void askForPort(juce::String title, juce::String message, int currentPort,
+                    int defaultPort, std::function<bool(int)> setPort);
 
-    bool clipComponentsPendingUpdate = false;
+    bool keyStateChanged(bool isKeyDown) override;
 
     void handleSampleRateMismatch(double oldSampleRate);
 
     void takeScreenshot();
 
+    // last, so it stops before anything it flushes into goes away
+    juce::VBlankAttachment guiFlush{this, [this] { flushGUIInstructions(); }};
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(
         AudioPluginAudioProcessorEditor)
 };
@@ -1,20 +1,42 @@
 #include "processor.h"
 #include "daw/automation_relay.h"
 #include "daw/defs.h"
+#include "daw/diskcache.h"
+#include "daw/trace.h"
 #include "daw/track.h"
+#include "daw/utility.h"
 #include "editor.h"
+#include <functional>
+#include <map>
+#include <set>
+
+namespace {
+juce::AudioProcessor::BusesProperties getBusesProperties() {
+    juce::AudioProcessor::BusesProperties buses;
 
-AudioPluginAudioProcessor::AudioPluginAudioProcessor()
-    : AudioProcessor(
-          BusesProperties()
 #if !JucePlugin_IsMidiEffect
 #if !JucePlugin_IsSynth
-              .withInput("Input", juce::AudioChannelSet::stereo(), true)
+    buses.addBus(true, "Input", juce::AudioChannelSet::stereo(), true);
 #endif
-              .withOutput("Output", juce::AudioChannelSet::stereo(), true)
+    buses.addBus(false, "Output", juce::AudioChannelSet::stereo(), true);
+
+    // nodes can be routed to these (see audioNode::outputBus)
+    for (int bus = 1; bus < track::MAX_OUTPUT_BUSES; ++bus) {
+        buses.addBus(false, "Output " + juce::String(bus + 1),
+                     juce::AudioChannelSet::stereo(), false);
+    }
 #endif
-              ),
-      juce::ChangeBroadcaster() {
+
+    return buses;
+}
+} // namespace
+
+AudioPluginAudioProcessor::AudioPluginAudioProcessor()
+    : AudioProcessor(getBusesProperties()), juce::ChangeBroadcaster() {
+    importer.processor = this;
+    recorder.processor = this;
+    graph.telemetry = &telemetry;
+
     addParameter(masterGain = new juce::AudioParameterFloat("master", "Master",
                                                             0.f, 6.f, 1.f));
 
@@ -53,7 +75,9 @@ AudioPluginAudioProcessor::AudioPluginAudioProcessor()
     }
 }
 
-AudioPluginAudioProcessor::~AudioPluginAudioProcessor() {}
+AudioPluginAudioProcessor::~AudioPluginAudioProcessor() {
+    track::trace::releaseRing(traceRing);
+}
 
 const juce::String AudioPluginAudioProcessor::getName() const {
     return JucePlugin_Name;
@@ -112,25 +136,40 @@ void AudioPluginAudioProcessor::prepareToPlay(double sampleRate,
 
     DBG("prepareToPlay() called: ");
     DBG("sampleRate = " << sampleRate);
-    DBG("track::SAMPLE_RATE = " << track::SAMPLE_RATE);
+    DBG("context.sampleRate = " << context.sampleRate);
 
-    if (!juce::approximatelyEqual(sampleRate, track::SAMPLE_RATE) &&
-        track::SAMPLE_RATE > 0.0) {
-        this->faultySampleRate = track::SAMPLE_RATE;
+    if (!juce::approximatelyEqual(sampleRate, context.sampleRate) &&
+        context.sampleRate > 0.0) {
+        this->faultySampleRate = context.sampleRate;
         this->dispatchGUIInstruction(
             UI_INSTRUCTION_HOST_PROCESSOR_SAMPLE_RATE_MISMATCH);
     }
 
-    track::SAMPLE_RATE = sampleRate;
-    track::SAMPLES_PER_BLOCK = samplesPerBlock;
+    context.sampleRate = sampleRate;
+    context.samplesPerBlock = juce::jlimit(
+        1, juce::jmax(1, context.maxRenderBlockSize), samplesPerBlock);
+
+    // the host picks the precision before preparing, and the plugins and the
+    // graph below allocate for it
+    context.doublePrecision = isUsingDoublePrecision();
 
     this->maxSamplesPerBlock = samplesPerBlock;
 
+    for (track::audioNode &t : tracks)
+        t.processor = this;
+
+    for (track::audioNode *node : track::utility::getFlattenedNodes(this))
+        node->preparePlugins();
+
     updateLatency();
+    rebuildRenderGraph();
 
-    for (track::audioNode &t : tracks) {
-        t.processor = this;
-        t.preparePlugins();
+    recorder.prepare(sampleRate);
+
+    // clips whose rate now does/doesn't match need a different filter
+    for (track::audioNode *node : track::utility::getFlattenedNodes(this)) {
+        for (track::clip &c : node->clips)
+            c.updatePlaybackTable(context.sampleRate);
     }
 
     if (prepared)
@@ -227,6 +266,14 @@ bool AudioPluginAudioProcessor::isBusesLayoutSupported(
         return false;
 #endif
 
+    // extra outputs are either off or stereo
+    for (int bus = 1; bus < layouts.outputBuses.size(); ++bus) {
+        const juce::AudioChannelSet &set = layouts.getChannelSet(false, bus);
+
+        if (!set.isDisabled() && set != juce::AudioChannelSet::stereo())
+            return false;
+    }
+
     return true;
 #endif
 }
@@ -234,8 +281,32 @@ bool AudioPluginAudioProcessor::isBusesLayoutSupported(
 void AudioPluginAudioProcessor::processBlock(juce::AudioBuffer<float> &buffer,
                                              juce::MidiBuffer &midiMessages) {
     juce::ignoreUnused(midiMessages);
+    renderBlock(buffer);
+}
 
+void AudioPluginAudioProcessor::processBlock(juce::AudioBuffer<double> &buffer,
+                                             juce::MidiBuffer &midiMessages) {
+    juce::ignoreUnused(midiMessages);
+    renderBlock(buffer);
+}
+
+bool AudioPluginAudioProcessor::supportsDoublePrecisionProcessing() const {
+    return true;
+}
+
+template <typename SampleType>
+void AudioPluginAudioProcessor::renderBlock(
+    juce::AudioBuffer<SampleType> &buffer) {
     juce::ScopedNoDenormals noDenormals;
+    juce::int64 callbackStart = juce::Time::getHighResolutionTicks();
+
+    // claimed on the first block recorded rather than named every block
+    if (traceRing == track::trace::unclaimedRing)
+        traceRing = track::trace::claimRing("audio thread");
+    track::trace::useRing ring(traceRing);
+    TRACE_SCOPE("processBlock");
+
+    applyRemoteCommands();
     auto totalNumInputChannels = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
 
@@ -261,11 +332,21 @@ void AudioPluginAudioProcessor::processBlock(juce::AudioBuffer<float> &buffer,
     auto playhead = getPlayHead();
     bool playheadExists = playhead != nullptr;
 
+    // buffer still only has the input in it at this point
+    if (playheadExists) {
+        bool isPlaying = playhead->getPosition()->getIsPlaying();
+        int timelineSample =
+            (int)playhead->getPosition()->getTimeInSamples().orFallback(0);
+
+        recorder.processInput(buffer, totalNumInputChannels, timelineSample,
+                              isPlaying && anyTrackArmed.load());
+    }
+
     bool temporaryThing = false;
     if (temporaryThing) {
         // process tracks; tracks populate their internal buffer
         for (track::audioNode &t : tracks) {
-            t.process(buffer.getNumSamples(), 44100);
+            t.process<SampleType>(buffer.getNumSamples(), 44100);
         }
     }
 
@@ -273,20 +354,15 @@ void AudioPluginAudioProcessor::processBlock(juce::AudioBuffer<float> &buffer,
         if (playhead->getPosition()->getIsPlaying() == true) {
 
             int currentSample = *playhead->getPosition()->getTimeInSamples();
-
-            // process tracks; tracks populate their internal buffer
-            for (track::audioNode &t : tracks) {
-                t.process(buffer.getNumSamples(), currentSample);
-            }
-
-            // sum track buffers
-            for (track::audioNode &t : tracks) {
-                for (int channel = 0; channel < totalNumOutputChannels;
-                     ++channel) {
-
-                    buffer.addFrom(channel, 0, t.buffer, channel, 0,
-                                   buffer.getNumSamples());
-                }
+            int numSamples = buffer.getNumSamples();
+            int quantum = juce::jmax(1, graph.getCapacity());
+
+            // hosts don't always stick to the block size they prepared us
+            // with, so nothing past here ever sees more than that at once
+            for (int offset = 0; offset < numSamples; offset += quantum) {
+                renderQuantum(buffer, offset,
+                              juce::jmin(quantum, numSamples - offset),
+                              currentSample + offset);
             }
         }
     }
@@ -296,7 +372,200 @@ void AudioPluginAudioProcessor::processBlock(juce::AudioBuffer<float> &buffer,
         juce::ignoreUnused(channelData);
     }
 
-    buffer.applyGain(*masterGain);
+    // the master only touches the main output; stems leave as they are
+    getBusBuffer(buffer, false, 0).applyGain(*masterGain);
+
+    double elapsed = juce::Time::highResolutionTicksToSeconds(
+        juce::Time::getHighResolutionTicks() - callbackStart);
+    double budget =
+        context.sampleRate > 0 ? buffer.getNumSamples() / context.sampleRate
+                               : 0.0;
+
+    if (budget > 0.0 && elapsed > budget)
+        ++telemetry.xruns;
+
+    if (telemetry.isEnabled()) {
+        track::telemetryEvent e;
+        e.type = track::telemetryEvent::block;
+        e.seconds = (float)elapsed;
+        e.budget = (float)budget;
+        telemetry.push(e);
+
+        graph.flushTelemetry(budget);
+    }
+}
+
+void AudioPluginAudioProcessor::applyRemoteCommands() {
+    track::remoteCommand c;
+    bool changed = false;
+
+    while (remote.pop(c)) {
+        if (c.type == track::remoteCommand::bypass ||
+            c.type == track::remoteCommand::dryWet ||
+            c.type == track::remoteCommand::relay) {
+            track::subplugin *sp = graph.findPlugin(c.id);
+            if (sp == nullptr)
+                continue;
+
+            if (c.type == track::remoteCommand::bypass) {
+                sp->bypassed = c.value > .5f;
+            } else if (c.type == track::remoteCommand::dryWet) {
+                sp->dryWetMix = c.value; // ramped in processDirect()
+            } else {
+                if (c.index < 0 || c.index >= (int)sp->relayParams.size())
+                    continue;
+
+                int paramID = sp->relayParams[(size_t)c.index].outputParamID;
+                if (paramID == -1)
+                    continue;
+
+                // picked up by relayParamsToPlugin() later this block
+                getParameters()[paramID + 1]->setValue(c.value);
+            }
+
+            changed = true;
+            continue;
+        }
+
+        track::audioNode *node = graph.findNode(c.id);
+        if (node == nullptr)
+            continue;
+
+        // gain and pan get ramped over the block in audioNode::process()
+        if (c.type == track::remoteCommand::gain) {
+            node->gain = c.value;
+        } else if (c.type == track::remoteCommand::pan) {
+            node->pan = c.value;
+        } else if (c.type == track::remoteCommand::mute) {
+            node->m = c.value > .5f;
+        } else if (c.type == track::remoteCommand::solo) {
+            node->s = c.value > .5f;
+
+            soloMode = false;
+            for (track::renderNode &r : graph.nodes)
+                soloMode = soloMode || r.node->s;
+        }
+
+        changed = true;
+    }
+
+    if (changed)
+        remoteChanged = true;
+}
+
+bool AudioPluginAudioProcessor::isOutputBusEnabled(int bus) const {
+    const Bus *b = getBus(false, bus);
+    return b != nullptr && b->isEnabled() && b->getNumberOfChannels() == 2;
+}
+
+template <typename SampleType>
+void AudioPluginAudioProcessor::renderQuantum(
+    juce::AudioBuffer<SampleType> &out, int startSample, int numSamples,
+    int currentSample) {
+    int mainChannels =
+        juce::jmin(out.getNumChannels(), getMainBusNumOutputChannels(), 2);
+
+    renderTargets<SampleType> &targets = getTargets<SampleType>();
+    juce::AudioBuffer<SampleType> &mainMix = targets.mainMix;
+    auto &outputTargets = targets.outputTargets;
+    auto &outputViews = targets.outputViews;
+
+    // sends get summed into these while the tree processes. they're allocated
+    // up front by rebuildRenderGraph(), so this only ever shrinks them
+    for (track::audioNode &t : tracks) {
+        if (!t.isReturn)
+            continue;
+
+        juce::AudioBuffer<SampleType> &input = t.getSendInput<SampleType>();
+
+        if (input.getNumSamples() != numSamples)
+            input.setSize(2, numSamples, false, false, true);
+
+        input.clear();
+    }
+
+    if (mainMix.getNumSamples() != numSamples)
+        mainMix.setSize(2, numSamples, false, false, true);
+
+    mainMix.clear();
+
+    // nodes on other outputs are rendered straight into the host's buffer.
+    // processBlock() has already cleared those channels
+    outputTargets[0] = &mainMix;
+    for (int bus = 1; bus < track::MAX_OUTPUT_BUSES; ++bus) {
+        outputTargets[(size_t)bus] = nullptr;
+
+        if (!isOutputBusEnabled(bus))
+            continue;
+
+        int channel = getChannelIndexInProcessBlockBuffer(false, bus, 0);
+        if (channel < 0 || channel + 2 > out.getNumChannels())
+            continue;
+
+        outputViews[(size_t)bus].setDataToReferTo(
+            out.getArrayOfWritePointers() + channel, 2, startSample,
+            numSamples);
+        outputTargets[(size_t)bus] = &outputViews[(size_t)bus];
+    }
+
+    // process tracks; top level ones get summed into mainMix
+    graph.process(numSamples, currentSample, soloMode, outputTargets.data());
+
+    // returns go after everything that sends to them
+    for (int id : returnSchedule)
+        graph.processReturn<SampleType>(id, numSamples);
+
+    mainCompensation.process(mainMix, numSamples);
+
+    for (int bus = 1; bus < track::MAX_OUTPUT_BUSES; ++bus) {
+        if (outputTargets[(size_t)bus] != nullptr) {
+            outputCompensation[(size_t)bus].process(
+                *outputTargets[(size_t)bus], numSamples);
+        }
+    }
+
+    for (int channel = 0; channel < mainChannels; ++channel) {
+        out.addFrom(channel, startSample, mainMix, channel, 0, numSamples);
+    }
+
+    for (int id : returnSchedule) {
+        track::audioNode *r = graph.getReturn(id);
+
+        if (r == nullptr)
+            continue;
+
+        juce::AudioBuffer<SampleType> &buffer = r->getBuffer<SampleType>();
+        r->returnCompensation.process(buffer, numSamples);
+
+        juce::AudioBuffer<SampleType> *target =
+            r->outputBus > 0 && r->outputBus < track::MAX_OUTPUT_BUSES
+                ? outputTargets[(size_t)r->outputBus]
+                : nullptr;
+
+        if (target != nullptr) {
+            for (int channel = 0; channel < 2; ++channel)
+                target->addFrom(channel, 0, buffer, channel, 0, numSamples);
+
+            continue;
+        }
+
+        for (int channel = 0; channel < mainChannels; ++channel) {
+            out.addFrom(channel, startSample, buffer, channel, 0, numSamples);
+        }
+    }
+}
+
+void AudioPluginAudioProcessor::updateRecordArmed() {
+    bool armed = false;
+
+    for (track::audioNode *node : track::utility::getFlattenedNodes(this)) {
+        if (node->isTrack && node->recordArmed) {
+            armed = true;
+            break;
+        }
+    }
+
+    anyTrackArmed = armed;
 }
 
 bool AudioPluginAudioProcessor::hasEditor() const {
@@ -319,6 +588,23 @@ AudioPluginAudioProcessor::serializeNode(track::audioNode *node) {
     nodeElement->setAttribute("pan", node->pan);
     nodeElement->setAttribute("solo", node->s);
     nodeElement->setAttribute("mute", node->m);
+    nodeElement->setAttribute("id", node->id);
+    nodeElement->setAttribute("outputbus", node->outputBus);
+    nodeElement->setAttribute("mono", node->mono);
+
+    if (node->isReturn) {
+        nodeElement->setAttribute("isreturn", true);
+        nodeElement->setAttribute("returnid", node->returnID);
+    }
+
+    for (track::send &s : node->sends) {
+        juce::XmlElement *sendElement = new juce::XmlElement("send");
+        sendElement->setAttribute("returnid", s.returnID);
+        sendElement->setAttribute("gain", s.gain);
+        sendElement->setAttribute("prefader", s.preFader);
+
+        nodeElement->addChildElement(sendElement);
+    }
 
     for (size_t i = 0; i < node->plugins.size(); ++i) {
         auto &pluginInstance = node->plugins[i];
@@ -328,6 +614,7 @@ AudioPluginAudioProcessor::serializeNode(track::audioNode *node) {
             pluginInstance->plugin->getPluginDescription()
                 .fileOrIdentifier.upToLastOccurrenceOf(".vst3", true, true);
         pluginElement->setAttribute("identifier", identifier);
+        pluginElement->setAttribute("id", pluginInstance->id);
 
         juce::MemoryBlock pluginData;
         pluginInstance->plugin->getStateInformation(pluginData);
@@ -360,6 +647,7 @@ AudioPluginAudioProcessor::serializeNode(track::audioNode *node) {
             clipElement->setAttribute("active", c->active);
 
             clipElement->setAttribute("path", c->path);
+            clipElement->setAttribute("source", c->sourcePath);
             clipElement->setAttribute("start", c->startPositionSample);
             clipElement->setAttribute("name", c->name);
             clipElement->setAttribute("gain", c->gain);
@@ -386,8 +674,25 @@ void AudioPluginAudioProcessor::deserializeNode(juce::XmlElement *nodeElement,
     node->pan = (float)nodeElement->getDoubleAttribute("pan", 0.0);
     node->s = nodeElement->getBoolAttribute("solo");
     node->m = nodeElement->getBoolAttribute("mute");
+    node->isReturn = nodeElement->getBoolAttribute("isreturn", false);
+    node->returnID = nodeElement->getIntAttribute("returnid", -1);
+    node->id = nodeElement->getIntAttribute("id", -1);
+    node->outputBus = juce::jlimit(
+        0, track::MAX_OUTPUT_BUSES - 1,
+        nodeElement->getIntAttribute("outputbus", 0));
+    node->mono = nodeElement->getBoolAttribute("mono", false);
     node->processor = this;
 
+    juce::XmlElement *sendElement = nodeElement->getChildByName("send");
+    while (sendElement != nullptr) {
+        track::send &s = node->sends.emplace_back();
+        s.returnID = sendElement->getIntAttribute("returnid", -1);
+        s.gain = (float)sendElement->getDoubleAttribute("gain", 1.0);
+        s.preFader = sendElement->getBoolAttribute("prefader", false);
+
+        sendElement = sendElement->getNextElementWithTagName("send");
+    }
+
     juce::XmlElement *pluginElement = nodeElement->getChildByName("plugin");
     for (size_t i = 0; pluginElement != nullptr; ++i) {
         juce::String identifier =
@@ -406,6 +711,8 @@ void AudioPluginAudioProcessor::deserializeNode(juce::XmlElement *nodeElement,
             pluginData.fromBase64Encoding(encodedPluginData);
             pluginInstance.plugin->setStateInformation(pluginData.getData(),
                                                        pluginData.getSize());
+            pluginInstance.id = pluginElement->getIntAttribute("id", -1);
+
             bool bypassed = pluginElement->getBoolAttribute("bypass", false);
             node->plugins[i]->bypassed = bypassed;
 
@@ -437,12 +744,15 @@ void AudioPluginAudioProcessor::deserializeNode(juce::XmlElement *nodeElement,
         pluginElement = pluginElement->getNextElementWithTagName("plugin");
     }
 
+    node->updateChannels();
+
     if (node->isTrack) {
         juce::XmlElement *clipElement = nodeElement->getChildByName("clip");
 
         while (clipElement != nullptr) {
             // get clip data
             juce::String path = clipElement->getStringAttribute("path");
+            juce::String sourcePath = clipElement->getStringAttribute("source");
             juce::String clipName = clipElement->getStringAttribute("name");
             int start = clipElement->getIntAttribute("start");
             bool active = clipElement->getIntAttribute("active");
@@ -455,6 +765,7 @@ void AudioPluginAudioProcessor::deserializeNode(juce::XmlElement *nodeElement,
             // create clip instance
             node->clips.emplace_back();
             track::clip *c = &node->clips.back();
+            c->id = track::clip::getNewID();
             c->active = active;
             c->path = path;
             c->name = clipName;
@@ -462,7 +773,29 @@ void AudioPluginAudioProcessor::deserializeNode(juce::XmlElement *nodeElement,
             c->trimLeft = trimLeft;
             c->trimRight = trimRight;
             c->gain = clipGain;
-            bool success = c->updateBuffer();
+            c->sourcePath = sourcePath;
+
+            // the resampled copy was evicted from the cache. the clip waits
+            // as a placeholder while it's made again from the original
+            if (sourcePath.isNotEmpty() && !juce::File(path).existsAsFile() &&
+                juce::File(sourcePath).existsAsFile()) {
+                c->path = sourcePath;
+
+                track::importRequest r;
+                r.sourcePath = sourcePath;
+                r.resample = true;
+                r.clipIDs.push_back(c->id);
+                pendingRegenerations.push_back(r);
+
+                clipElement = clipElement->getNextElementWithTagName("clip");
+                continue;
+            }
+
+            // keeps it from being the next thing evicted
+            if (sourcePath.isNotEmpty())
+                track::diskcache::touch(juce::File(path));
+
+            bool success = c->updateBuffer(context.sampleRate, context.storage);
 
             if (!success) {
                 failedDeserializationErrors.emplace_back(
@@ -501,10 +834,20 @@ void AudioPluginAudioProcessor::getStateInformation(
     }
 
     projectSettings->setAttribute("samplerate", getSampleRate());
-    projectSettings->setAttribute("samplesperblock", track::SAMPLES_PER_BLOCK);
+    projectSettings->setAttribute("samplesperblock", context.samplesPerBlock);
     projectSettings->setAttribute("mastergain", *this->masterGain);
-    projectSettings->setAttribute("autogrid", track::AUTO_GRID);
-    projectSettings->setAttribute("snapdivision", track::SNAP_DIVISION);
+    projectSettings->setAttribute("autogrid", context.autoGrid);
+    projectSettings->setAttribute("snapdivision", context.snapDivision);
+    projectSettings->setAttribute("maxrenderblocksize",
+                                  context.maxRenderBlockSize);
+    projectSettings->setAttribute("fixedpluginblocksize",
+                                  context.fixedPluginBlockSize);
+    projectSettings->setAttribute("pluginwatchdogblocks",
+                                  context.pluginWatchdogBlocks);
+    projectSettings->setAttribute("clipstorage", (int)context.storage);
+    projectSettings->setAttribute("telemetryport", telemetry.getPort());
+    projectSettings->setAttribute("remoteport", remote.getPort());
+    projectSettings->setAttribute("nextreturnid", nextReturnID);
 
     juce::XmlElement *knownPlugins = new juce::XmlElement("knownplugins");
     for (auto &p : knownPluginList.getTypes()) {
@@ -560,11 +903,11 @@ void AudioPluginAudioProcessor::getStateInformation(
 
 void AudioPluginAudioProcessor::setStateInformation(const void *data,
                                                     int sizeInBytes) {
+    TRACE_SCOPE("setStateInformation");
+
     std::unique_ptr<juce::XmlElement> xmlState(
         getXmlFromBinary(data, sizeInBytes));
     if (xmlState.get() != nullptr) {
-        tracks.clear();
-
         juce::XmlElement *projectSettings =
             xmlState->getChildByName("projectsettings");
 
@@ -576,14 +919,29 @@ void AudioPluginAudioProcessor::setStateInformation(const void *data,
             getParameters()[index]->setValue(val);
         }
 
-        track::SAMPLE_RATE = projectSettings->getDoubleAttribute("samplerate");
-        track::SAMPLES_PER_BLOCK =
-            projectSettings->getIntAttribute("samplesperblock");
+        context.sampleRate = projectSettings->getDoubleAttribute("samplerate");
+        // the host's block size wins once it has told us
+        if (maxSamplesPerBlock < 0) {
+            context.samplesPerBlock =
+                projectSettings->getIntAttribute("samplesperblock");
+        }
+
+        context.maxRenderBlockSize =
+            projectSettings->getIntAttribute("maxrenderblocksize", 512);
+        context.fixedPluginBlockSize =
+            projectSettings->getIntAttribute("fixedpluginblocksize", 0);
+        context.pluginWatchdogBlocks =
+            projectSettings->getIntAttribute("pluginwatchdogblocks", 0);
+        context.storage = (track::clipStorage)projectSettings->getIntAttribute(
+            "clipstorage", (int)track::clipStorage::decoded);
+        telemetry.setPort(projectSettings->getIntAttribute("telemetryport", 0));
+        remote.setPort(projectSettings->getIntAttribute("remoteport", 0));
+        nextReturnID = projectSettings->getIntAttribute("nextreturnid", 0);
         *this->masterGain =
             (float)projectSettings->getDoubleAttribute("mastergain", 1.0);
 
-        track::AUTO_GRID = projectSettings->getBoolAttribute("autogrid", true);
-        track::SNAP_DIVISION =
+        context.autoGrid = projectSettings->getBoolAttribute("autogrid", true);
+        context.snapDivision =
             projectSettings->getIntAttribute("snapdivision", 4);
 
         DBG("sample rate on deserialization: " << getSampleRate());
@@ -610,15 +968,41 @@ void AudioPluginAudioProcessor::setStateInformation(const void *data,
             curPluginElement->getNextElementWithTagName("PLUGIN");
     }
 
+    // loaded off to the side and swapped in, so the audio thread never sees
+    // the tree half built. the old one is destroyed at the end, unlocked
+    std::vector<track::audioNode> loaded;
     juce::XmlElement *nodeElement = xmlState->getChildByName("node");
 
     while (nodeElement != nullptr) {
-        track::audioNode *node = &tracks.emplace_back();
+        track::audioNode *node = &loaded.emplace_back();
         // DBG("root deserialization call for " << node->trackName);
         deserializeNode(nodeElement, node);
         nodeElement = nodeElement->getNextElementWithTagName("node");
     }
 
+    {
+        ScopedTreeEdit edit(*this);
+        std::swap(tracks, loaded);
+        rebuildNodeIndex();
+    }
+
+    updateLatency();
+
+    // the importer only takes requests on the message thread
+    std::vector<track::importRequest> requests;
+    std::swap(requests, pendingRegenerations);
+
+    if (!requests.empty()) {
+        juce::WeakReference<track::ClipImporter> importerRef(&importer);
+        juce::MessageManager::callAsync([importerRef, requests] {
+            if (importerRef == nullptr)
+                return;
+
+            for (const track::importRequest &r : requests)
+                importerRef->queueDecode(r);
+        });
+    }
+
     if (failedDeserializationErrors.size() > 0) {
         DBG("copying faulty xml...");
         faultyState = xmlState->createDocument("");
@@ -629,29 +1013,473 @@ void AudioPluginAudioProcessor::setStateInformation(const void *data,
 
 void AudioPluginAudioProcessor::updateLatency() {
     int totalLatency = 0;
-    track::MAX_LATENT_SAMPLES = -1;
+    context.maxLatentSamples = -1;
 
     for (track::audioNode &node : this->tracks) {
+        if (node.isReturn)
+            continue;
+
         totalLatency += node.getTotalLatencySamples();
     }
 
+    totalLatency += rebuildReturnSchedule();
+
     setLatencySamples(totalLatency);
 }
 
+void AudioPluginAudioProcessor::applyRenderSettings() {
+    // prepareToPlay() will do it once there's something to prepare for
+    if (maxSamplesPerBlock <= 0)
+        return;
+
+    {
+        const juce::ScopedLock sl(getCallbackLock());
+
+        context.samplesPerBlock = juce::jlimit(
+            1, juce::jmax(1, context.maxRenderBlockSize), maxSamplesPerBlock);
+
+        for (track::audioNode *node : track::utility::getFlattenedNodes(this))
+            node->preparePlugins();
+
+        rebuildRenderGraph();
+    }
+
+    updateLatency();
+}
+
+void AudioPluginAudioProcessor::reloadClips() {
+    for (track::audioNode *node : track::utility::getFlattenedNodes(this)) {
+        for (track::clip &c : node->clips) {
+            // loaded off to the side, so the audio thread only waits for the
+            // swap. the old audio goes with loaded
+            track::clip loaded;
+            loaded.path = c.path;
+            if (!loaded.updateBuffer(context.sampleRate, context.storage))
+                continue;
+
+            const juce::ScopedLock sl(getCallbackLock());
+            std::swap(c.buffer, loaded.buffer);
+            std::swap(c.source, loaded.source);
+            std::swap(c.playbackTable, loaded.playbackTable);
+            c.sampleRate = loaded.sampleRate;
+            c.hostSampleRate = loaded.hostSampleRate;
+        }
+    }
+}
+
+int AudioPluginAudioProcessor::rebuildReturnSchedule() {
+    // only returns can be sent to, so edges between returns are the only ones
+    // that can form a cycle; everything else is just a source. kahn's algorithm
+    // over those
+    std::map<int, int> incoming;
+
+    for (track::audioNode &t : tracks) {
+        if (t.isReturn)
+            incoming[t.returnID] = 0;
+    }
+
+    for (track::audioNode &t : tracks) {
+        if (!t.isReturn)
+            continue;
+
+        for (track::send &s : t.sends) {
+            if (incoming.count(s.returnID) > 0)
+                ++incoming[s.returnID];
+        }
+    }
+
+    std::vector<int> ready;
+    for (auto &[id, count] : incoming) {
+        if (count == 0)
+            ready.push_back(id);
+    }
+
+    std::vector<int> schedule;
+    while (ready.size() > 0) {
+        int id = ready.back();
+        ready.pop_back();
+        schedule.push_back(id);
+
+        for (track::send &s : getReturn(id)->sends) {
+            if (incoming.count(s.returnID) > 0 && --incoming[s.returnID] == 0)
+                ready.push_back(s.returnID);
+        }
+    }
+
+    if (schedule.size() < incoming.size()) {
+        DBG("skipping " << (int)(incoming.size() - schedule.size())
+                        << " returns that send to each other in a loop");
+    }
+
+    // the tree is already lined up with itself, so its sends arrive with no
+    // extra latency. a return's input is as late as its latest source
+    for (track::audioNode &t : tracks)
+        t.returnInputLatency = 0;
+
+    int returnLatency = 0;
+
+    for (int id : schedule) {
+        track::audioNode *r = getReturn(id);
+        r->returnOutputLatency = r->returnInputLatency + r->getLatencySamples();
+        returnLatency = juce::jmax(returnLatency, r->returnOutputLatency);
+
+        for (track::send &s : r->sends) {
+            track::audioNode *target = getReturn(s.returnID);
+
+            if (target != nullptr) {
+                target->returnInputLatency = juce::jmax(
+                    target->returnInputLatency, r->returnOutputLatency);
+            }
+        }
+    }
+
+    const juce::ScopedLock sl(getCallbackLock());
+
+    // delay every send by however much earlier than the latest source it
+    // would've arrived, and every output to match the slowest return
+    for (track::audioNode *node : track::utility::getFlattenedNodes(this)) {
+        int sourceLatency = node->isReturn ? node->returnOutputLatency : 0;
+
+        for (track::send &s : node->sends) {
+            track::audioNode *target = getReturn(s.returnID);
+            s.compensation.setDelay(
+                target == nullptr ? 0
+                                  : target->returnInputLatency - sourceLatency);
+        }
+    }
+
+    for (int id : schedule) {
+        track::audioNode *r = getReturn(id);
+        r->returnCompensation.setDelay(returnLatency - r->returnOutputLatency);
+    }
+
+    mainCompensation.setDelay(returnLatency);
+    for (track::delayBuffer &compensation : outputCompensation)
+        compensation.setDelay(returnLatency);
+
+    returnSchedule = schedule;
+
+    return returnLatency;
+}
+
+track::audioNode *AudioPluginAudioProcessor::getReturn(int returnID) {
+    for (track::audioNode &t : tracks) {
+        if (t.isReturn && t.returnID == returnID)
+            return &t;
+    }
+
+    return nullptr;
+}
+
+int AudioPluginAudioProcessor::getNextReturnID() {
+    // projects saved before there was a counter start above what's in them
+    for (track::audioNode &t : tracks) {
+        if (t.isReturn)
+            nextReturnID = juce::jmax(nextReturnID, t.returnID + 1);
+    }
+
+    return nextReturnID++;
+}
+
+bool AudioPluginAudioProcessor::sendWouldCreateCycle(track::audioNode *source,
+                                                     int returnID) {
+    if (!source->isReturn)
+        return false;
+
+    // can returnID already reach source?
+    std::vector<int> toVisit = {returnID};
+    std::set<int> visited;
+
+    while (toVisit.size() > 0) {
+        int id = toVisit.back();
+        toVisit.pop_back();
+
+        if (id == source->returnID)
+            return true;
+
+        if (!visited.insert(id).second)
+            continue;
+
+        track::audioNode *r = getReturn(id);
+        if (r == nullptr)
+            continue;
+
+        for (track::send &s : r->sends)
+            toVisit.push_back(s.returnID);
+    }
+
+    return false;
+}
+
+void AudioPluginAudioProcessor::rebuildNodeIndex() {
+    nodeIndex.clear();
+    pluginIndex.clear();
+
+    // ids from a loaded project can be anywhere, so start counting above them
+    std::function<void(track::audioNode &)> findHighestIDs =
+        [&](track::audioNode &node) {
+            nextNodeID = juce::jmax(nextNodeID, node.id + 1);
+            for (auto &sp : node.plugins)
+                nextPluginID = juce::jmax(nextPluginID, sp->id + 1);
+            for (auto &child : node.childNodes)
+                findHighestIDs(child);
+        };
+
+    for (auto &node : tracks)
+        findHighestIDs(node);
+
+    // a clash only happens if a project was edited by hand; whichever comes
+    // second gets a new id
+    std::vector<int> route;
+    for (size_t i = 0; i < tracks.size(); ++i) {
+        route.push_back((int)i);
+        indexSubtree(tracks[i], route, true);
+        route.pop_back();
+    }
+
+    // the graph points at the same nodes, so it's stale now too
+    rebuildRenderGraph();
+}
+
+void AudioPluginAudioProcessor::indexSubtree(track::audioNode &node,
+                                             std::vector<int> &route,
+                                             bool claimIDs) {
+    if (claimIDs && (node.id < 0 || nodeIndex.count(node.id) > 0))
+        node.id = nextNodeID++;
+
+    nodeLocation &location = nodeIndex[node.id];
+    location.node = &node;
+    location.route = route;
+    indexPlugins(node, location);
+
+    for (size_t i = 0; i < node.childNodes.size(); ++i) {
+        route.push_back((int)i);
+        indexSubtree(node.childNodes[i], route, claimIDs);
+        route.pop_back();
+    }
+}
+
+void AudioPluginAudioProcessor::indexPlugins(track::audioNode &node,
+                                             nodeLocation &location) {
+    // plugins are held by pointer and never move, so an id that's indexed to
+    // a different instance is always a copy's
+    location.pluginIDs.clear();
+
+    for (auto &sp : node.plugins) {
+        auto it = pluginIndex.find(sp->id);
+        if (sp->id < 0 || (it != pluginIndex.end() && it->second != sp.get()))
+            sp->id = nextPluginID++;
+
+        pluginIndex[sp->id] = sp.get();
+        location.pluginIDs.push_back(sp->id);
+    }
+}
+
+void AudioPluginAudioProcessor::unindexSubtree(track::audioNode &node) {
+    auto it = nodeIndex.find(node.id);
+    if (it != nodeIndex.end()) {
+        for (int id : it->second.pluginIDs)
+            pluginIndex.erase(id);
+
+        nodeIndex.erase(it);
+    }
+
+    for (auto &child : node.childNodes)
+        unindexSubtree(child);
+}
+
+void AudioPluginAudioProcessor::reindexSiblings(
+    std::vector<track::audioNode> &siblings, std::vector<int> parentRoute,
+    size_t from) {
+    for (size_t i = from; i < siblings.size(); ++i) {
+        parentRoute.push_back((int)i);
+        indexSubtree(siblings[i], parentRoute, false);
+        parentRoute.pop_back();
+    }
+}
+
+AudioPluginAudioProcessor::ScopedTreeEdit::ScopedTreeEdit(
+    AudioPluginAudioProcessor &p)
+    : processor(p), lock(p.getCallbackLock()) {
+    ++processor.treeEditDepth;
+}
+
+AudioPluginAudioProcessor::ScopedTreeEdit::~ScopedTreeEdit() {
+    // still under the lock; it's released after this
+    if (--processor.treeEditDepth == 0 && processor.graphStale) {
+        processor.graphStale = false;
+        processor.rebuildRenderGraph();
+    }
+}
+
+track::audioNode &AudioPluginAudioProcessor::insertNode(
+    int parentID, int index, track::audioNode &&node) {
+    ScopedTreeEdit edit(*this);
+
+    std::vector<track::audioNode> *siblings = &tracks;
+    std::vector<int> parentRoute;
+
+    if (parentID >= 0) {
+        auto it = nodeIndex.find(parentID);
+        jassert(it != nodeIndex.end());
+
+        siblings = &it->second.node->childNodes;
+        parentRoute = it->second.route;
+    }
+
+    if (index < 0 || (size_t)index > siblings->size())
+        index = (int)siblings->size();
+
+    const track::audioNode *oldData = siblings->data();
+    siblings->insert(siblings->begin() + index, std::move(node));
+    track::audioNode &inserted = (*siblings)[(size_t)index];
+
+    // the new node's ids are checked against the tree before anything else
+    // gets re-indexed. everything after it moved over by one; if the vector
+    // grew, everything before it moved too
+    std::vector<int> route = parentRoute;
+    route.push_back(index);
+    indexSubtree(inserted, route, true);
+
+    bool reallocated = siblings->data() != oldData;
+    for (size_t i = reallocated ? 0 : (size_t)index; i < siblings->size();
+         ++i) {
+        if (i == (size_t)index)
+            continue;
+
+        route.back() = (int)i;
+        indexSubtree((*siblings)[i], route, false);
+    }
+
+    graphStale = true;
+    return inserted;
+}
+
+track::audioNode AudioPluginAudioProcessor::removeNode(int id) {
+    ScopedTreeEdit edit(*this);
+
+    auto it = nodeIndex.find(id);
+    jassert(it != nodeIndex.end());
+
+    std::vector<int> parentRoute = it->second.route;
+    size_t index = (size_t)parentRoute.back();
+    parentRoute.pop_back();
+
+    std::vector<track::audioNode> &siblings =
+        parentRoute.empty()
+            ? tracks
+            : track::utility::getNodeFromRoute(parentRoute, this)->childNodes;
+
+    track::audioNode node = std::move(siblings[index]);
+    siblings.erase(siblings.begin() + (int)index);
+
+    unindexSubtree(node);
+    reindexSiblings(siblings, parentRoute, index);
+
+    graphStale = true;
+    return node;
+}
+
+void AudioPluginAudioProcessor::moveNode(int id, int parentID, int index) {
+    ScopedTreeEdit edit(*this);
+    insertNode(parentID, index, removeNode(id));
+}
+
+int AudioPluginAudioProcessor::getParentID(int id) {
+    std::vector<int> route = getRouteOfNode(id);
+    if (route.size() < 2)
+        return -1;
+
+    route.pop_back();
+    return track::utility::getNodeFromRoute(route, this)->id;
+}
+
+void AudioPluginAudioProcessor::reindexPlugins(track::audioNode &node) {
+    auto it = nodeIndex.find(node.id);
+    jassert(it != nodeIndex.end());
+
+    for (int id : it->second.pluginIDs)
+        pluginIndex.erase(id);
+
+    indexPlugins(node, it->second);
+
+    const juce::ScopedLock sl(getCallbackLock());
+    graph.indexPlugins();
+}
+
+void AudioPluginAudioProcessor::rebuildRenderGraph() {
+    const juce::ScopedLock sl(getCallbackLock());
+
+    int quantum = juce::jmax(1, context.samplesPerBlock);
+    graph.compile(tracks, context);
+
+    // so that renderQuantum() never has to grow anything. the precision that
+    // isn't in use gets nothing
+    bool useDouble = context.doublePrecision;
+    int floatSize = useDouble ? 0 : quantum;
+    int doubleSize = useDouble ? quantum : 0;
+
+    floatTargets.mainMix.setSize(2, floatSize, false, true, false);
+    doubleTargets.mainMix.setSize(2, doubleSize, false, true, false);
+
+    for (track::audioNode &t : tracks) {
+        if (!t.isReturn)
+            continue;
+
+        t.sendInput.setSize(2, floatSize, false, true, false);
+        t.doubleSendInput.setSize(2, doubleSize, false, true, false);
+    }
+}
+
+track::audioNode *AudioPluginAudioProcessor::getNodeByID(int id) {
+    auto it = nodeIndex.find(id);
+    return it == nodeIndex.end() ? nullptr : it->second.node;
+}
+
+std::vector<int> AudioPluginAudioProcessor::getRouteOfNode(int id) {
+    auto it = nodeIndex.find(id);
+    return it == nodeIndex.end() ? std::vector<int>() : it->second.route;
+}
+
+track::subplugin *AudioPluginAudioProcessor::getPluginByID(int id) {
+    auto it = pluginIndex.find(id);
+    return it == pluginIndex.end() ? nullptr : it->second;
+}
+
 void AudioPluginAudioProcessor::updateLatencyAfterDelay() {
     juce::Timer::callAfterDelay(1000, [this] { updateLatency(); });
 }
 
 void AudioPluginAudioProcessor::dispatchGUIInstruction(
     int commandID, void *data, std::vector<int> routeData) {
-    if (commandID != -1) {
-        this->GUIInstruction.command = commandID;
+    track::uiinstruction x;
+    x.command = commandID;
+    x.metadata = data;
+    x.r = routeData;
+
+    bool flushNow = guiQueue.push(x);
+
+    // the clips just moved, so clip components can't keep pointing at them
+    // until the next frame. rebinding them by id is cheap; the rebuild waits
+    bool clipsChanged = commandID == UI_INSTRUCTION_UPDATE_CORE ||
+                        commandID == UI_INSTRUCTION_UPDATE_CLIP_COMPONENTS;
+
+    if (!juce::MessageManager::existsAndIsCurrentThread()) {
+        if (flushNow)
+            sendChangeMessage();
+        return;
     }
 
-    this->GUIInstruction.metadata = data;
-    this->GUIInstruction.r = routeData;
+    if (clipsChanged && getActiveEditor() != nullptr) {
+        AudioPluginAudioProcessorEditor *editor =
+            (AudioPluginAudioProcessorEditor *)getActiveEditor();
+        editor->rebindComponents();
+    }
 
-    sendSynchronousChangeMessage();
+    // deferred ones are picked up by the editor's vblank flush, so a batch of
+    // actions ends up as one rebuild
+    if (flushNow)
+        sendSynchronousChangeMessage();
 }
 
 void AudioPluginAudioProcessor::requireSaving() {
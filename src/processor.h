@@ -1,7 +1,20 @@
 #pragma once
+#include "daw/clipboard.h"
 #include "daw/defs.h"
+#include "daw/graph.h"
+#include "daw/importer.h"
+#include "daw/peaks.h"
+#include "daw/recorder.h"
+#include "daw/remote.h"
+#include "daw/telemetry.h"
+#include "daw/trace.h"
 #include "daw/track.h"
+#include "daw/uiqueue.h"
+#include "daw/watchdog.h"
 #include <JuceHeader.h>
+#include <array>
+#include <type_traits>
+#include <unordered_map>
 
 class AudioPluginAudioProcessor : public juce::AudioProcessor,
                                   public juce::ChangeBroadcaster {
@@ -15,8 +28,17 @@ class AudioPluginAudioProcessor : public juce::AudioProcessor,
     bool isBusesLayoutSupported(const BusesLayout &layouts) const override;
 
     void processBlock(juce::AudioBuffer<float> &, juce::MidiBuffer &) override;
+    void processBlock(juce::AudioBuffer<double> &,
+                      juce::MidiBuffer &) override;
     using AudioProcessor::processBlock;
 
+    // the tree renders in whichever precision the host asks for (see
+    // engineContext::doublePrecision). only plugins that can't do double get
+    // converted, around their own processBlock()
+    bool supportsDoublePrecisionProcessing() const override;
+    template <typename SampleType>
+    void renderBlock(juce::AudioBuffer<SampleType> &buffer);
+
     juce::AudioProcessorEditor *createEditor() override;
     bool hasEditor() const override;
 
@@ -41,6 +63,8 @@ class AudioPluginAudioProcessor : public juce::AudioProcessor,
     void reset() override;
 
     int maxSamplesPerBlock = -1;
+    track::engineContext context;
+    track::Clipboard clipboard;
 
     std::vector<track::audioNode> tracks;
     bool soloMode = false;
@@ -51,18 +75,152 @@ class AudioPluginAudioProcessor : public juce::AudioProcessor,
     void updateLatency();
     void updateLatencyAfterDelay();
 
+    // message thread. pick up changes to the project settings in context
+    // without waiting for the host to call prepareToPlay() again
+    void applyRenderSettings(); // block sizes; re-prepares every plugin
+    void reloadClips();         // storage; every clip gets loaded again
+
+    // every node and plugin has an id that survives reorders, moves and
+    // save/load. the index maps ids to where things currently are. message
+    // thread only. rebuildNodeIndex() walks the whole tree, which is only
+    // needed after loading; edits go through insertNode()/removeNode() and
+    // reindexPlugins(), which only touch what moved
+    struct nodeLocation {
+        track::audioNode *node = nullptr;
+        std::vector<int> route;
+        std::vector<int> pluginIDs; // what it has in pluginIndex
+    };
+    std::unordered_map<int, nodeLocation> nodeIndex;
+    std::unordered_map<int, track::subplugin *> pluginIndex;
+    int nextNodeID = 0;
+    int nextPluginID = 0;
+    void rebuildNodeIndex();
+    track::audioNode *getNodeByID(int id); // nullptr if it's gone
+    std::vector<int> getRouteOfNode(int id); // empty if it's gone
+    track::subplugin *getPluginByID(int id);
+
+    // parentID -1 is the top level, index -1 the end. ids that are missing,
+    // or still held by something in the tree (i.e. node is a copy), get new
+    // ones; anything else keeps its id, so a node that was taken out with
+    // removeNode() comes back as itself. returns the node where it ended up
+    track::audioNode &insertNode(int parentID, int index,
+                                 track::audioNode &&node);
+    track::audioNode removeNode(int id); // with everything in it
+    void moveNode(int id, int parentID, int index); // index after removal
+    int getParentID(int id); // -1 for top level nodes
+
+    // holds the callback lock while the tree changes, so the audio thread
+    // never sees it half done, or walks a graph that still points at nodes
+    // that moved. insertNode()/removeNode() take one themselves; an action
+    // that makes several changes holds its own around them. they nest, and
+    // the graph gets recompiled once, before the outermost one lets go
+    class ScopedTreeEdit {
+      public:
+        explicit ScopedTreeEdit(AudioPluginAudioProcessor &p);
+        ~ScopedTreeEdit();
+
+      private:
+        AudioPluginAudioProcessor &processor;
+        const juce::ScopedLock lock;
+    };
+
+    // after plugins were added to or removed from node
+    void reindexPlugins(track::audioNode &node);
+
+    // what processBlock() actually walks. rebuilt along with the index
+    track::RenderGraph graph;
+    void rebuildRenderGraph();
+
+    // return ids in the order they get processed. returns that send to each
+    // other in a loop are left out (and stay silent) until the loop is broken
+    std::vector<int> returnSchedule;
+    int rebuildReturnSchedule(); // returns the latency the returns add
+    track::audioNode *getReturn(int returnID);
+
+    // ids are never handed out twice, even after the return that had one is
+    // deleted, since sends to it are kept around for undo. saved with the
+    // project
+    int nextReturnID = 0;
+    int getNextReturnID();
+    bool sendWouldCreateCycle(track::audioNode *source, int returnID);
+
+    // renders numSamples (at most one quantum) into out at startSample
+    template <typename SampleType>
+    void renderQuantum(juce::AudioBuffer<SampleType> &out, int startSample,
+                       int numSamples, int currentSample);
+
+    // one set per precision; only the one the host renders in is allocated
+    template <typename SampleType> struct renderTargets {
+        // everything that isn't a return, delayed to line up with the returns
+        juce::AudioBuffer<SampleType> mainMix;
+
+        // where each output bus gets rendered this quantum. [0] is mainMix,
+        // the rest point straight into the host's buffer, or are null if the
+        // host has that bus off. they're delayed like mainMix
+        std::array<juce::AudioBuffer<SampleType> *, track::MAX_OUTPUT_BUSES>
+            outputTargets{};
+        std::array<juce::AudioBuffer<SampleType>, track::MAX_OUTPUT_BUSES>
+            outputViews;
+    };
+    renderTargets<float> floatTargets;
+    renderTargets<double> doubleTargets;
+
+    template <typename SampleType> renderTargets<SampleType> &getTargets() {
+        if constexpr (std::is_same_v<SampleType, float>)
+            return floatTargets;
+        else
+            return doubleTargets;
+    }
+
+    track::delayBuffer mainCompensation;
+    std::array<track::delayBuffer, track::MAX_OUTPUT_BUSES> outputCompensation;
+    bool isOutputBusEnabled(int bus) const;
+
     juce::KnownPluginList knownPluginList;
 
     juce::AudioParameterInt *johnInt;
 
     int automatableParametersIndexOffset = -1;
 
+    // refreshes get merged and handed to the editor on the next message loop
+    // turn; anything that can't wait flushes the queue right away
     void
     dispatchGUIInstruction(int commandID = -1, void *data = nullptr,
                            std::vector<int> routeData = std::vector<int>());
-    track::uiinstruction GUIInstruction;
+    track::GUIInstructionQueue guiQueue;
     juce::UndoManager undoManager;
 
+    track::ClipImporter importer;
+
+    // resampled clips whose cache file is gone, found while loading a
+    // project. handed to the importer once the new tree is in
+    std::vector<track::importRequest> pendingRegenerations;
+
+    // pages in mapped clips ahead of the playhead. one thread for every
+    // instance in the process
+    juce::SharedResourcePointer<track::MappedPrefetcher> prefetcher;
+
+    // flags plugins that are stuck in processBlock(); see
+    // engineContext::pluginWatchdogBlocks
+    juce::SharedResourcePointer<track::PluginWatchdog> watchdog;
+
+    track::PeakCache peaks;
+
+    track::Recorder recorder;
+    track::Telemetry telemetry; // off until it's given a port
+
+    // osc control surfaces. applyRemoteCommands() runs at the start of every
+    // block and sets remoteChanged so the editor knows to refresh
+    track::RemoteControl remote; // off until it's given a port
+    void applyRemoteCommands();
+    std::atomic<bool> remoteChanged{false};
+    std::atomic<bool> anyTrackArmed{false};
+    void updateRecordArmed();
+
+    // set by the audio thread when a plugin faults, cleared by the editor
+    // once it's redrawn the plugin chains
+    std::atomic<bool> pluginFaulted{false};
+
     void requireSaving();
 
     std::vector<juce::String> failedDeserializationErrors;
@@ -80,5 +238,22 @@ class AudioPluginAudioProcessor : public juce::AudioProcessor,
 
     bool prepared = false;
 
+    // this instance's ring in a trace recording. the host can run the
+    // callback on any of its threads, so the ring goes with the instance
+    // rather than whichever thread it's on
+    int traceRing = track::trace::unclaimedRing;
+
+    int treeEditDepth = 0;
+    bool graphStale = false;
+
+    // claimIDs gives new ids to anything without one, or whose id belongs to
+    // another node that's still indexed
+    void indexSubtree(track::audioNode &node, std::vector<int> &route,
+                      bool claimIDs);
+    void indexPlugins(track::audioNode &node, nodeLocation &location);
+    void unindexSubtree(track::audioNode &node);
+    void reindexSiblings(std::vector<track::audioNode> &siblings,
+                         std::vector<int> parentRoute, size_t from);
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(AudioPluginAudioProcessor)
 };